@@ -0,0 +1,493 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+#pragma once
+
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <boost/align/aligned_alloc.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+
+#include "BitmapObjectPoolLayout.h"
+#include "ObjectPool.h"
+#include "SIMDIndexSearch.h"
+
+
+
+
+//
+//	BitmapObjectPool is the ObjectPool interface without the intrusive links.  Each chunk starts with an
+//		occupancy bitmap, a bit per slot, and liveness lives there instead of in m_next and m_prev, so
+//		pooled types need not derive from ObjectPoolable and a small object costs only its own size.
+//		Iteration walks the chunks in order and the set bits of each bitmap word with count trailing
+//		zeros, so it reads the slots front to back rather than chasing pointers around the chunks.
+//
+//	Objects come back in slot order, not allocation order as with ObjectPool.  A freed slot holds the link
+//		of the free list in place of the object and is reused before the chunks grow.
+//
+//	Chunks are allocated aligned to their size, a power of two, so free() finds an object's chunk, and the
+//		bitmap, by masking its address.  ChunkSize is the least number of slots in a chunk: a chunk is the
+//		smallest power of two holding the header and ChunkSize slots, and the space left over past them
+//		holds as many more slots as fit rather than going to waste.
+//
+//	Use ObjectPoolManager<T, ChunkSize, BitmapObjectPool<T, ChunkSize>> to manage these.
+//
+
+namespace SEFUtility
+{
+	template <typename T, unsigned int ChunkSize>
+	class BitmapObjectPool : boost::noncopyable
+	{
+	private :
+
+		struct Chunk;
+
+	public :
+
+		static const size_t		BITS_PER_WORD = 64;
+
+		typedef T				value_type;
+
+
+		class iterator : public boost::iterator_facade<iterator, T, boost::forward_traversal_tag>
+		{
+		public :
+
+			iterator()
+				: m_chunks( NULL ),
+				  m_chunk( 0 ),
+				  m_chunkCount( 0 ),
+				  m_word( 0 ),
+				  m_remaining( 0 )
+			{}
+
+		private :
+
+			friend class BitmapObjectPool;
+			friend class boost::iterator_core_access;
+
+
+			iterator( Chunk* const*		chunks,
+					  size_t			chunk,
+					  size_t			chunkCount )
+				: m_chunks( chunks ),
+				  m_chunk( chunk ),
+				  m_chunkCount( chunkCount ),
+				  m_word( 0 ),
+				  m_remaining( chunk < chunkCount ? chunks[chunk]->m_occupied[0] : 0 )
+			{
+				skipEmptyWords();
+			}
+
+
+			void		skipEmptyWords()
+			{
+				while(( m_remaining == 0 ) && ( m_chunk < m_chunkCount ))
+				{
+					if( ++m_word == WORDS_PER_CHUNK )
+					{
+						m_word = 0;
+
+						if( ++m_chunk == m_chunkCount )
+						{
+							break;
+						}
+					}
+
+					m_remaining = m_chunks[m_chunk]->m_occupied[m_word];
+				}
+			}
+
+			void		increment()
+			{
+				m_remaining &= m_remaining - 1;
+
+				skipEmptyWords();
+			}
+
+			bool		equal( const iterator&		other ) const
+			{
+				return(( m_chunk == other.m_chunk ) && ( m_word == other.m_word ) && ( m_remaining == other.m_remaining ));
+			}
+
+			T&			dereference() const
+			{
+				return( m_chunks[m_chunk]->slots()[m_word * BITS_PER_WORD + SIMD::countTrailingZeros( m_remaining )] );
+			}
+
+
+			Chunk* const*		m_chunks;
+			size_t				m_chunk;
+			size_t				m_chunkCount;
+			size_t				m_word;
+			uint64_t			m_remaining;
+		};
+
+
+
+		~BitmapObjectPool()
+		{
+			destroyAll();
+
+			for( Chunk* chunk : m_chunks )
+			{
+				boost::alignment::aligned_free( chunk );
+			}
+		}
+
+
+		//	Destroys every live object but keeps the chunks for reuse.
+
+		void			reset()
+		{
+			destroyAll();
+
+			m_currentChunk = 0;
+			m_freeSlots = NULL;
+			m_size = 0;
+		}
+
+
+
+		iterator		begin()
+		{
+			return( iterator( m_chunks.data(), 0, m_chunks.size() ));
+		}
+
+		iterator		end()
+		{
+			return( iterator( m_chunks.data(), m_chunks.size(), m_chunks.size() ));
+		}
+
+
+		template<class Action>
+		inline void		for_each( Action&&		action )
+		{
+			for( Chunk* chunk : m_chunks )
+			{
+				T*		slots = chunk->slots();
+
+				for( size_t word = 0; word < WORDS_PER_CHUNK; word++ )
+				{
+					for( uint64_t occupied = chunk->m_occupied[word]; occupied != 0; occupied &= occupied - 1 )
+					{
+						action( slots[word * BITS_PER_WORD + SIMD::countTrailingZeros( occupied )] );
+					}
+				}
+			}
+		}
+
+
+
+		template<class... Args>
+		T*				newObject( Args&&...	args )
+		{
+			void*	slot = allocateSlot();
+			T*		newObject;
+
+			//	The slot is only marked occupied once the object is built, so one whose constructor throws
+			//		just goes back on the free list.
+
+			try
+			{
+				newObject = new( slot ) T( std::forward<Args>( args )... );
+			}
+			catch( ... )
+			{
+				m_freeSlots = new( slot ) FreeSlot( m_freeSlots );
+				throw;
+			}
+
+			setOccupied( newObject, true );
+			m_size++;
+
+			return( newObject );
+		}
+
+
+		//	Destroys the object and puts its slot on the free list, newObject() takes slots from there first.
+
+		void			free( T*		objectToFree )
+		{
+			assert( isOccupied( objectToFree ));
+
+			objectToFree->~T();
+
+			setOccupied( objectToFree, false );
+
+			m_freeSlots = new( objectToFree ) FreeSlot( m_freeSlots );
+			m_size--;
+		}
+
+
+		size_t			size() const
+		{
+			return( m_size );
+		}
+
+
+
+		//	The chunks as spans of ( first slot, slot count ), for handing to tbb::parallel_for or the like so
+		//		the objects can be processed across threads.  A span can hold freed slots, so check isLive() or
+		//		use for_each_in(), which scans the span's bitmap.  The spans are valid until the next newObject(),
+		//		free() or reset().
+
+		typedef std::pair<T*, size_t>		ChunkSpan;
+
+
+		std::vector<ChunkSpan>	chunkSpans()
+		{
+			std::vector<ChunkSpan>		spans;
+
+			for( Chunk* chunk : m_chunks )
+			{
+				if( chunk->m_used > 0 )
+				{
+					spans.push_back( ChunkSpan( chunk->slots(), chunk->m_used ));
+				}
+			}
+
+			return( spans );
+		}
+
+
+		bool					isLive( const T*		slot ) const
+		{
+			return( isOccupied( slot ));
+		}
+
+		//	The span may be any part of one returned by chunkSpans(), so the chunk's bitmap is only read from the
+		//		span's first slot to its last, with the bits outside it masked off in the words at either end.
+
+		template<class Action>
+		void					for_each_in( const ChunkSpan&		span,
+											 Action&&				action )
+		{
+			Chunk*			chunk = chunkOf( span.first );
+			T*				slots = chunk->slots();
+			size_t			first = span.first - slots;
+			size_t			last = first + span.second;
+
+			for( size_t word = first / BITS_PER_WORD; word * BITS_PER_WORD < last; word++ )
+			{
+				uint64_t		remaining = chunk->m_occupied[word];
+
+				if( word == first / BITS_PER_WORD )
+				{
+					remaining &= ~(uint64_t)0 << ( first % BITS_PER_WORD );
+				}
+
+				if(( word + 1 ) * BITS_PER_WORD > last )
+				{
+					remaining &= ~(uint64_t)0 >> (( word + 1 ) * BITS_PER_WORD - last );
+				}
+
+				for( ; remaining != 0; remaining &= remaining - 1 )
+				{
+					action( slots[word * BITS_PER_WORD + SIMD::countTrailingZeros( remaining )] );
+				}
+			}
+		}
+
+
+	protected :
+
+		BitmapObjectPool()
+			: m_currentChunk( 0 ),
+			  m_size( 0 ),
+			  m_freeSlots( NULL )
+		{
+			addChunk();
+		}
+
+
+		friend class ObjectPoolManager<T, ChunkSize, BitmapObjectPool>;
+
+
+	private :
+
+		static const size_t		CACHE_LINE_SIZE = 64;
+		static const size_t		SLOT_ALIGNMENT = alignof( T ) > CACHE_LINE_SIZE ? alignof( T ) : CACHE_LINE_SIZE;
+
+		static const size_t		CHUNK_BYTES = BitmapObjectPoolLayout::chunkBytes( ChunkSize, sizeof( T ), SLOT_ALIGNMENT );
+		static const size_t		SLOTS_PER_CHUNK = BitmapObjectPoolLayout::slotsIn( CHUNK_BYTES, sizeof( T ), SLOT_ALIGNMENT );
+		static const size_t		WORDS_PER_CHUNK = BitmapObjectPoolLayout::wordsFor( SLOTS_PER_CHUNK );
+
+
+		//	A freed slot holds the link to the next free slot in place of the object.
+
+		struct FreeSlot
+		{
+			explicit FreeSlot( FreeSlot*		next )
+				: m_next( next )
+			{}
+
+			FreeSlot*		m_next;
+		};
+
+		static_assert( sizeof( T ) >= sizeof( FreeSlot ), "Pooled objects must be large enough to hold the free list link" );
+
+
+		//	The slots follow the header from the next cache line.  m_used counts the slots handed out since the last reset.
+
+		struct Chunk
+		{
+			uint64_t		m_occupied[WORDS_PER_CHUNK];
+			uint64_t		m_used;
+
+
+			static size_t		slotsOffset()
+			{
+				return( BitmapObjectPoolLayout::roundUp( sizeof( Chunk ), SLOT_ALIGNMENT ));
+			}
+
+			T*					slots()
+			{
+				return( (T*)( (char*)this + slotsOffset() ));
+			}
+		};
+
+
+		static_assert( BitmapObjectPoolLayout::roundUp( sizeof( Chunk ), SLOT_ALIGNMENT ) + SLOTS_PER_CHUNK * sizeof( T ) <= CHUNK_BYTES, "The chunk header and slots must fit in the chunk" );
+
+
+		std::vector<Chunk*>		m_chunks;
+		size_t					m_currentChunk;
+
+		size_t					m_size;
+
+		FreeSlot*				m_freeSlots;
+
+
+
+		static Chunk*		chunkOf( const T*		object )
+		{
+			return( (Chunk*)( (uintptr_t)object & ~( (uintptr_t)CHUNK_BYTES - 1 )));
+		}
+
+		static bool			isOccupied( const T*		object )
+		{
+			Chunk*		chunk = chunkOf( object );
+			size_t		slot = object - chunk->slots();
+
+			return(( chunk->m_occupied[slot / BITS_PER_WORD] >> ( slot % BITS_PER_WORD )) & 1 );
+		}
+
+		static void			setOccupied( const T*		object,
+										 bool			occupied )
+		{
+			Chunk*		chunk = chunkOf( object );
+			size_t		slot = object - chunk->slots();
+			uint64_t	bit = (uint64_t)1 << ( slot % BITS_PER_WORD );
+
+			if( occupied )
+			{
+				chunk->m_occupied[slot / BITS_PER_WORD] |= bit;
+			}
+			else
+			{
+				chunk->m_occupied[slot / BITS_PER_WORD] &= ~bit;
+			}
+		}
+
+
+		void*				allocateSlot()
+		{
+			if( m_freeSlots != NULL )
+			{
+				FreeSlot*	slot = m_freeSlots;
+
+				m_freeSlots = slot->m_next;
+
+				return( slot );
+			}
+
+			if( m_chunks[m_currentChunk]->m_used == SLOTS_PER_CHUNK )
+			{
+				if( ++m_currentChunk == m_chunks.size() )
+				{
+					addChunk();
+				}
+			}
+
+			Chunk*		chunk = m_chunks[m_currentChunk];
+
+			return( chunk->slots() + chunk->m_used++ );
+		}
+
+		void				addChunk()
+		{
+			m_chunks.reserve( m_chunks.size() + 1 );
+
+			void*		storage = boost::alignment::aligned_alloc( CHUNK_BYTES, CHUNK_BYTES );
+
+			if( storage == NULL )
+			{
+				throw std::bad_alloc();
+			}
+
+			Chunk*		chunk = (Chunk*)storage;
+
+			memset( chunk->m_occupied, 0, sizeof( chunk->m_occupied ));
+			chunk->m_used = 0;
+
+			m_chunks.push_back( chunk );
+		}
+
+
+		void				destroyAll()
+		{
+			for( Chunk* chunk : m_chunks )
+			{
+				T*		slots = chunk->slots();
+
+				for( size_t word = 0; word < WORDS_PER_CHUNK; word++ )
+				{
+					for( uint64_t occupied = chunk->m_occupied[word]; occupied != 0; occupied &= occupied - 1 )
+					{
+						slots[word * BITS_PER_WORD + SIMD::countTrailingZeros( occupied )].~T();
+					}
+
+					chunk->m_occupied[word] = 0;
+				}
+
+				chunk->m_used = 0;
+			}
+		}
+	};
+
+}	//	namespace SEFUtility
@@ -0,0 +1,102 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+
+
+//
+//	BitmapObjectPoolLayout sizes the chunks of the pools that find an object's chunk by masking its address.
+//		Such a chunk is a power of two bytes, allocated aligned to its size, and starts with a header holding
+//		a bitmap with a bit per slot.  The functions are constexpr so a pool's layout is fixed at compile time.
+//
+
+namespace SEFUtility
+{
+	namespace BitmapObjectPoolLayout
+	{
+		const size_t		BITS_PER_WORD = 64;
+
+
+		constexpr size_t		wordsFor( size_t		slots )
+		{
+			return(( slots + BITS_PER_WORD - 1 ) / BITS_PER_WORD );
+		}
+
+		constexpr size_t		roundUp( size_t		bytes,
+										 size_t		alignment )
+		{
+			return(( bytes + alignment - 1 ) & ~( alignment - 1 ));
+		}
+
+		//	The chunk header is the occupancy bitmap and fixedBytes of other fields, BitmapObjectPool's count of slots
+		//		used by default.  The slots start at the next alignment boundary.
+
+		constexpr size_t		headerBytes( size_t		slots,
+											 size_t		alignment,
+											 size_t		fixedBytes = sizeof( uint64_t ) )
+		{
+			return( roundUp( wordsFor( slots ) * sizeof( uint64_t ) + fixedBytes, alignment ));
+		}
+
+		constexpr size_t		nextPowerOfTwo( size_t		bytes,
+												size_t		power = 1 )
+		{
+			return( power >= bytes ? power : nextPowerOfTwo( bytes, power * 2 ));
+		}
+
+		//	The slots that fit in a chunk, the header is sized for the most slots the chunk could hold without one.
+
+		constexpr size_t		slotsIn( size_t		chunkBytes,
+										 size_t		slotBytes,
+										 size_t		alignment,
+										 size_t		fixedBytes = sizeof( uint64_t ) )
+		{
+			return(( chunkBytes - headerBytes( chunkBytes / slotBytes, alignment, fixedBytes )) / slotBytes );
+		}
+
+		//	The smallest power of two bytes holding at least minimumSlots slots and the header.
+
+		constexpr size_t		chunkBytes( size_t		minimumSlots,
+											size_t		slotBytes,
+											size_t		alignment,
+											size_t		fixedBytes = sizeof( uint64_t ),
+											size_t		bytes = 0 )
+		{
+			return( bytes == 0 ? chunkBytes( minimumSlots, slotBytes, alignment, fixedBytes, nextPowerOfTwo( headerBytes( minimumSlots, alignment, fixedBytes ) + minimumSlots * slotBytes )) :
+					slotsIn( bytes, slotBytes, alignment, fixedBytes ) >= minimumSlots ? bytes : chunkBytes( minimumSlots, slotBytes, alignment, fixedBytes, bytes * 2 ));
+		}
+	}
+
+}	//	namespace SEFUtility
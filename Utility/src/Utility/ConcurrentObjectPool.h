@@ -0,0 +1,494 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+#pragma once
+
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <boost/align/aligned_alloc.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+
+#include "BitmapObjectPoolLayout.h"
+#include "ThreadIndex.h"
+
+
+
+
+//
+//	ConcurrentObjectPool is one pool that any number of threads allocate from at once.  Each thread has a heap
+//		of its own chunks, indexed by ThreadIndex, and newObject() only ever touches the calling thread's
+//		heap, so it runs without atomics or locks.  free() called by the thread owning the object's chunk
+//		puts the slot straight back on that thread's free list.  Called from any other thread it destroys
+//		the object and pushes the slot onto the owner's remote free queue, a lock free stack the owner
+//		empties in one exchange when its free list runs dry.
+//
+//	Every chunk is a power of two bytes, allocated aligned to its size, and starts with a header naming its
+//		owning heap, so free() finds the owner by masking the object's address.  As in BitmapObjectPool the
+//		layout is fixed at compile time: a chunk is the smallest power of two holding the header and
+//		ChunkSize slots, and the space left over holds as many more slots as fit.  Liveness is a bit per
+//		slot in the chunk header rather than links in the objects, so pooled types need not derive from
+//		ObjectPoolable.
+//
+//	Iteration and size() are only meaningful while the pool is quiescent, that is with no thread allocating
+//		or freeing.  begin() first returns every slot waiting on a remote free queue to its owner.
+//
+//	A heap outlives its thread, the next thread given the same ThreadIndex takes it over.
+//
+
+namespace SEFUtility
+{
+
+	template <typename T, unsigned int ChunkSize>
+	class ConcurrentObjectPool : boost::noncopyable
+	{
+	private :
+
+		struct Chunk;
+		struct ThreadHeap;
+
+	public :
+
+		typedef T		value_type;
+
+
+		class iterator : public boost::iterator_facade<iterator, T, boost::forward_traversal_tag>
+		{
+		public :
+
+			iterator()
+				: m_heaps( NULL ),
+				  m_heap( ThreadIndex::MAX_THREADS ),
+				  m_chunk( 0 ),
+				  m_slot( 0 )
+			{}
+
+		private :
+
+			friend class ConcurrentObjectPool;
+			friend class boost::iterator_core_access;
+
+
+			iterator( ThreadHeap* const*		heaps,
+					  size_t					heap )
+				: m_heaps( heaps ),
+				  m_heap( heap ),
+				  m_chunk( 0 ),
+				  m_slot( 0 )
+			{
+				skipDead();
+			}
+
+
+			//	Moves forward to the first live slot at or after the current position, across chunks and heaps.
+
+			void		skipDead()
+			{
+				for( ; m_heap < ThreadIndex::MAX_THREADS; m_heap++, m_chunk = 0, m_slot = 0 )
+				{
+					if( m_heaps[m_heap] == NULL )
+					{
+						continue;
+					}
+
+					const std::vector<Chunk*>&		chunks = m_heaps[m_heap]->m_chunks;
+
+					for( ; m_chunk < chunks.size(); m_chunk++, m_slot = 0 )
+					{
+						for( ; m_slot < chunks[m_chunk]->m_used; m_slot++ )
+						{
+							if( chunks[m_chunk]->isLive( m_slot ))
+							{
+								return;
+							}
+						}
+					}
+				}
+
+				m_chunk = 0;
+				m_slot = 0;
+			}
+
+			void		increment()
+			{
+				m_slot++;
+
+				skipDead();
+			}
+
+			bool		equal( const iterator&		other ) const
+			{
+				return(( m_heap == other.m_heap ) && ( m_chunk == other.m_chunk ) && ( m_slot == other.m_slot ));
+			}
+
+			T&			dereference() const
+			{
+				return( m_heaps[m_heap]->m_chunks[m_chunk]->slots()[m_slot] );
+			}
+
+
+			ThreadHeap* const*		m_heaps;
+			size_t					m_heap;
+			size_t					m_chunk;
+			size_t					m_slot;
+		};
+
+
+
+		ConcurrentObjectPool()
+		{
+			for( ThreadHeap*& heap : m_heaps )
+			{
+				heap = NULL;
+			}
+		}
+
+		//	No thread may be allocating or freeing while the pool is destroyed.  Objects still live are destroyed.
+
+		~ConcurrentObjectPool()
+		{
+			for( ThreadHeap* heap : m_heaps )
+			{
+				if( heap == NULL )
+				{
+					continue;
+				}
+
+				collectRemoteFrees( *heap );
+
+				for( Chunk* chunk : heap->m_chunks )
+				{
+					for( size_t i = 0; i < chunk->m_used; i++ )
+					{
+						if( chunk->isLive( i ))
+						{
+							chunk->slots()[i].~T();
+						}
+					}
+
+					boost::alignment::aligned_free( chunk );
+				}
+
+				delete heap;
+			}
+		}
+
+
+
+		template<class... Args>
+		T*				newObject( Args&&...	args )
+		{
+			ThreadHeap&		heap = currentHeap();
+
+			void*			slot = allocateSlot( heap );
+			T*				newObject;
+
+			//	The slot is not marked live until the object is built, so one whose constructor throws only
+			//		has to go back on the free list.
+
+			try
+			{
+				newObject = new( slot ) T( std::forward<Args>( args )... );
+			}
+			catch( ... )
+			{
+				heap.m_freeSlots = new( slot ) FreeSlot( heap.m_freeSlots );
+				throw;
+			}
+
+			Chunk*			chunk = chunkOf( newObject );
+
+			chunk->setLive( newObject - chunk->slots(), true );
+			heap.m_size++;
+
+			return( newObject );
+		}
+
+
+		//	May be called from any thread, not just the one which allocated the object.
+
+		void			free( T*		objectToFree )
+		{
+			Chunk*			chunk = chunkOf( objectToFree );
+			ThreadHeap*		owner = chunk->m_owner;
+
+			objectToFree->~T();
+
+			if( owner == m_heaps[ThreadIndex::current()] )
+			{
+				chunk->setLive( objectToFree - chunk->slots(), false );
+				owner->m_freeSlots = new( objectToFree ) FreeSlot( owner->m_freeSlots );
+				owner->m_size--;
+
+				return;
+			}
+
+			FreeSlot*		slot = new( objectToFree ) FreeSlot( owner->m_remoteFrees.load( std::memory_order_relaxed ));
+
+			while( !owner->m_remoteFrees.compare_exchange_weak( slot->m_next, slot, std::memory_order_release, std::memory_order_relaxed ))
+			{}
+		}
+
+
+
+		iterator		begin()
+		{
+			for( ThreadHeap* heap : m_heaps )
+			{
+				if( heap != NULL )
+				{
+					collectRemoteFrees( *heap );
+				}
+			}
+
+			return( iterator( m_heaps, 0 ));
+		}
+
+		iterator		end()
+		{
+			return( iterator( m_heaps, ThreadIndex::MAX_THREADS ));
+		}
+
+
+		//	Objects freed by other threads but not yet collected by their owner are not counted.
+
+		size_t			size() const
+		{
+			size_t		liveObjects = 0;
+
+			for( const ThreadHeap* heap : m_heaps )
+			{
+				if( heap == NULL )
+				{
+					continue;
+				}
+
+				liveObjects += heap->m_size;
+
+				for( const FreeSlot* slot = heap->m_remoteFrees.load( std::memory_order_acquire ); slot != NULL; slot = slot->m_next )
+				{
+					liveObjects--;
+				}
+			}
+
+			return( liveObjects );
+		}
+
+
+	private :
+
+		static const size_t		CACHE_LINE_SIZE = 64;
+		static const size_t		BITS_PER_WORD = BitmapObjectPoolLayout::BITS_PER_WORD;
+
+		//	The chunk header holds the owner and the count of slots used besides the bitmap
+
+		static const size_t		HEADER_FIELD_BYTES = sizeof( ThreadHeap* ) + sizeof( uint64_t );
+
+		static const size_t		CHUNK_BYTES = BitmapObjectPoolLayout::chunkBytes( ChunkSize, sizeof( T ), alignof( T ), HEADER_FIELD_BYTES );
+		static const size_t		SLOTS_PER_CHUNK = BitmapObjectPoolLayout::slotsIn( CHUNK_BYTES, sizeof( T ), alignof( T ), HEADER_FIELD_BYTES );
+		static const size_t		WORDS_PER_CHUNK = BitmapObjectPoolLayout::wordsFor( SLOTS_PER_CHUNK );
+
+
+		//	A freed slot holds the link to the next free slot in place of the object.
+
+		struct FreeSlot
+		{
+			explicit FreeSlot( FreeSlot*		next )
+				: m_next( next )
+			{}
+
+			FreeSlot*		m_next;
+		};
+
+		static_assert( sizeof( T ) >= sizeof( FreeSlot ), "Pooled objects must be large enough to hold the free list link" );
+
+
+		//	The slots follow the header, aligned for T.  m_used counts the slots handed out at least once.
+
+		struct Chunk
+		{
+			ThreadHeap*		m_owner;
+			uint64_t		m_used;
+			uint64_t		m_live[WORDS_PER_CHUNK];
+
+
+			static size_t		slotsOffset()
+			{
+				return( BitmapObjectPoolLayout::roundUp( sizeof( Chunk ), alignof( T ) ));
+			}
+
+			T*					slots()
+			{
+				return( (T*)( (char*)this + slotsOffset() ));
+			}
+
+			bool				isLive( size_t		slot ) const
+			{
+				return(( m_live[slot / BITS_PER_WORD] >> ( slot % BITS_PER_WORD )) & 1 );
+			}
+
+			void				setLive( size_t		slot,
+										 bool		live )
+			{
+				uint64_t		bit = (uint64_t)1 << ( slot % BITS_PER_WORD );
+
+				if( live )
+				{
+					m_live[slot / BITS_PER_WORD] |= bit;
+				}
+				else
+				{
+					m_live[slot / BITS_PER_WORD] &= ~bit;
+				}
+			}
+		};
+
+		static_assert( BitmapObjectPoolLayout::roundUp( sizeof( Chunk ), alignof( T ) ) + SLOTS_PER_CHUNK * sizeof( T ) <= CHUNK_BYTES, "The chunk header and slots must fit in the chunk" );
+
+
+		//	The owner's fields and the remote free queue other threads push onto sit on separate cache lines.
+
+		struct ThreadHeap
+		{
+			ThreadHeap()
+				: m_freeSlots( NULL ),
+				  m_size( 0 ),
+				  m_remoteFrees( NULL )
+			{}
+
+			std::vector<Chunk*>			m_chunks;
+			FreeSlot*					m_freeSlots;
+			size_t						m_size;
+
+			char						m_padding[CACHE_LINE_SIZE];
+
+			std::atomic<FreeSlot*>		m_remoteFrees;
+		};
+
+
+		ThreadHeap*			m_heaps[ThreadIndex::MAX_THREADS];
+
+
+
+		static Chunk*		chunkOf( const T*		object )
+		{
+			return( (Chunk*)( (uintptr_t)object & ~( (uintptr_t)CHUNK_BYTES - 1 )));
+		}
+
+
+		ThreadHeap&			currentHeap()
+		{
+			ThreadHeap*&		heap = m_heaps[ThreadIndex::current()];
+
+			if( heap == NULL )
+			{
+				heap = new ThreadHeap();
+			}
+
+			return( *heap );
+		}
+
+
+		void*				allocateSlot( ThreadHeap&		heap )
+		{
+			if(( heap.m_freeSlots == NULL ) && ( heap.m_remoteFrees.load( std::memory_order_relaxed ) != NULL ))
+			{
+				collectRemoteFrees( heap );
+			}
+
+			if( heap.m_freeSlots != NULL )
+			{
+				FreeSlot*	slot = heap.m_freeSlots;
+
+				heap.m_freeSlots = slot->m_next;
+
+				return( slot );
+			}
+
+			if( heap.m_chunks.empty() || ( heap.m_chunks.back()->m_used == SLOTS_PER_CHUNK ))
+			{
+				addChunk( heap );
+			}
+
+			Chunk*		chunk = heap.m_chunks.back();
+
+			return( chunk->slots() + chunk->m_used++ );
+		}
+
+		void				addChunk( ThreadHeap&		heap )
+		{
+			heap.m_chunks.reserve( heap.m_chunks.size() + 1 );
+
+			void*		storage = boost::alignment::aligned_alloc( CHUNK_BYTES, CHUNK_BYTES );
+
+			if( storage == NULL )
+			{
+				throw std::bad_alloc();
+			}
+
+			Chunk*		chunk = (Chunk*)storage;
+
+			chunk->m_owner = &heap;
+			chunk->m_used = 0;
+			memset( chunk->m_live, 0, sizeof( chunk->m_live ));
+
+			heap.m_chunks.push_back( chunk );
+		}
+
+
+		//	Takes the whole remote free queue in one exchange and moves its slots onto the owner's free list.
+
+		static void			collectRemoteFrees( ThreadHeap&		heap )
+		{
+			FreeSlot*		slot = heap.m_remoteFrees.exchange( NULL, std::memory_order_acquire );
+
+			while( slot != NULL )
+			{
+				FreeSlot*		next = slot->m_next;
+				Chunk*			chunk = chunkOf( (T*)slot );
+
+				chunk->setLive( (T*)slot - chunk->slots(), false );
+
+				heap.m_freeSlots = new( slot ) FreeSlot( heap.m_freeSlots );
+				heap.m_size--;
+
+				slot = next;
+			}
+		}
+	};
+
+}	//	namespace SEFUtility
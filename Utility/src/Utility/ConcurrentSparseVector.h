@@ -0,0 +1,418 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <limits>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include <boost/noncopyable.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+
+#include <tbb/concurrent_unordered_map.h>
+
+#include "SparseVector.h"
+
+
+
+
+//
+//	ConcurrentSparseVector lets any number of threads call find_or_add(), find() and operator[] on the same
+//		vector, and iterate it, while others are adding entries.  Entries are never moved once added, so
+//		the references handed out stay valid for the life of the vector.
+//
+//	The inline tier is an array of slots claimed without locks.  A thread adding an index scans the slots
+//		in order and claims the first empty one by compare-and-swapping the index into it.  Every claim
+//		goes to the first empty slot, so the claimed slots always form a prefix of the array, and two
+//		threads adding the same index meet at the same slot - the loser sees the winner's index there.
+//		The winner then constructs the payload and marks the slot ready; anyone else that found the
+//		index waits for that flag before handing out the entry.
+//
+//	If the payload's constructor throws, the winner marks the slot failed and rethrows.  A failed slot
+//		stays claimed so the claimed slots remain a prefix, but it holds no entry: searches step past
+//		it, and a later find_or_add() of the same index claims a fresh slot.
+//
+//	Once the inline slots are all claimed, further indices go to a tbb::concurrent_unordered_map created
+//		on first use.  The inline entries stay where they are, so there is no migration to race with.
+//
+//	Erasing entries is not supported.  The largest value of the index type is reserved to mark empty slots.
+//
+
+
+namespace SEFUtility
+{
+
+	template<class T, long CUTOVER_SIZE, class IndexType = typename SparseVectorIndexType<T>::type>
+	class ConcurrentSparseVector : boost::noncopyable
+	{
+	private :
+
+		typedef tbb::concurrent_unordered_map<IndexType, T>			EntryMap;
+		typedef typename EntryMap::iterator							EntryMapIterator;
+
+		static const IndexType		EMPTY_SLOT = std::numeric_limits<IndexType>::max();
+
+	public :
+
+		typedef IndexType		index_type;
+
+
+		//	Visits the ready inline entries and then the map.  Entries added while the iteration is underway
+		//		may or may not be visited, but every entry present when it started will be.
+
+		class iterator : public boost::iterator_facade<iterator, T*, boost::forward_traversal_tag, T*>
+		{
+		protected :
+
+			friend class ConcurrentSparseVector;
+			friend class boost::iterator_core_access;
+
+
+			iterator( ConcurrentSparseVector*	owner )
+				: m_owner( owner ),
+				  m_slot( 0 ),
+				  m_inMap( false ),
+				  m_done( owner == NULL )
+			{
+				if( !m_done )
+				{
+					skipUnready();
+				}
+			}
+
+
+			void		skipUnready()
+			{
+				for( ; m_slot < CUTOVER_SIZE; m_slot++ )
+				{
+					IndexType	slotIndex = m_owner->m_slotIndices[m_slot].load( std::memory_order_acquire );
+
+					if( slotIndex == EMPTY_SLOT )
+					{
+						break;
+					}
+
+					if( m_owner->m_slotStates[m_slot].load( std::memory_order_acquire ) == SLOT_READY )
+					{
+						return;
+					}
+				}
+
+				EntryMap*		map = m_owner->m_map.load( std::memory_order_acquire );
+
+				m_inMap = true;
+				m_done = ( map == NULL );
+
+				if( !m_done )
+				{
+					m_mapIterator = map->begin();
+					m_done = ( m_mapIterator == map->end() );
+				}
+			}
+
+			void		increment()
+			{
+				if( !m_inMap )
+				{
+					m_slot++;
+					skipUnready();
+				}
+				else
+				{
+					++m_mapIterator;
+					m_done = ( m_mapIterator == m_owner->m_map.load( std::memory_order_acquire )->end() );
+				}
+			}
+
+			bool		equal( iterator const&		other ) const
+			{
+				if( m_done || other.m_done )
+				{
+					return( m_done == other.m_done );
+				}
+
+				if( m_inMap != other.m_inMap )
+				{
+					return( false );
+				}
+
+				return( m_inMap ? m_mapIterator == other.m_mapIterator : m_slot == other.m_slot );
+			}
+
+			T*			dereference() const
+			{
+				if( m_inMap )
+				{
+					return( &m_mapIterator->second );
+				}
+
+				return( m_owner->slotPayload( m_slot ) );
+			}
+
+
+			ConcurrentSparseVector*		m_owner;
+
+			long						m_slot;
+			bool						m_inMap;
+			bool						m_done;
+
+			EntryMapIterator			m_mapIterator;
+		};
+
+
+
+		ConcurrentSparseVector()
+			: m_inlineCount( 0 ),
+			  m_map( NULL )
+		{
+			for( long i = 0; i < CUTOVER_SIZE; i++ )
+			{
+				m_slotIndices[i].store( EMPTY_SLOT, std::memory_order_relaxed );
+				m_slotStates[i].store( SLOT_PENDING, std::memory_order_relaxed );
+			}
+		}
+
+		~ConcurrentSparseVector()
+		{
+			for( long i = 0; i < CUTOVER_SIZE; i++ )
+			{
+				if( m_slotStates[i].load( std::memory_order_relaxed ) == SLOT_READY )
+				{
+					slotPayload( i )->~T();
+				}
+			}
+
+			delete m_map.load( std::memory_order_relaxed );
+		}
+
+
+
+		//	Exact when no insertions are in flight, otherwise a snapshot that may already be out of date.
+
+		size_t				size() const
+		{
+			EntryMap*		map = m_map.load( std::memory_order_acquire );
+
+			return( m_inlineCount.load( std::memory_order_acquire ) + ( map != NULL ? map->size() : 0 ) );
+		}
+
+		bool				empty() const
+		{
+			return( size() == 0 );
+		}
+
+
+		iterator			begin()
+		{
+			return( iterator( this ) );
+		}
+
+		iterator			end()
+		{
+			return( iterator( NULL ) );
+		}
+
+
+
+		T*					find( IndexType		index )
+		{
+			assert( index != EMPTY_SLOT );
+
+			for( long i = 0; i < CUTOVER_SIZE; i++ )
+			{
+				IndexType	slotIndex = m_slotIndices[i].load( std::memory_order_acquire );
+
+				if(( slotIndex == index ) && waitUntilSettled( i ))
+				{
+					return( slotPayload( i ) );
+				}
+
+				if( slotIndex == EMPTY_SLOT )
+				{
+					return( NULL );
+				}
+			}
+
+			EntryMap*		map = m_map.load( std::memory_order_acquire );
+
+			if( map == NULL )
+			{
+				return( NULL );
+			}
+
+			EntryMapIterator	itrEntry = map->find( index );
+
+			return( itrEntry != map->end() ? &itrEntry->second : NULL );
+		}
+
+
+		T&					operator[]( IndexType		index )
+		{
+			T*		entry = find( index );
+
+			//	If we did not find the entry there is no choice but assert
+
+			assert( entry != NULL );
+
+			return( *entry );
+		}
+
+
+		T&					find_or_add( IndexType		index )
+		{
+			assert( index != EMPTY_SLOT );
+
+			for( long i = 0; i < CUTOVER_SIZE; i++ )
+			{
+				IndexType	slotIndex = m_slotIndices[i].load( std::memory_order_acquire );
+
+				if(( slotIndex == EMPTY_SLOT ) &&
+				   m_slotIndices[i].compare_exchange_strong( slotIndex, index, std::memory_order_acq_rel, std::memory_order_acquire ))
+				{
+					//	We own the slot, construct the payload and publish it
+
+					try
+					{
+						new( slotPayload( i ) ) T( index );
+					}
+					catch( ... )
+					{
+						m_slotStates[i].store( SLOT_FAILED, std::memory_order_release );
+						throw;
+					}
+
+					m_inlineCount.fetch_add( 1, std::memory_order_release );
+					m_slotStates[i].store( SLOT_READY, std::memory_order_release );
+
+					return( *slotPayload( i ) );
+				}
+
+				//	Either the slot was already claimed or another thread just claimed it, slotIndex holds its index.
+				//		A slot whose construction failed holds no entry, so the search carries on past it.
+
+				if(( slotIndex == index ) && waitUntilSettled( i ))
+				{
+					return( *slotPayload( i ) );
+				}
+			}
+
+			EntryMap*		map = mapForInsert();
+
+			EntryMapIterator	itrEntry = map->find( index );
+
+			if( itrEntry != map->end() )
+			{
+				return( itrEntry->second );
+			}
+
+			return( map->insert( typename EntryMap::value_type( index, T( index ) ) ).first->second );
+		}
+
+
+
+		inline void			for_each( std::function<void( T &entry )> action )
+		{
+			for( iterator itrEntry = begin(); itrEntry != end(); ++itrEntry )
+			{
+				action( **itrEntry );
+			}
+		}
+
+
+	private :
+
+		typedef typename std::aligned_storage<sizeof( T ), __alignof( T )>::type		PayloadStorage;
+
+		//	A claimed slot is pending until its payload is constructed, then ready, or failed if the constructor threw
+
+		static const unsigned char		SLOT_PENDING = 0;
+		static const unsigned char		SLOT_READY = 1;
+		static const unsigned char		SLOT_FAILED = 2;
+
+
+		std::atomic<IndexType>			m_slotIndices[CUTOVER_SIZE];
+		std::atomic<unsigned char>		m_slotStates[CUTOVER_SIZE];
+
+		PayloadStorage					m_slotPayloads[CUTOVER_SIZE];
+
+		std::atomic<size_t>				m_inlineCount;
+
+		std::atomic<EntryMap*>			m_map;
+
+
+		T*					slotPayload( long		slot )
+		{
+			return( reinterpret_cast<T*>( &m_slotPayloads[slot] ) );
+		}
+
+		//	Another thread claimed the slot and may still be constructing the payload.  Returns true once the
+		//		payload is ready and false if its constructor threw.
+
+		bool				waitUntilSettled( long		slot )
+		{
+			unsigned char		state;
+
+			while(( state = m_slotStates[slot].load( std::memory_order_acquire )) == SLOT_PENDING )
+			{
+				std::this_thread::yield();
+			}
+
+			return( state == SLOT_READY );
+		}
+
+		//	The first thread to overflow the inline slots creates the map, anyone who loses the race uses the winner's.
+
+		EntryMap*			mapForInsert()
+		{
+			EntryMap*		map = m_map.load( std::memory_order_acquire );
+
+			if( map != NULL )
+			{
+				return( map );
+			}
+
+			EntryMap*		newMap = new EntryMap( CUTOVER_SIZE * 4 );
+
+			if( m_map.compare_exchange_strong( map, newMap, std::memory_order_acq_rel, std::memory_order_acquire ))
+			{
+				return( newMap );
+			}
+
+			delete newMap;
+
+			return( map );
+		}
+	};
+
+}	//	namespace SEFUtility
@@ -0,0 +1,488 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <utility>
+
+#include <boost/align/aligned_alloc.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+
+#include "SIMDIndexSearch.h"
+#include "TieringStats.h"
+
+
+
+
+//
+//	DenseIndexMap holds entries whose indices fall in a narrow window [base, base + span).  Each index
+//		in the window has a payload slot and a bit in an occupancy bitmap, so a lookup is a subtraction
+//		and a bit test.  Iteration walks the bitmap a word at a time and jumps straight to the set bits.
+//
+//	The window only grows, and growing moves the entries, so pointers and iterators into the map are
+//		only stable until an insertion outside the current window.  Deciding whether the indices are
+//		still clustered enough to be worth a dense window is left to the caller.
+//
+
+
+namespace SEFUtility
+{
+
+	template<class T, class IndexType = size_t, class StatsOwner = void>
+	class DenseIndexMap : boost::noncopyable
+	{
+	public :
+
+		static const size_t		BITS_PER_WORD = 64;
+
+
+		template<class Value>
+		class basic_iterator : public boost::iterator_facade<basic_iterator<Value>, Value, boost::forward_traversal_tag>
+		{
+		public :
+
+			basic_iterator()
+				: m_words( NULL ),
+				  m_slots( NULL ),
+				  m_wordCount( 0 ),
+				  m_word( 0 ),
+				  m_remaining( 0 )
+			{}
+
+			template<class OtherValue>
+			basic_iterator( const basic_iterator<OtherValue>&		other )
+				: m_words( other.m_words ),
+				  m_slots( other.m_slots ),
+				  m_wordCount( other.m_wordCount ),
+				  m_word( other.m_word ),
+				  m_remaining( other.m_remaining )
+			{}
+
+		private :
+
+			friend class DenseIndexMap;
+			friend class boost::iterator_core_access;
+			template<class> friend class basic_iterator;
+
+
+			basic_iterator( const uint64_t*		words,
+							Value*				slots,
+							size_t				wordCount,
+							size_t				word )
+				: m_words( words ),
+				  m_slots( slots ),
+				  m_wordCount( wordCount ),
+				  m_word( word ),
+				  m_remaining( word < wordCount ? words[word] : 0 )
+			{
+				skipEmptyWords();
+			}
+
+
+			void		skipEmptyWords()
+			{
+				while(( m_remaining == 0 ) && ( m_word < m_wordCount ))
+				{
+					if( ++m_word < m_wordCount )
+					{
+						m_remaining = m_words[m_word];
+					}
+				}
+			}
+
+			void		increment()
+			{
+				m_remaining &= m_remaining - 1;
+
+				skipEmptyWords();
+			}
+
+			template<class OtherValue>
+			bool		equal( const basic_iterator<OtherValue>&		other ) const
+			{
+				return(( m_word == other.m_word ) && ( m_remaining == other.m_remaining ));
+			}
+
+			Value&		dereference() const
+			{
+				return( m_slots[m_word * BITS_PER_WORD + SIMD::countTrailingZeros( m_remaining )] );
+			}
+
+
+			const uint64_t*		m_words;
+			Value*				m_slots;
+			size_t				m_wordCount;
+			size_t				m_word;
+			uint64_t			m_remaining;
+		};
+
+		typedef basic_iterator<T>				iterator;
+		typedef basic_iterator<const T>			const_iterator;
+
+
+
+		DenseIndexMap( IndexType		minIndex,
+					   IndexType		maxIndex )
+			: m_size( 0 )
+		{
+			allocate( minIndex, wordsFor( maxIndex - minIndex + 1 ) );
+		}
+
+		~DenseIndexMap()
+		{
+			destroyEntries();
+
+			SEFUTILITY_TIERING_STAT( tieringCounters().allocated( TIERING_TIER_DENSE, -(int64_t)memoryUsed() ) );
+
+			boost::alignment::aligned_free( m_storage );
+		}
+
+
+
+		size_t				size() const
+		{
+			return( m_size );
+		}
+
+		bool				empty() const
+		{
+			return( m_size == 0 );
+		}
+
+		IndexType			base() const
+		{
+			return( m_base );
+		}
+
+		size_t				span() const
+		{
+			return( m_wordCount * BITS_PER_WORD );
+		}
+
+		size_t				memoryUsed() const
+		{
+			return( m_wordCount * ( sizeof( uint64_t ) + BITS_PER_WORD * sizeof( T ) ) );
+		}
+
+
+
+		iterator			begin()
+		{
+			return( iterator( m_bitmap, m_slots, m_wordCount, 0 ) );
+		}
+
+		const_iterator		begin() const
+		{
+			return( const_iterator( m_bitmap, m_slots, m_wordCount, 0 ) );
+		}
+
+		iterator			end()
+		{
+			return( iterator( m_bitmap, m_slots, m_wordCount, m_wordCount ) );
+		}
+
+		const_iterator		end() const
+		{
+			return( const_iterator( m_bitmap, m_slots, m_wordCount, m_wordCount ) );
+		}
+
+
+
+		bool				covers( IndexType		index ) const
+		{
+			return(( index >= m_base ) && ( (size_t)( index - m_base ) < span() ));
+		}
+
+		T*					find( IndexType		index )
+		{
+			if( !covers( index ) )
+			{
+				return( NULL );
+			}
+
+			size_t		offset = index - m_base;
+
+			return( isOccupied( offset ) ? m_slots + offset : NULL );
+		}
+
+		const T*			find( IndexType		index ) const
+		{
+			return( const_cast<DenseIndexMap*>( this )->find( index ) );
+		}
+
+
+		//	Adds an entry known not to be present yet, growing the window if needed.
+
+		T&					emplace_unique( IndexType		index )
+		{
+			if( !covers( index ) )
+			{
+				grow( index );
+			}
+
+			size_t		offset = index - m_base;
+
+			m_bitmap[offset / BITS_PER_WORD] |= (uint64_t)1 << ( offset % BITS_PER_WORD );
+			m_size++;
+
+			return( *new( m_slots + offset ) T( index ) );
+		}
+
+		T&					insert_unique( T&&		entry )
+		{
+			IndexType	index = entry.index();
+
+			if( !covers( index ) )
+			{
+				grow( index );
+			}
+
+			size_t		offset = index - m_base;
+
+			m_bitmap[offset / BITS_PER_WORD] |= (uint64_t)1 << ( offset % BITS_PER_WORD );
+			m_size++;
+
+			return( *new( m_slots + offset ) T( std::move( entry ) ) );
+		}
+
+
+		bool				erase( IndexType		index )
+		{
+			T*		entry = find( index );
+
+			if( entry == NULL )
+			{
+				return( false );
+			}
+
+			size_t		offset = entry - m_slots;
+
+			entry->~T();
+
+			m_bitmap[offset / BITS_PER_WORD] &= ~( (uint64_t)1 << ( offset % BITS_PER_WORD ) );
+			m_size--;
+
+			return( true );
+		}
+
+
+		template<class Action>
+		inline void			for_each( Action&&		action )
+		{
+			for( size_t word = 0; word < m_wordCount; word++ )
+			{
+				for( uint64_t occupied = m_bitmap[word]; occupied != 0; occupied &= occupied - 1 )
+				{
+					action( m_slots[word * BITS_PER_WORD + SIMD::countTrailingZeros( occupied )] );
+				}
+			}
+		}
+
+
+		//	Hands runs of adjacent occupied slots to the visitor as ( const IndexType* indices, T* entries, size_t count ).
+		//		The indices follow from the slot positions, so building them never touches the entries.
+
+		template<class Visitor>
+		void				for_each_chunk( Visitor&&		visitor )
+		{
+			IndexType		indices[MAX_CHUNK_SIZE];
+			size_t			runStart = 0;
+			size_t			runLength = 0;
+
+			for( size_t word = 0; word < m_wordCount; word++ )
+			{
+				for( uint64_t occupied = m_bitmap[word]; occupied != 0; occupied &= occupied - 1 )
+				{
+					size_t		offset = word * BITS_PER_WORD + SIMD::countTrailingZeros( occupied );
+
+					if(( runLength == MAX_CHUNK_SIZE ) || (( runLength > 0 ) && ( runStart + runLength != offset )))
+					{
+						visitor( (const IndexType*)indices, m_slots + runStart, runLength );
+						runLength = 0;
+					}
+
+					if( runLength == 0 )
+					{
+						runStart = offset;
+					}
+
+					indices[runLength++] = m_base + (IndexType)offset;
+				}
+			}
+
+			if( runLength > 0 )
+			{
+				visitor( (const IndexType*)indices, m_slots + runStart, runLength );
+			}
+		}
+
+
+		//	Applies the action to the entries in slot offsets [first, last), which must be multiples of
+		//		BITS_PER_WORD.  Used to split the window into independent ranges for parallel iteration.
+
+		template<class Action>
+		void				for_each_in_slots( size_t		first,
+											   size_t		last,
+											   Action&&		action )
+		{
+			for( size_t word = first / BITS_PER_WORD; word < last / BITS_PER_WORD; word++ )
+			{
+				for( uint64_t occupied = m_bitmap[word]; occupied != 0; occupied &= occupied - 1 )
+				{
+					action( m_slots[word * BITS_PER_WORD + SIMD::countTrailingZeros( occupied )] );
+				}
+			}
+		}
+
+
+	private :
+
+		static const size_t		MAX_CHUNK_SIZE = 64;
+		static const size_t		CACHE_LINE_SIZE = 64;
+
+
+		IndexType			m_base;
+
+		uint64_t*			m_bitmap;
+		T*					m_slots;
+		void*				m_storage;
+
+		size_t				m_wordCount;
+		size_t				m_size;
+
+
+		static size_t		wordsFor( size_t		span )
+		{
+			return(( span + BITS_PER_WORD - 1 ) / BITS_PER_WORD );
+		}
+
+		bool				isOccupied( size_t		offset ) const
+		{
+			return(( m_bitmap[offset / BITS_PER_WORD] >> ( offset % BITS_PER_WORD )) & 1 );
+		}
+
+
+		//	One allocation holds the bitmap followed by the payload slots, which start on a cache line so
+		//		ranges of whole cache lines can be handed to different threads.
+
+		void				allocate( IndexType		base,
+									  size_t		wordCount )
+		{
+			static_assert( __alignof( T ) <= CACHE_LINE_SIZE, "DenseIndexMap slots are aligned to a cache line" );
+
+			size_t		bitmapBytes = (( wordCount * sizeof( uint64_t ) + CACHE_LINE_SIZE - 1 ) / CACHE_LINE_SIZE ) * CACHE_LINE_SIZE;
+
+			m_storage = boost::alignment::aligned_alloc( CACHE_LINE_SIZE, bitmapBytes + wordCount * BITS_PER_WORD * sizeof( T ) );
+
+			if( m_storage == NULL )
+			{
+				throw std::bad_alloc();
+			}
+
+			m_base = base;
+			m_wordCount = wordCount;
+			m_bitmap = (uint64_t*)m_storage;
+			m_slots = (T*)( (char*)m_storage + bitmapBytes );
+
+			memset( m_bitmap, 0, wordCount * sizeof( uint64_t ) );
+
+			SEFUTILITY_TIERING_STAT( tieringCounters().allocated( TIERING_TIER_DENSE, (int64_t)memoryUsed() ) );
+		}
+
+#if defined( SEFUTILITY_TIERING_STATS )
+		static TieringCounters&		tieringCounters()
+		{
+			return( TieringStats::countersFor<typename TieringOwner<StatsOwner, DenseIndexMap>::type>() );
+		}
+#endif
+
+		void				destroyEntries()
+		{
+			for( size_t word = 0; word < m_wordCount; word++ )
+			{
+				for( uint64_t occupied = m_bitmap[word]; occupied != 0; occupied &= occupied - 1 )
+				{
+					m_slots[word * BITS_PER_WORD + SIMD::countTrailingZeros( occupied )].~T();
+				}
+			}
+		}
+
+
+		//	Grows the window to include the index, with headroom in the direction of growth so appending
+		//		a run of consecutive indices does not move the entries every 64 insertions.
+
+		void				grow( IndexType		index )
+		{
+			uint64_t*		oldBitmap = m_bitmap;
+			T*				oldSlots = m_slots;
+			void*			oldStorage = m_storage;
+			size_t			oldWordCount = m_wordCount;
+			IndexType		oldBase = m_base;
+
+			size_t			headroom = oldWordCount / 2 + 1;
+			size_t			newWordCount = wordsFor( index < oldBase ? span() + ( oldBase - index ) : index - oldBase + 1 ) + headroom;
+			IndexType		newBase = oldBase;
+
+			if( index < oldBase )
+			{
+				size_t		wordsBelow = newWordCount - oldWordCount;
+
+				newBase = ( wordsBelow * BITS_PER_WORD ) > (size_t)oldBase ? 0 : oldBase - (IndexType)( wordsBelow * BITS_PER_WORD );
+				newWordCount = wordsFor( oldBase - newBase ) + oldWordCount;
+			}
+
+			SEFUTILITY_TIERING_STAT( tieringCounters().allocated( TIERING_TIER_DENSE, -(int64_t)memoryUsed() ) );
+
+			allocate( newBase, newWordCount );
+
+			for( size_t word = 0; word < oldWordCount; word++ )
+			{
+				for( uint64_t occupied = oldBitmap[word]; occupied != 0; occupied &= occupied - 1 )
+				{
+					size_t		oldOffset = word * BITS_PER_WORD + SIMD::countTrailingZeros( occupied );
+					size_t		newOffset = oldOffset + ( oldBase - newBase );
+
+					m_bitmap[newOffset / BITS_PER_WORD] |= (uint64_t)1 << ( newOffset % BITS_PER_WORD );
+
+					new( m_slots + newOffset ) T( std::move( oldSlots[oldOffset] ) );
+					oldSlots[oldOffset].~T();
+				}
+			}
+
+			boost::alignment::aligned_free( oldStorage );
+		}
+	};
+
+}	//	namespace SEFUtility
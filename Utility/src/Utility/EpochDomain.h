@@ -0,0 +1,175 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+#pragma once
+
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <boost/noncopyable.hpp>
+
+#include "AlignedUniquePtr.h"
+#include "ThreadIndex.h"
+
+
+
+
+//
+//	EpochDomain is the grace period tracking behind epoch based reclamation.  Readers enter the domain before
+//		loading a shared pointer and leave it when done with whatever it pointed at; entering announces the
+//		current epoch in a slot owned by the reader's thread.  A writer that unpublishes an object calls
+//		advance() and keeps the epoch it returns with the object.  Once oldestActiveEpoch() has moved past
+//		that epoch every reader that could have seen the object has left, and it can be freed.
+//
+//	Entering and leaving are a load of the epoch and a store to the reader's own slot.  Each slot and the
+//		epoch itself sit on cache lines of their own, so readers never write to a line another reader
+//		writes, and the writer's advance() only disturbs the line readers load the epoch from.  Nested
+//		entries on one thread only announce once.
+//
+//	There is a single process wide domain with a reader slot for each ThreadIndex.  The epoch and the slots
+//		are allocated with make_aligned(), as new does not honour an alignment beyond that of max_align_t.
+//
+
+namespace SEFUtility
+{
+
+	class EpochDomain : boost::noncopyable
+	{
+	public :
+
+		static const size_t		MAX_THREADS = ThreadIndex::MAX_THREADS;
+
+
+		static EpochDomain&		global()
+		{
+			static EpochDomain		domain;
+
+			return( domain );
+		}
+
+
+
+		void			enter()
+		{
+			if( nestingDepth()++ == 0 )
+			{
+				m_epochs->m_slots[ThreadIndex::current()].m_epoch.store( m_epochs->m_current.load( std::memory_order_seq_cst ), std::memory_order_seq_cst );
+			}
+		}
+
+		void			leave()
+		{
+			assert( nestingDepth() > 0 );
+
+			if( --nestingDepth() == 0 )
+			{
+				m_epochs->m_slots[ThreadIndex::current()].m_epoch.store( IDLE, std::memory_order_release );
+			}
+		}
+
+
+		//	Called after unpublishing an object, returns the epoch to retire it under.
+
+		uint64_t		advance()
+		{
+			return( m_epochs->m_current.fetch_add( 1, std::memory_order_seq_cst ) );
+		}
+
+		//	Objects retired under an epoch older than this can no longer be reached by any reader.
+
+		uint64_t		oldestActiveEpoch() const
+		{
+			uint64_t		oldest = m_epochs->m_current.load( std::memory_order_seq_cst );
+
+			for( size_t i = 0; i < MAX_THREADS; i++ )
+			{
+				uint64_t	announced = m_epochs->m_slots[i].m_epoch.load( std::memory_order_seq_cst );
+
+				if(( announced != IDLE ) && ( announced < oldest ))
+				{
+					oldest = announced;
+				}
+			}
+
+			return( oldest );
+		}
+
+
+	private :
+
+		static const uint64_t		IDLE = 0;
+
+		static const size_t			CACHE_LINE_SIZE = 64;
+
+
+		struct alignas( CACHE_LINE_SIZE ) ReaderSlot
+		{
+			std::atomic<uint64_t>		m_epoch;
+		};
+
+		//	The current epoch has a line to itself, the slots follow it a line each
+
+		struct Epochs
+		{
+			alignas( CACHE_LINE_SIZE ) std::atomic<uint64_t>		m_current;
+
+			ReaderSlot					m_slots[MAX_THREADS];
+		};
+
+		static_assert( sizeof( ReaderSlot ) == CACHE_LINE_SIZE, "A reader slot must fill exactly one cache line" );
+
+
+		aligned_unique_ptr<Epochs>		m_epochs;
+
+
+
+		EpochDomain()
+			: m_epochs( make_aligned<Epochs>() )
+		{
+			m_epochs->m_current.store( 1, std::memory_order_relaxed );
+
+			for( size_t i = 0; i < MAX_THREADS; i++ )
+			{
+				m_epochs->m_slots[i].m_epoch.store( IDLE, std::memory_order_relaxed );
+			}
+		}
+
+
+		static size_t&		nestingDepth()
+		{
+			static thread_local size_t		depth = 0;
+
+			return( depth );
+		}
+	};
+
+}	//	namespace SEFUtility
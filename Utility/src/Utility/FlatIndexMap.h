@@ -0,0 +1,966 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <utility>
+
+#include <boost/align/aligned_alloc.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+
+#include "SIMDIndexSearch.h"
+#include "TieringStats.h"
+
+
+
+
+//
+//	FlatIndexMap is an open addressing hash table for entries that carry their own index, i.e. classes
+//		derived from SparseVectorEntry.  The layout follows the SwissTable scheme: one control byte
+//		per slot followed by the slots themselves, all in a single allocation.  A control byte is
+//		either EMPTY, DELETED or the low 7 bits of the hash of the entry in the slot, so a probe
+//		compares a whole group of 16 control bytes at once and only touches the entries whose
+//		hash fragment matches.
+//
+//	Probing moves group by group, so a group containing an EMPTY byte ends every probe sequence
+//		that reaches it.  That lets erase() drop a slot straight back to EMPTY when its group still
+//		has an EMPTY byte and only leave a DELETED tombstone otherwise.
+//
+//	Entries are moved when the table grows, so pointers and iterators into the table are only stable
+//		until the next insertion.
+//
+
+
+namespace SEFUtility
+{
+	namespace FlatHashing
+	{
+		typedef int8_t		ControlByte;
+
+		const ControlByte		EMPTY = -128;
+		const ControlByte		DELETED = -2;
+		const ControlByte		SENTINEL = -1;
+
+		const size_t			GROUP_WIDTH = 16;
+
+		//	The slots start on a cache line so ranges of whole cache lines can be handed to different threads
+
+		const size_t			CACHE_LINE_SIZE = 64;
+
+
+		inline bool			isFull( ControlByte		control )
+		{
+			return( control >= 0 );
+		}
+
+
+		//	The finalizer from MurmurHash3, it spreads consecutive indices across the whole 64 bits.
+
+		inline uint64_t		hashIndex( uint64_t		index )
+		{
+			index ^= index >> 33;
+			index *= 0xff51afd7ed558ccdULL;
+			index ^= index >> 33;
+			index *= 0xc4ceb9fe1a85ec53ULL;
+			index ^= index >> 33;
+
+			return( index );
+		}
+
+		//	32 bit indices need only one multiply to fill the bits used for the group and the fragment.
+
+		inline uint64_t		hashIndex( uint32_t		index )
+		{
+			uint64_t		hash = (uint64_t)index * 0x9e3779b97f4a7c15ULL;
+
+			return( hash ^ ( hash >> 32 ) );
+		}
+
+		template<class IndexType>
+		inline uint64_t		hashIndexOf( IndexType		index )
+		{
+			return( hashIndex( (typename SIMD::UnsignedOfWidth<sizeof( IndexType )>::type)index ) );
+		}
+
+		//	Pointers always take the full 64 bit finalizer, the low bits are zero from alignment and the high
+		//		bits are mostly shared so every bit of the address has to reach the group and the fragment.
+
+		inline uint64_t		hashPointer( const void*		pointer )
+		{
+			return( hashIndex( (uint64_t)(uintptr_t)pointer ) );
+		}
+
+		inline ControlByte		hashFragment( uint64_t		hash )
+		{
+			return( (ControlByte)( hash & 0x7F ) );
+		}
+
+		inline size_t			firstGroup( uint64_t		hash,
+											size_t			groupMask )
+		{
+			return( (size_t)( hash >> 7 ) & groupMask );
+		}
+
+
+		//	Batched operations hash this many indices and prefetch their first groups before probing any of them.
+
+		const size_t			PREFETCH_BATCH = 16;
+
+		inline void				prefetch( const void*		address )
+		{
+#if defined( __SSE2__ ) || defined( _M_X64 )
+			_mm_prefetch( (const char*)address, _MM_HINT_T0 );
+#elif defined( __GNUC__ )
+			__builtin_prefetch( address );
+#endif
+		}
+
+
+		//	Bitmasks over a group of GROUP_WIDTH control bytes, bit i is set if byte i matches.
+
+		class Group
+		{
+		public :
+
+			explicit Group( const ControlByte*		controls )
+#if defined( __SSE2__ ) || defined( _M_X64 )
+				: m_controls( _mm_loadu_si128( (const __m128i*)controls ) )
+			{}
+
+			uint32_t		match( ControlByte		fragment ) const
+			{
+				return( (uint32_t)_mm_movemask_epi8( _mm_cmpeq_epi8( m_controls, _mm_set1_epi8( fragment ) ) ) );
+			}
+
+			uint32_t		matchEmpty() const
+			{
+				return( match( EMPTY ) );
+			}
+
+			uint32_t		matchFull() const
+			{
+				return( ~(uint32_t)_mm_movemask_epi8( m_controls ) & 0xFFFF );
+			}
+
+			uint32_t		matchEmptyOrDeleted() const
+			{
+				//	EMPTY and DELETED are both below SENTINEL, full slots are above it
+
+				return( (uint32_t)_mm_movemask_epi8( _mm_cmpgt_epi8( _mm_set1_epi8( SENTINEL ), m_controls ) ) );
+			}
+
+		private :
+
+			__m128i				m_controls;
+#else
+				: m_controls( controls )
+			{}
+
+			uint32_t		match( ControlByte		fragment ) const
+			{
+				uint32_t		mask = 0;
+
+				for( size_t i = 0; i < GROUP_WIDTH; i++ )
+				{
+					mask |= (uint32_t)( m_controls[i] == fragment ) << i;
+				}
+
+				return( mask );
+			}
+
+			uint32_t		matchEmpty() const
+			{
+				return( match( EMPTY ) );
+			}
+
+			uint32_t		matchFull() const
+			{
+				uint32_t		mask = 0;
+
+				for( size_t i = 0; i < GROUP_WIDTH; i++ )
+				{
+					mask |= (uint32_t)isFull( m_controls[i] ) << i;
+				}
+
+				return( mask );
+			}
+
+			uint32_t		matchEmptyOrDeleted() const
+			{
+				uint32_t		mask = 0;
+
+				for( size_t i = 0; i < GROUP_WIDTH; i++ )
+				{
+					mask |= (uint32_t)( m_controls[i] < SENTINEL ) << i;
+				}
+
+				return( mask );
+			}
+
+		private :
+
+			const ControlByte*		m_controls;
+#endif
+		};
+
+
+
+		//
+		//	Table is the control byte table behind FlatIndexMap and FlatPointerSet: the single allocation of
+		//		control bytes and slots, probing, claiming free slots, the EMPTY or DELETED choice on erase
+		//		and rehashing.  The container supplies the key comparison to findSlot() and Hasher::hash()
+		//		rehashes the slots when the table grows.  Allocations and probes are counted against the
+		//		tiering statistics of StatsOwner.
+		//
+
+		template<class Slot, class Hasher, class StatsOwner>
+		class Table : boost::noncopyable
+		{
+		public :
+
+			static const size_t		NOT_FOUND = (size_t)-1;
+
+
+			//	Sized to hold initialCapacity entries without a rehash, the smallest table is a single group.
+
+			explicit Table( size_t		initialCapacity )
+				: m_size( 0 ),
+				  m_deleted( 0 )
+			{
+				allocate( capacityFor( initialCapacity ) );
+			}
+
+			~Table()
+			{
+				destroySlots();
+
+				SEFUTILITY_TIERING_STAT( tieringCounters().allocated( TIERING_TIER_MAP, -(int64_t)memoryUsed() ) );
+
+				boost::alignment::aligned_free( m_storage );
+			}
+
+
+
+			size_t				size() const
+			{
+				return( m_size );
+			}
+
+			size_t				capacity() const
+			{
+				return( m_capacity );
+			}
+
+			//	Bytes held by the table, control bytes and slots together.
+
+			size_t				memoryUsed() const
+			{
+				return( bytesFor( m_capacity ) );
+			}
+
+			ControlByte*		controls() const
+			{
+				return( m_controls );
+			}
+
+			Slot*				slots() const
+			{
+				return( m_slots );
+			}
+
+
+			//	Grows the table now, if need be, so the given number of slots fill without a rehash.
+
+			void				reserve( size_t		entries )
+			{
+				if( entries + m_deleted > m_capacity - m_capacity / 8 )
+				{
+					rehash( capacityFor( std::max( entries, m_size ) ) );
+				}
+			}
+
+			//	True if claiming the given number of further slots would rehash the table.
+
+			bool				wouldRehash( size_t		entries ) const
+			{
+				return( m_size + entries + m_deleted > m_capacity - m_capacity / 8 );
+			}
+
+
+			//	Returns the position of the slot with the given hash for which matches( slot ) is true, or NOT_FOUND.
+
+			template<class Matches>
+			size_t				findSlot( uint64_t		hash,
+										  Matches&&		matches ) const
+			{
+				ControlByte		fragment = hashFragment( hash );
+				size_t			groupMask = m_capacity / GROUP_WIDTH - 1;
+				size_t			group = firstGroup( hash, groupMask );
+
+				for( size_t probe = 1; ; probe++ )
+				{
+					size_t		groupStart = group * GROUP_WIDTH;
+					Group		controls( m_controls + groupStart );
+
+					for( uint32_t candidates = controls.match( fragment ); candidates != 0; candidates &= candidates - 1 )
+					{
+						size_t		position = groupStart + SIMD::countTrailingZeros( candidates );
+
+						if( matches( m_slots[position] ) )
+						{
+							SEFUTILITY_TIERING_STAT( tieringCounters().probed( probe ) );
+
+							return( position );
+						}
+					}
+
+					if( controls.matchEmpty() != 0 || probe > groupMask )
+					{
+						SEFUTILITY_TIERING_STAT( tieringCounters().probed( probe ) );
+
+						return( NOT_FOUND );
+					}
+
+					//	Triangular probing visits every group when the group count is a power of two
+
+					group = ( group + probe ) & groupMask;
+				}
+			}
+
+
+			//	Marks a free slot for an entry with the given hash and returns its uninitialized storage.
+
+			void*				claimSlot( uint64_t		hash )
+			{
+				//	Tombstones making up much of the load are cleared at the same capacity, otherwise the table
+				//		grows to the next size holding one more entry, which is double the current one.
+
+				if( wouldRehash( 1 ) )
+				{
+					rehash( m_deleted > m_size / 2 ? m_capacity : capacityFor( m_size + 1 ) );
+				}
+
+				size_t		position = findFreeSlot( hash );
+
+				if( m_controls[position] == DELETED )
+				{
+					m_deleted--;
+				}
+
+				m_controls[position] = hashFragment( hash );
+				m_size++;
+
+				return( m_slots + position );
+			}
+
+
+			void				eraseAt( size_t		position )
+			{
+				m_slots[position].~Slot();
+
+				//	If the group still has an EMPTY byte no probe ever passed through it, so the slot can go straight back to EMPTY.
+
+				size_t		groupStart = position & ~( GROUP_WIDTH - 1 );
+
+				if( Group( m_controls + groupStart ).matchEmpty() != 0 )
+				{
+					m_controls[position] = EMPTY;
+				}
+				else
+				{
+					m_controls[position] = DELETED;
+					m_deleted++;
+				}
+
+				m_size--;
+			}
+
+
+			void				clear()
+			{
+				destroySlots();
+
+				memset( m_controls, EMPTY, m_capacity );
+
+				m_size = 0;
+				m_deleted = 0;
+			}
+
+
+			void				prefetchFirstGroup( uint64_t		hash ) const
+			{
+				size_t		groupStart = firstGroup( hash, m_capacity / GROUP_WIDTH - 1 ) * GROUP_WIDTH;
+
+				prefetch( m_controls + groupStart );
+				prefetch( m_slots + groupStart );
+			}
+
+
+		private :
+
+			ControlByte*		m_controls;
+			Slot*				m_slots;
+			void*				m_storage;
+
+			size_t				m_capacity;
+			size_t				m_size;
+			size_t				m_deleted;
+
+
+			static_assert( __alignof( Slot ) <= CACHE_LINE_SIZE, "Table slots are aligned to a cache line" );
+
+
+			//	Tables hold a power of two number of groups and are never more than 7/8 full.
+
+			static size_t		capacityFor( size_t		entries )
+			{
+				size_t		capacity = GROUP_WIDTH;
+
+				while( capacity - capacity / 8 < entries )
+				{
+					capacity *= 2;
+				}
+
+				return( capacity );
+			}
+
+			//	Control bytes, the trailing SENTINEL padded out to a full group and then, from the next cache line, the slots
+
+			static size_t		slotsOffsetFor( size_t	capacity )
+			{
+				return(( capacity + GROUP_WIDTH + CACHE_LINE_SIZE - 1 ) & ~( CACHE_LINE_SIZE - 1 ));
+			}
+
+			static size_t		bytesFor( size_t	capacity )
+			{
+				return( slotsOffsetFor( capacity ) + capacity * sizeof( Slot ) );
+			}
+
+
+			void				allocate( size_t		capacity )
+			{
+				m_storage = boost::alignment::aligned_alloc( CACHE_LINE_SIZE, bytesFor( capacity ) );
+
+				if( m_storage == NULL )
+				{
+					throw std::bad_alloc();
+				}
+
+				m_controls = (ControlByte*)m_storage;
+				m_slots = (Slot*)( (char*)m_storage + slotsOffsetFor( capacity ) );
+				m_capacity = capacity;
+
+				memset( m_controls, EMPTY, capacity );
+				memset( m_controls + capacity, SENTINEL, GROUP_WIDTH );
+
+				SEFUTILITY_TIERING_STAT( tieringCounters().allocated( TIERING_TIER_MAP, (int64_t)memoryUsed() ) );
+			}
+
+#if defined( SEFUTILITY_TIERING_STATS )
+			static TieringCounters&		tieringCounters()
+			{
+				return( TieringStats::countersFor<StatsOwner>() );
+			}
+#endif
+
+			void				destroySlots()
+			{
+				for( size_t i = 0; i < m_capacity; i++ )
+				{
+					if( isFull( m_controls[i] ) )
+					{
+						m_slots[i].~Slot();
+					}
+				}
+			}
+
+
+			size_t				findFreeSlot( uint64_t		hash ) const
+			{
+				size_t		groupMask = m_capacity / GROUP_WIDTH - 1;
+				size_t		group = firstGroup( hash, groupMask );
+
+				for( size_t probe = 1; ; probe++ )
+				{
+					size_t		groupStart = group * GROUP_WIDTH;
+					uint32_t	free = Group( m_controls + groupStart ).matchEmptyOrDeleted();
+
+					if( free != 0 )
+					{
+						return( groupStart + SIMD::countTrailingZeros( free ) );
+					}
+
+					group = ( group + probe ) & groupMask;
+				}
+			}
+
+
+			void				rehash( size_t		newCapacity )
+			{
+				ControlByte*	oldControls = m_controls;
+				Slot*			oldSlots = m_slots;
+				void*			oldStorage = m_storage;
+				size_t			oldCapacity = m_capacity;
+
+				SEFUTILITY_TIERING_STAT( tieringCounters().allocated( TIERING_TIER_MAP, -(int64_t)memoryUsed() ) );
+
+				allocate( newCapacity );
+
+				m_deleted = 0;
+
+				for( size_t i = 0; i < oldCapacity; i++ )
+				{
+					if( isFull( oldControls[i] ) )
+					{
+						uint64_t	hash = Hasher::hash( oldSlots[i] );
+						size_t		position = findFreeSlot( hash );
+
+						m_controls[position] = hashFragment( hash );
+						new( m_slots + position ) Slot( std::move( oldSlots[i] ) );
+
+						oldSlots[i].~Slot();
+					}
+				}
+
+				boost::alignment::aligned_free( oldStorage );
+			}
+		};
+
+	}	//	namespace FlatHashing
+
+
+
+
+	template<class T, class IndexType = size_t, class StatsOwner = void>
+	class FlatIndexMap : boost::noncopyable
+	{
+	public :
+
+		typedef FlatHashing::ControlByte		ControlByte;
+
+
+		template<class Value>
+		class basic_iterator : public boost::iterator_facade<basic_iterator<Value>, Value, boost::forward_traversal_tag>
+		{
+		public :
+
+			basic_iterator()
+				: m_control( NULL ),
+				  m_slot( NULL )
+			{}
+
+			//	Allows conversion from iterator to const_iterator
+
+			template<class OtherValue>
+			basic_iterator( const basic_iterator<OtherValue>&		other )
+				: m_control( other.m_control ),
+				  m_slot( other.m_slot )
+			{}
+
+		private :
+
+			friend class FlatIndexMap;
+			friend class boost::iterator_core_access;
+			template<class> friend class basic_iterator;
+
+
+			basic_iterator( const ControlByte*		control,
+							Value*					slot )
+				: m_control( control ),
+				  m_slot( slot )
+			{
+				skipEmpty();
+			}
+
+
+			//	The control array ends with SENTINEL bytes, which stop the skip, so it needs no bounds check.
+
+			void		skipEmpty()
+			{
+				while( *m_control < FlatHashing::SENTINEL )
+				{
+					m_control++;
+					m_slot++;
+				}
+			}
+
+			void		increment()
+			{
+				m_control++;
+				m_slot++;
+
+				skipEmpty();
+			}
+
+			template<class OtherValue>
+			bool		equal( const basic_iterator<OtherValue>&		other ) const
+			{
+				return( m_control == other.m_control );
+			}
+
+			Value&		dereference() const
+			{
+				return( *m_slot );
+			}
+
+
+			const ControlByte*		m_control;
+			Value*					m_slot;
+		};
+
+		typedef basic_iterator<T>				iterator;
+		typedef basic_iterator<const T>			const_iterator;
+
+
+
+		explicit FlatIndexMap( size_t		initialCapacity = 0 )
+			: m_table( initialCapacity )
+		{}
+
+
+
+		size_t				size() const
+		{
+			return( m_table.size() );
+		}
+
+		bool				empty() const
+		{
+			return( m_table.size() == 0 );
+		}
+
+		size_t				capacity() const
+		{
+			return( m_table.capacity() );
+		}
+
+		//	Bytes held by the table, control bytes and slots together.
+
+		size_t				memoryUsed() const
+		{
+			return( m_table.memoryUsed() );
+		}
+
+
+		//	Grows the table now, if need be, so the given number of entries fit without a rehash.
+
+		void				reserve( size_t		entries )
+		{
+			m_table.reserve( entries );
+		}
+
+
+
+		iterator			begin()
+		{
+			return( iterator( m_table.controls(), m_table.slots() ) );
+		}
+
+		const_iterator		begin() const
+		{
+			return( const_iterator( m_table.controls(), m_table.slots() ) );
+		}
+
+		iterator			end()
+		{
+			return( iterator( m_table.controls() + m_table.capacity(), m_table.slots() + m_table.capacity() ) );
+		}
+
+		const_iterator		end() const
+		{
+			return( const_iterator( m_table.controls() + m_table.capacity(), m_table.slots() + m_table.capacity() ) );
+		}
+
+
+
+		T*					find( IndexType		index )
+		{
+			return( findWithHash( index, FlatHashing::hashIndexOf( index ) ) );
+		}
+
+		const T*			find( IndexType		index ) const
+		{
+			return( findWithHash( index, FlatHashing::hashIndexOf( index ) ) );
+		}
+
+
+		T&					find_or_add( IndexType		index )
+		{
+			uint64_t		hash = FlatHashing::hashIndexOf( index );
+
+			T*				existing = findWithHash( index, hash );
+
+			if( existing != NULL )
+			{
+				return( *existing );
+			}
+
+			return( *new( m_table.claimSlot( hash ) ) T( index ) );
+		}
+
+
+		//	The two methods below add entries known not to be in the table already, so they skip the lookup.
+
+		T&					emplace_unique( IndexType		index )
+		{
+			return( *new( m_table.claimSlot( FlatHashing::hashIndexOf( index ) ) ) T( index ) );
+		}
+
+		T&					insert_unique( T&&		entry )
+		{
+			uint64_t		hash = FlatHashing::hashIndexOf( entry.index() );
+
+			return( *new( m_table.claimSlot( hash ) ) T( std::move( entry ) ) );
+		}
+
+
+		bool				erase( IndexType		index )
+		{
+			T*		entry = find( index );
+
+			if( entry == NULL )
+			{
+				return( false );
+			}
+
+			m_table.eraseAt( entry - m_table.slots() );
+
+			return( true );
+		}
+
+
+
+		//	The batched methods below take an array of indices and, for each batch of PREFETCH_BATCH, hash all
+		//		the indices and prefetch their first groups before probing, so the cache misses overlap rather
+		//		than being taken one after another.  find_many() returns the number of indices found and leaves
+		//		NULL in results for the others.
+
+		size_t				find_many( const IndexType*		indices,
+									   size_t				count,
+									   T**					results )
+		{
+			uint64_t		hashes[FlatHashing::PREFETCH_BATCH];
+			size_t			found = 0;
+
+			for( size_t batchStart = 0; batchStart < count; batchStart += FlatHashing::PREFETCH_BATCH )
+			{
+				size_t		batchSize = std::min( count - batchStart, FlatHashing::PREFETCH_BATCH );
+
+				prefetchBatch( indices + batchStart, batchSize, hashes );
+
+				for( size_t i = 0; i < batchSize; i++ )
+				{
+					results[batchStart + i] = findWithHash( indices[batchStart + i], hashes[i] );
+					found += ( results[batchStart + i] != NULL );
+				}
+			}
+
+			return( found );
+		}
+
+
+		//	Room for the missing entries is reserved before any are added, so the pointers in results all
+		//		remain valid once the call returns.
+
+		void				find_or_add_many( const IndexType*		indices,
+											  size_t				count,
+											  T**					results )
+		{
+			size_t		missing = count - find_many( indices, count, results );
+
+			if( missing == 0 )
+			{
+				return;
+			}
+
+			if( m_table.wouldRehash( missing ) )
+			{
+				//	The rehash moves the entries already found, so look them up again
+
+				reserve( m_table.size() + missing );
+
+				find_many( indices, count, results );
+			}
+
+			for( size_t i = 0; i < count; i++ )
+			{
+				if( results[i] == NULL )
+				{
+					//	find_or_add() rather than emplace_unique() as the batch may hold the index more than once
+
+					results[i] = &find_or_add( indices[i] );
+				}
+			}
+		}
+
+
+		size_t				erase_many( const IndexType*		indices,
+										size_t				count )
+		{
+			uint64_t		hashes[FlatHashing::PREFETCH_BATCH];
+			size_t			erased = 0;
+
+			for( size_t batchStart = 0; batchStart < count; batchStart += FlatHashing::PREFETCH_BATCH )
+			{
+				size_t		batchSize = std::min( count - batchStart, FlatHashing::PREFETCH_BATCH );
+
+				prefetchBatch( indices + batchStart, batchSize, hashes );
+
+				for( size_t i = 0; i < batchSize; i++ )
+				{
+					erased += erase( indices[batchStart + i] );
+				}
+			}
+
+			return( erased );
+		}
+
+
+		void				clear()
+		{
+			m_table.clear();
+		}
+
+
+		template<class Action>
+		inline void			for_each( Action&&		action )
+		{
+			for_each_in_slots( 0, m_table.capacity(), std::forward<Action>( action ) );
+		}
+
+
+		//	Hands runs of adjacent full slots to the visitor as ( const IndexType* indices, T* entries, size_t count ).
+		//		The indices are gathered into a buffer as the run is built and a run is cut at MAX_CHUNK_SIZE.
+
+		template<class Visitor>
+		void				for_each_chunk( Visitor&&		visitor )
+		{
+			ControlByte*	controls = m_table.controls();
+			T*				slots = m_table.slots();
+			IndexType		indices[MAX_CHUNK_SIZE];
+			size_t			runStart = 0;
+			size_t			runLength = 0;
+
+			for( size_t groupStart = 0; groupStart < m_table.capacity(); groupStart += FlatHashing::GROUP_WIDTH )
+			{
+				for( uint32_t full = FlatHashing::Group( controls + groupStart ).matchFull(); full != 0; full &= full - 1 )
+				{
+					size_t		position = groupStart + SIMD::countTrailingZeros( full );
+
+					if(( runLength == MAX_CHUNK_SIZE ) || (( runLength > 0 ) && ( runStart + runLength != position )))
+					{
+						visitor( (const IndexType*)indices, slots + runStart, runLength );
+						runLength = 0;
+					}
+
+					if( runLength == 0 )
+					{
+						runStart = position;
+					}
+
+					indices[runLength++] = slots[position].index();
+				}
+			}
+
+			if( runLength > 0 )
+			{
+				visitor( (const IndexType*)indices, slots + runStart, runLength );
+			}
+		}
+
+
+		//	Applies the action to the entries in slot positions [first, last), which must be multiples of
+		//		GROUP_WIDTH.  Used to split the table into independent ranges for parallel iteration.
+
+		template<class Action>
+		void				for_each_in_slots( size_t		first,
+											   size_t		last,
+											   Action&&		action )
+		{
+			ControlByte*	controls = m_table.controls();
+			T*				slots = m_table.slots();
+
+			for( size_t groupStart = first; groupStart < last; groupStart += FlatHashing::GROUP_WIDTH )
+			{
+				for( uint32_t full = FlatHashing::Group( controls + groupStart ).matchFull(); full != 0; full &= full - 1 )
+				{
+					action( slots[groupStart + SIMD::countTrailingZeros( full )] );
+				}
+			}
+		}
+
+
+	private :
+
+		static const size_t		MAX_CHUNK_SIZE = 64;
+
+
+		struct EntryHash
+		{
+			static uint64_t		hash( const T&		entry )
+			{
+				return( FlatHashing::hashIndexOf( (IndexType)entry.index() ) );
+			}
+		};
+
+
+		FlatHashing::Table<T, EntryHash, typename TieringOwner<StatsOwner, FlatIndexMap>::type>		m_table;
+
+
+
+		void				prefetchBatch( const IndexType*		indices,
+										   size_t				count,
+										   uint64_t*			hashes ) const
+		{
+			for( size_t i = 0; i < count; i++ )
+			{
+				hashes[i] = FlatHashing::hashIndexOf( indices[i] );
+
+				m_table.prefetchFirstGroup( hashes[i] );
+			}
+		}
+
+
+		T*					findWithHash( IndexType		index,
+										  uint64_t		hash ) const
+		{
+			size_t		position = m_table.findSlot( hash, [index]( const T&	entry ) { return( entry.index() == index ); } );
+
+			return( position == m_table.NOT_FOUND ? NULL : m_table.slots() + position );
+		}
+	};
+
+}	//	namespace SEFUtility
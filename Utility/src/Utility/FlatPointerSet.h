@@ -0,0 +1,261 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <new>
+
+#include <boost/noncopyable.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+
+#include "FlatIndexMap.h"
+
+
+
+
+//
+//	FlatPointerSet is a set of pointers on the same FlatHashing::Table as FlatIndexMap: a control byte per
+//		slot, probed a group of 16 at a time, followed by the pointers themselves in the same allocation.
+//		A membership test hashes the address, compares one group of control bytes and then at most a
+//		handful of pointers, so it costs a cache miss or two where a std::set walks a chain of tree nodes.
+//
+//	Iteration is in hash order, not address order.  The set never dereferences the pointers it holds.
+//
+
+
+namespace SEFUtility
+{
+
+	template<class T, class StatsOwner = void>
+	class FlatPointerSet : boost::noncopyable
+	{
+	public :
+
+		typedef FlatHashing::ControlByte		ControlByte;
+
+
+		//	The pointers are the keys, so like std::set only const iteration is offered.
+
+		class const_iterator : public boost::iterator_facade<const_iterator, T* const, boost::forward_traversal_tag>
+		{
+		public :
+
+			const_iterator()
+				: m_control( NULL ),
+				  m_slot( NULL )
+			{}
+
+		private :
+
+			friend class FlatPointerSet;
+			friend class boost::iterator_core_access;
+
+
+			const_iterator( const ControlByte*		control,
+							T* const*				slot )
+				: m_control( control ),
+				  m_slot( slot )
+			{
+				skipEmpty();
+			}
+
+
+			//	The control array ends with SENTINEL bytes, which stop the skip, so it needs no bounds check.
+
+			void		skipEmpty()
+			{
+				while( *m_control < FlatHashing::SENTINEL )
+				{
+					m_control++;
+					m_slot++;
+				}
+			}
+
+			void		increment()
+			{
+				m_control++;
+				m_slot++;
+
+				skipEmpty();
+			}
+
+			bool		equal( const const_iterator&		other ) const
+			{
+				return( m_control == other.m_control );
+			}
+
+			T* const&	dereference() const
+			{
+				return( *m_slot );
+			}
+
+
+			const ControlByte*		m_control;
+			T* const*				m_slot;
+		};
+
+		typedef const_iterator		iterator;
+
+
+
+		explicit FlatPointerSet( size_t		initialCapacity = 0 )
+			: m_table( initialCapacity )
+		{}
+
+		template<class Iterator>
+		FlatPointerSet( Iterator		first,
+						Iterator		last )
+			: m_table( (size_t)std::distance( first, last ) )
+		{
+			for( ; first != last; ++first )
+			{
+				insert( *first );
+			}
+		}
+
+
+
+		size_t				size() const
+		{
+			return( m_table.size() );
+		}
+
+		bool				empty() const
+		{
+			return( m_table.size() == 0 );
+		}
+
+		size_t				capacity() const
+		{
+			return( m_table.capacity() );
+		}
+
+		size_t				memoryUsed() const
+		{
+			return( m_table.memoryUsed() );
+		}
+
+
+		//	Grows the table now, if need be, so the given number of pointers fit without a rehash.
+
+		void				reserve( size_t		entries )
+		{
+			m_table.reserve( entries );
+		}
+
+
+
+		const_iterator		begin() const
+		{
+			return( const_iterator( m_table.controls(), m_table.slots() ) );
+		}
+
+		const_iterator		end() const
+		{
+			return( const_iterator( m_table.controls() + m_table.capacity(), m_table.slots() + m_table.capacity() ) );
+		}
+
+
+
+		bool				contains( const T*		pointer ) const
+		{
+			return( findSlot( pointer, FlatHashing::hashPointer( pointer ) ) != m_table.NOT_FOUND );
+		}
+
+		size_t				count( const T*		pointer ) const
+		{
+			return( contains( pointer ) ? 1 : 0 );
+		}
+
+
+		//	Returns true if the pointer was added, false if it was already in the set.
+
+		bool				insert( T*		pointer )
+		{
+			uint64_t		hash = FlatHashing::hashPointer( pointer );
+
+			if( findSlot( pointer, hash ) != m_table.NOT_FOUND )
+			{
+				return( false );
+			}
+
+			new( m_table.claimSlot( hash ) ) T*( pointer );
+
+			return( true );
+		}
+
+
+		size_t				erase( const T*		pointer )
+		{
+			size_t		position = findSlot( pointer, FlatHashing::hashPointer( pointer ) );
+
+			if( position == m_table.NOT_FOUND )
+			{
+				return( 0 );
+			}
+
+			m_table.eraseAt( position );
+
+			return( 1 );
+		}
+
+
+		void				clear()
+		{
+			m_table.clear();
+		}
+
+
+	private :
+
+		struct PointerHash
+		{
+			static uint64_t		hash( T* const&		pointer )
+			{
+				return( FlatHashing::hashPointer( pointer ) );
+			}
+		};
+
+
+		FlatHashing::Table<T*, PointerHash, typename TieringOwner<StatsOwner, FlatPointerSet>::type>		m_table;
+
+
+
+		size_t				findSlot( const T*		pointer,
+									  uint64_t		hash ) const
+		{
+			return( m_table.findSlot( hash, [pointer]( T* const&	slot ) { return( slot == pointer ); } ));
+		}
+	};
+
+}	//	namespace SEFUtility
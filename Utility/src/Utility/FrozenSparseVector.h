@@ -0,0 +1,567 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+
+#include "SparseVector.h"
+
+
+
+
+//
+//	FrozenSparseVector is the read-only form of a SparseVector, built by freeze() once the vector will
+//		not change again.  Each entry is split into its index and its payload, the rest of the entry's
+//		bytes, and the two are stored apart so the index is held once, in encoded form, rather than in
+//		every entry.
+//
+//	The payloads sit in index order in one contiguous block.  The indices are split into blocks of
+//		BLOCK_SIZE; each block stores its first index in full and the rest as offsets from it, all at
+//		the narrowest width - 1, 2, 4 or 8 bytes - that holds the largest offset in the block.  The
+//		offsets within a block are fixed width and sorted, so a block decodes with a single widening
+//		add per index and is searched with a binary search without decoding at all.  Clustered indices
+//		typically need one byte each, so an entry of a size_t index and a double takes about 9 bytes
+//		against 16 in a sorted array and over 30 in the live vector's hash table.
+//
+//	As no whole entries are stored, they are rebuilt on the way out: an iterator holds a copy of the
+//		entry it is on, and the pointer it hands out is valid until the iterator moves.  for_each() and
+//		for_each_chunk() rebuild into a buffer of their own, and find() copies the entry out.  The entry
+//		class must therefore be trivially copyable and take its index from BasicSparseVectorEntry.
+//
+
+
+namespace SEFUtility
+{
+
+	template<class T, class IndexType = typename SparseVectorIndexType<T>::type>
+	class FrozenSparseVector : boost::noncopyable
+	{
+		static_assert( std::is_trivially_copyable<T>::value, "FrozenSparseVector stores entries as raw bytes" );
+		static_assert( std::is_base_of<BasicSparseVectorEntry<IndexType>, T>::value, "FrozenSparseVector entries take their index from BasicSparseVectorEntry" );
+
+	public :
+
+		typedef IndexType		index_type;
+
+		static const size_t		BLOCK_SIZE = 128;
+		static const size_t		PAYLOAD_SIZE = sizeof( T ) - sizeof( IndexType );
+
+
+		class const_iterator : public boost::iterator_facade<const_iterator, const T*, boost::forward_traversal_tag, const T*>
+		{
+		protected :
+
+			friend class FrozenSparseVector;
+			friend class boost::iterator_core_access;
+
+
+			const_iterator( const FrozenSparseVector*		owner,
+							size_t							position )
+				: m_owner( owner ),
+				  m_position( position ),
+				  m_entry( IndexType() )
+			{
+				if( m_position < m_owner->m_size )
+				{
+					m_owner->rebuild( m_position, m_owner->indexAt( m_position ), m_entry );
+				}
+			}
+
+
+			void		increment()
+			{
+				if( ++m_position < m_owner->m_size )
+				{
+					m_owner->rebuild( m_position, m_owner->indexAt( m_position ), m_entry );
+				}
+			}
+
+			bool		equal( const_iterator const&		other ) const
+			{
+				return( m_position == other.m_position );
+			}
+
+			const T*	dereference() const
+			{
+				return( &m_entry );
+			}
+
+
+			const FrozenSparseVector*		m_owner;
+			size_t							m_position;
+
+			T								m_entry;
+		};
+
+		//	Only const access is offered, the frozen form is not to be modified
+
+		typedef const_iterator		iterator;
+
+
+
+		FrozenSparseVector()
+			: m_size( 0 ),
+			  m_indexOffset( indexOffset() )
+		{}
+
+		FrozenSparseVector( FrozenSparseVector&&		vectorToMove )
+			: m_size( vectorToMove.m_size ),
+			  m_indexOffset( vectorToMove.m_indexOffset ),
+			  m_payloads( std::move( vectorToMove.m_payloads ) ),
+			  m_blockFirst( std::move( vectorToMove.m_blockFirst ) ),
+			  m_blockOffset( std::move( vectorToMove.m_blockOffset ) ),
+			  m_blockWidth( std::move( vectorToMove.m_blockWidth ) ),
+			  m_offsets( std::move( vectorToMove.m_offsets ) )
+		{
+			vectorToMove.m_size = 0;
+		}
+
+		//	The entries are copied in, and must be in index order.
+
+		explicit FrozenSparseVector( const std::vector<T*>&		sortedEntries )
+			: m_size( sortedEntries.size() ),
+			  m_indexOffset( indexOffset() ),
+			  m_payloads( sortedEntries.size() * PAYLOAD_SIZE )
+		{
+			for( size_t i = 0; i < m_size; i++ )
+			{
+				assert(( i == 0 ) || ( sortedEntries[i - 1]->index() < sortedEntries[i]->index() ));
+
+				const unsigned char*	entry = (const unsigned char*)sortedEntries[i];
+				unsigned char*			payload = m_payloads.data() + i * PAYLOAD_SIZE;
+
+				memcpy( payload, entry, m_indexOffset );
+				memcpy( payload + m_indexOffset, entry + m_indexOffset + sizeof( IndexType ), PAYLOAD_SIZE - m_indexOffset );
+			}
+
+			encodeIndices( sortedEntries );
+		}
+
+
+		FrozenSparseVector&		operator=( FrozenSparseVector&&		vectorToMove )
+		{
+			if( this != &vectorToMove )
+			{
+				m_size = vectorToMove.m_size;
+				m_indexOffset = vectorToMove.m_indexOffset;
+				m_payloads = std::move( vectorToMove.m_payloads );
+				m_blockFirst = std::move( vectorToMove.m_blockFirst );
+				m_blockOffset = std::move( vectorToMove.m_blockOffset );
+				m_blockWidth = std::move( vectorToMove.m_blockWidth );
+				m_offsets = std::move( vectorToMove.m_offsets );
+
+				vectorToMove.m_size = 0;
+			}
+
+			return( *this );
+		}
+
+
+
+		size_t				size() const
+		{
+			return( m_size );
+		}
+
+		bool				empty() const
+		{
+			return( m_size == 0 );
+		}
+
+		//	Bytes held for the payloads and the encoded indices
+
+		size_t				memoryUsed() const
+		{
+			return( m_payloads.size() +
+					m_blockFirst.size() * ( sizeof( IndexType ) + sizeof( uint32_t ) + sizeof( uint8_t ) ) +
+					m_offsets.size() * sizeof( uint64_t ) );
+		}
+
+
+		const_iterator		begin() const
+		{
+			return( const_iterator( this, 0 ) );
+		}
+
+		const_iterator		end() const
+		{
+			return( const_iterator( this, m_size ) );
+		}
+
+
+
+		bool				contains( IndexType		index ) const
+		{
+			return( positionOf( index ) >= 0 );
+		}
+
+		//	Copies the entry out, returns false and leaves the argument alone if the index is not present.
+
+		bool				find( IndexType		index,
+								  T&			entry ) const
+		{
+			long		position = positionOf( index );
+
+			if( position < 0 )
+			{
+				return( false );
+			}
+
+			rebuild( position, index, entry );
+
+			return( true );
+		}
+
+
+		T					operator[]( IndexType		index ) const
+		{
+			T			entry( index );
+			bool		found = find( index, entry );
+
+			//	If we did not find the entry there is no choice but assert
+
+			assert( found );
+
+			return( entry );
+		}
+
+
+
+		inline void			for_each( std::function<void( const T &entry )> action ) const
+		{
+			for_each_chunk( [&action]( const IndexType*, const T* entries, size_t count )
+			{
+				for( size_t i = 0; i < count; i++ )
+				{
+					action( entries[i] );
+				}
+			});
+		}
+
+		template<class Action>
+		inline void			for_each( Action&&		action ) const
+		{
+			for_each_chunk( [&action]( const IndexType*, const T* entries, size_t count )
+			{
+				for( size_t i = 0; i < count; i++ )
+				{
+					action( entries[i] );
+				}
+			});
+		}
+
+
+		//	Decodes one block of indices at a time, rebuilds its entries into a buffer and hands both over as
+		//		visitor( const IndexType* indices, const T* entries, size_t count ).
+
+		template<class Visitor>
+		void				for_each_chunk( Visitor&&		visitor ) const
+		{
+			IndexType		indices[BLOCK_SIZE];
+			std::vector<T>	entries( std::min( m_size, (size_t)BLOCK_SIZE ), T( IndexType() ));
+
+			for( size_t block = 0; block < m_blockFirst.size(); block++ )
+			{
+				size_t		count = std::min( (size_t)BLOCK_SIZE, m_size - block * BLOCK_SIZE );
+
+				decodeBlock( block, count, indices );
+
+				for( size_t i = 0; i < count; i++ )
+				{
+					rebuild( block * BLOCK_SIZE + i, indices[i], entries[i] );
+				}
+
+				visitor( (const IndexType*)indices, (const T*)entries.data(), count );
+			}
+		}
+
+
+	private :
+
+		size_t							m_size;
+
+		//	Where the index sits within an entry, the payload is every byte before and after it
+
+		size_t							m_indexOffset;
+
+		std::vector<unsigned char>		m_payloads;
+
+		//	Per block: the first index, the byte offset of its offsets in m_offsets and their width in bytes
+
+		std::vector<IndexType>			m_blockFirst;
+		std::vector<uint32_t>			m_blockOffset;
+		std::vector<uint8_t>			m_blockWidth;
+
+		//	Each block's offsets start on an 8 byte boundary so they can be read at any width
+
+		std::vector<uint64_t>			m_offsets;
+
+
+		static size_t		indexOffset()
+		{
+			static_assert( sizeof( BasicSparseVectorEntry<IndexType> ) == sizeof( IndexType ), "The index is all there is to the entry base class" );
+
+			T			probe(( IndexType() ));
+
+			return( (const char*)static_cast<const BasicSparseVectorEntry<IndexType>*>( &probe ) - (const char*)&probe );
+		}
+
+
+		//	Writes the entry at the position, whose index the caller has decoded, over an existing entry
+
+		void				rebuild( size_t			position,
+									 IndexType		index,
+									 T&				entry ) const
+		{
+			unsigned char*			bytes = (unsigned char*)&entry;
+			const unsigned char*	payload = m_payloads.data() + position * PAYLOAD_SIZE;
+
+			//	The index usually leads the entry, the copies are then of fixed size and compile to plain moves
+
+			if( m_indexOffset == 0 )
+			{
+				memcpy( bytes, &index, sizeof( IndexType ) );
+				memcpy( bytes + sizeof( IndexType ), payload, PAYLOAD_SIZE );
+				return;
+			}
+
+			memcpy( bytes, payload, m_indexOffset );
+			memcpy( bytes + m_indexOffset, &index, sizeof( IndexType ) );
+			memcpy( bytes + m_indexOffset + sizeof( IndexType ), payload + m_indexOffset, PAYLOAD_SIZE - m_indexOffset );
+		}
+
+
+		void				encodeIndices( const std::vector<T*>&		sortedEntries )
+		{
+			size_t		blockCount = ( m_size + BLOCK_SIZE - 1 ) / BLOCK_SIZE;
+
+			m_blockFirst.reserve( blockCount );
+			m_blockOffset.reserve( blockCount );
+			m_blockWidth.reserve( blockCount );
+
+			for( size_t start = 0; start < m_size; start += BLOCK_SIZE )
+			{
+				size_t		count = std::min( (size_t)BLOCK_SIZE, m_size - start );
+				IndexType	first = sortedEntries[start]->index();
+				uint64_t	largest = (uint64_t)( sortedEntries[start + count - 1]->index() - first );
+				uint8_t		width = largest <= std::numeric_limits<uint8_t>::max() ? 1 :
+									largest <= std::numeric_limits<uint16_t>::max() ? 2 :
+									largest <= std::numeric_limits<uint32_t>::max() ? 4 : 8;
+
+				m_blockFirst.push_back( first );
+				m_blockOffset.push_back( (uint32_t)( m_offsets.size() * sizeof( uint64_t ) ));
+				m_blockWidth.push_back( width );
+
+				size_t		wordStart = m_offsets.size();
+
+				m_offsets.resize( wordStart + ( count * width + sizeof( uint64_t ) - 1 ) / sizeof( uint64_t ), 0 );
+
+				void*		offsets = m_offsets.data() + wordStart;
+
+				for( size_t i = 0; i < count; i++ )
+				{
+					uint64_t	offset = (uint64_t)( sortedEntries[start + i]->index() - first );
+
+					switch( width )
+					{
+						case 1 :
+							((uint8_t*)offsets)[i] = (uint8_t)offset;
+							break;
+
+						case 2 :
+							((uint16_t*)offsets)[i] = (uint16_t)offset;
+							break;
+
+						case 4 :
+							((uint32_t*)offsets)[i] = (uint32_t)offset;
+							break;
+
+						default :
+							((uint64_t*)offsets)[i] = offset;
+							break;
+					}
+				}
+			}
+		}
+
+
+		IndexType			indexAt( size_t		position ) const
+		{
+			size_t			block = position / BLOCK_SIZE;
+			size_t			i = position % BLOCK_SIZE;
+			const void*		offsets = (const char*)m_offsets.data() + m_blockOffset[block];
+
+			switch( m_blockWidth[block] )
+			{
+				case 1 :
+					return( m_blockFirst[block] + (IndexType)((const uint8_t*)offsets)[i] );
+
+				case 2 :
+					return( m_blockFirst[block] + (IndexType)((const uint16_t*)offsets)[i] );
+
+				case 4 :
+					return( m_blockFirst[block] + (IndexType)((const uint32_t*)offsets)[i] );
+
+				default :
+					return( m_blockFirst[block] + (IndexType)((const uint64_t*)offsets)[i] );
+			}
+		}
+
+		//	Position of the index among the entries, or -1 if it is not present
+
+		long				positionOf( IndexType		index ) const
+		{
+			size_t		block = std::upper_bound( m_blockFirst.begin(), m_blockFirst.end(), index ) - m_blockFirst.begin();
+
+			if( block == 0 )
+			{
+				return( -1 );
+			}
+
+			block--;
+
+			uint64_t		offset = (uint64_t)( index - m_blockFirst[block] );
+			size_t			count = std::min( (size_t)BLOCK_SIZE, m_size - block * BLOCK_SIZE );
+			const void*		offsets = (const char*)m_offsets.data() + m_blockOffset[block];
+			long			position;
+
+			switch( m_blockWidth[block] )
+			{
+				case 1 :
+					position = findOffset( (const uint8_t*)offsets, count, offset );
+					break;
+
+				case 2 :
+					position = findOffset( (const uint16_t*)offsets, count, offset );
+					break;
+
+				case 4 :
+					position = findOffset( (const uint32_t*)offsets, count, offset );
+					break;
+
+				default :
+					position = findOffset( (const uint64_t*)offsets, count, offset );
+					break;
+			}
+
+			return( position >= 0 ? (long)( block * BLOCK_SIZE ) + position : -1 );
+		}
+
+
+		void				decodeBlock( size_t			block,
+										 size_t			count,
+										 IndexType*		indices ) const
+		{
+			const void*		offsets = (const char*)m_offsets.data() + m_blockOffset[block];
+
+			switch( m_blockWidth[block] )
+			{
+				case 1 :
+					decodeOffsets( (const uint8_t*)offsets, count, m_blockFirst[block], indices );
+					break;
+
+				case 2 :
+					decodeOffsets( (const uint16_t*)offsets, count, m_blockFirst[block], indices );
+					break;
+
+				case 4 :
+					decodeOffsets( (const uint32_t*)offsets, count, m_blockFirst[block], indices );
+					break;
+
+				default :
+					decodeOffsets( (const uint64_t*)offsets, count, m_blockFirst[block], indices );
+					break;
+			}
+		}
+
+		//	A widening add with no dependence between iterations, the compiler vectorizes it
+
+		template<class Offset>
+		static void			decodeOffsets( const Offset*		offsets,
+										   size_t				count,
+										   IndexType			first,
+										   IndexType*			indices )
+		{
+			for( size_t i = 0; i < count; i++ )
+			{
+				indices[i] = first + (IndexType)offsets[i];
+			}
+		}
+
+
+		template<class Offset>
+		static long			findOffset( const Offset*		offsets,
+										size_t				count,
+										uint64_t			offset )
+		{
+			if( offset > std::numeric_limits<Offset>::max() )
+			{
+				return( -1 );
+			}
+
+			const Offset*		found = std::lower_bound( offsets, offsets + count, (Offset)offset );
+
+			return((( found != offsets + count ) && ( *found == offset )) ? found - offsets : -1 );
+		}
+	};
+
+
+
+	//	Copies the entries of the vector into their frozen form, leaving the vector empty.
+
+	template<class T, long CUTOVER_SIZE, class TieringPolicy, class IndexType>
+	FrozenSparseVector<T, IndexType>		freeze( SparseVector<T, CUTOVER_SIZE, TieringPolicy, IndexType>&		vector )
+	{
+		std::vector<T*>		entries;
+
+		entries.reserve( vector.size() );
+
+		vector.elements( entries );
+
+		std::sort( entries.begin(), entries.end(), []( const T* lhs, const T* rhs ) { return( lhs->index() < rhs->index() ); } );
+
+		FrozenSparseVector<T, IndexType>		frozen( entries );
+
+		vector.clear();
+
+		return( frozen );
+	}
+
+}	//	namespace SEFUtility
@@ -27,11 +27,24 @@ THE SOFTWARE.
 #pragma once
 
 
-#include <boost\ptr_container\ptr_vector.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <boost\noncopyable.hpp>
 
 #include <EASTL\list.h>
 #include <EASTL\fixed_vector.h>
 
+#include "AlignedUniquePtr.h"
+#include "ThreadIndex.h"
+
 
 
 
@@ -49,7 +62,9 @@ namespace SEFUtility
 
 	
 
-	template <typename T, unsigned int ChunkSize> class ObjectPoolManager;
+	template <typename T, unsigned int ChunkSize> class ObjectPool;
+
+	template <typename T, unsigned int ChunkSize, class Pool = ObjectPool<T, ChunkSize> > class ObjectPoolManager;
 
 
 
@@ -122,6 +137,8 @@ namespace SEFUtility
 
 		~ObjectPool()
 		{
+			destroyLiveObjects();
+
 			for (PoolChunk* currentChunk : m_poolChunks)
 			{
 				currentChunk->reset();
@@ -131,8 +148,12 @@ namespace SEFUtility
 
 
 
+		//	Destroys every object still in the pool, the chunks are kept for reuse.
+
 		void		reset()
 		{
+			destroyLiveObjects();
+
 			for (PoolChunk* currentChunk : m_poolChunks)
 			{
 				currentChunk->reset();
@@ -143,8 +164,11 @@ namespace SEFUtility
 			//	Initialize with two uninitialized objects, one will be the start marker, the second will be the end marker.
 			//		end() is defined as m_nextFreeObject, so this insures we can insert and delete safely without if statements.
 
+			m_currentChunkIndex = 0;
+
 			m_begin = (T*)((*m_currentChunk)->push_back_uninitialized());
 			m_nextFreeObject = (T*)((*m_currentChunk)->push_back_uninitialized());
+			m_nextFreeHandle = 1;
 
 			m_begin->m_prev = m_begin;
 			m_begin->m_next = m_nextFreeObject;
@@ -153,6 +177,10 @@ namespace SEFUtility
 			m_nextFreeObject->m_prev = m_begin;
 			m_nextFreeObject->m_next = m_nextFreeObject;
 
+			m_freeSlots = NULL;
+
+			std::fill(m_liveSlots.begin(), m_liveSlots.end(), 0);
+
 			m_size = 0;
 		}
 
@@ -170,91 +198,177 @@ namespace SEFUtility
 
 		T*			newObject()
 		{
-			if ((*m_currentChunk)->has_overflowed())
-			{
-				m_currentChunk++;
+			handle_type		handle;
+			T*				newObject = new(allocateSlot(handle))T;
 
-				if (m_currentChunk == m_poolChunks.end())
-				{
-					m_poolChunks.push_back(new PoolChunk());
+			linkAtEnd(newObject, handle);
 
-					m_currentChunk = m_poolChunks.end();
-					--m_currentChunk;
-				}
+			return(newObject);
+		}
+
+
+		template<class... _Valty>
+		T*			newObject(_Valty&&... _Val)
+		{
+			handle_type		handle;
+			T*				newObject = new (allocateSlot(handle))T(std::forward<_Valty>(_Val)...);
+
+			linkAtEnd(newObject, handle);
+
+			return(newObject);
+		}
+
+
+		//	Destroys the object and puts its slot on the free list, newObject() takes slots from there first.
+
+		void			free(T*		objectToFree)
+		{
+			objectToFree->m_prev->m_next = objectToFree->m_next;
+			objectToFree->m_next->m_prev = objectToFree->m_prev;
+
+			if (objectToFree == m_lastObject)
+			{
+				m_lastObject = objectToFree->m_prev;
 			}
 
-			T*		newObject = new(m_nextFreeObject)T;
+			handle_type		handle = handleOf(objectToFree);
 
-			m_nextFreeObject = (T*)((*m_currentChunk)->push_back_uninitialized());
+			assert((handle != INVALID_HANDLE) && isLive(handle));
 
-			m_size++;
+			setLive(handle, false);
 
-			//	The new object becomes the last object, so link everything accordingly
+			objectToFree->~T();
 
-			m_lastObject->m_next = newObject;
-			newObject->m_prev = m_lastObject;
-			m_lastObject = newObject;
-			newObject->m_next = m_nextFreeObject;
+			m_freeSlots = new(objectToFree) FreeSlot(m_freeSlots, handle);
 
-			return(newObject);
+			m_size--;
 		}
 
 
-		template<class... _Valty>
-		T*			newObject(_Valty&&... _Val)
+		size_t					size() const
 		{
-			if ((*m_currentChunk)->has_overflowed())
+			return(m_size);
+		}
+
+
+
+		//	The chunks as spans of ( first slot, slot count ), for handing to tbb::parallel_for or the like so
+		//		the objects can be processed across threads.  A span can hold freed slots, so check isLive() or
+		//		use for_each_in(), which read a bitmap of the live slots kept beside the chunks rather than the
+		//		slots themselves.  The spans are valid until the next newObject(), free() or reset().
+
+		typedef std::pair<T*, size_t>		ChunkSpan;
+
+
+		std::vector<ChunkSpan>	chunkSpans()
+		{
+			std::vector<ChunkSpan>		spans;
+
+			for (typename eastl::list<PoolChunk*>::iterator itrChunk = m_poolChunks.begin(); ; ++itrChunk)
 			{
-				m_currentChunk++;
+				T*			first = (*itrChunk)->data();
+				size_t		count = (*itrChunk)->size();
 
-				if (m_currentChunk == m_poolChunks.end())
+				//	Leave out the begin marker at the start of the first chunk and the end marker at the end of the current one
+
+				if (itrChunk == m_poolChunks.begin())
 				{
-					m_poolChunks.push_back(new PoolChunk());
+					first++;
+					count--;
+				}
 
-					m_currentChunk = m_poolChunks.end();
-					--m_currentChunk;
+				if (itrChunk == m_currentChunk)
+				{
+					count--;
 				}
-			}
 
-			T*		newObject = new (m_nextFreeObject)T(std::forward<_Valty>(_Val)...);
+				if (count > 0)
+				{
+					spans.push_back(ChunkSpan(first, count));
+				}
 
-			m_nextFreeObject = (T*)((*m_currentChunk)->push_back_uninitialized());
+				if (itrChunk == m_currentChunk)
+				{
+					break;
+				}
+			}
 
-			m_size++;
+			return(spans);
+		}
 
-			//	The new object becomes the last object, so link everything accordingly
 
-			m_lastObject->m_next = newObject;
-			newObject->m_prev = m_lastObject;
-			m_lastObject = newObject;
-			newObject->m_next = m_nextFreeObject;
+		bool					isLive(const T*		slot) const
+		{
+			handle_type		handle = handleOf(slot);
 
-			return(newObject);
+			return((handle != INVALID_HANDLE) && isLive(handle));
 		}
 
-
-		void			free(T*		objectToFree)
+		template<class Action>
+		void					for_each_in(const ChunkSpan&		span,
+											Action&&				action)
 		{
-			objectToFree->m_prev->m_next = objectToFree->m_next;
-			objectToFree->m_next->m_prev = objectToFree->m_prev;
+			handle_type		first = handleOf(span.first);
 
-			m_size--;
+			for (size_t slot = 0; slot < span.second; slot++)
+			{
+				if (isLive((handle_type)(first + slot)))
+				{
+					action(span.first[slot]);
+				}
+			}
 		}
 
 
-		size_t					size() const
+
+		//	A handle names an object by its position across the chunks, chunk number times ChunkSize plus the slot,
+		//		so it takes half the space of a pointer.  resolve() is an array lookup, handleOf() is a binary
+		//		search of the chunks by address.  Handles stay valid across reset() as the chunks are kept.
+		//		handleOf() returns INVALID_HANDLE for an address that is not a slot of this pool.
+
+		typedef T				value_type;
+		typedef uint32_t		handle_type;
+
+		static const handle_type		INVALID_HANDLE = 0xFFFFFFFF;
+
+
+		T*						resolve(handle_type		handle) const
 		{
-			return(m_size);
+			return(m_chunkBases[handle / ChunkSize] + (handle % ChunkSize));
+		}
+
+		handle_type				handleOf(const T*		object) const
+		{
+			typename std::vector<ChunkAddress>::const_iterator		itrChunk = std::upper_bound(m_chunksByAddress.begin(), m_chunksByAddress.end(), ChunkAddress(object, (handle_type)INVALID_HANDLE));
+
+			if (itrChunk == m_chunksByAddress.begin())
+			{
+				return(INVALID_HANDLE);
+			}
+
+			--itrChunk;
+
+			//	Compare addresses as integers, the object need not lie in the chunk found
+
+			uintptr_t		offset = (uintptr_t)object - (uintptr_t)itrChunk->first;
+
+			if ((offset >= ChunkSize * sizeof(T)) || (offset % sizeof(T) != 0))
+			{
+				return(INVALID_HANDLE);
+			}
+
+			return(itrChunk->second + (handle_type)(offset / sizeof(T)));
 		}
 
 
 	protected :
 
 			ObjectPool()
+				: m_size(0)
 			{
 				//	Start the chunk list with a new chunk
 
-				m_poolChunks.push_back(new PoolChunk());
+				addChunk();
 
 				reset();
 			}
@@ -267,40 +381,248 @@ namespace SEFUtility
 
 		typedef eastl::fixed_vector<T, ChunkSize, false>		PoolChunk;
 
+		typedef std::pair<const T*, handle_type>				ChunkAddress;
+
+
+		//	A freed slot holds the link to the next free slot in place of the object, and its own handle so
+		//		the slot can be marked live again when it is reused.
+
+		struct FreeSlot
+		{
+			FreeSlot(FreeSlot*		next,
+					 handle_type	handle)
+				: m_next(next),
+				  m_handle(handle)
+			{}
+
+			FreeSlot*		m_next;
+			handle_type		m_handle;
+		};
+
+		static_assert(sizeof(T) >= sizeof(FreeSlot), "Pooled objects must be large enough to hold the free list link");
+
 		eastl::list<PoolChunk*>									m_poolChunks;
 		typename eastl::list<PoolChunk*>::iterator				m_currentChunk;
+		size_t													m_currentChunkIndex;
 
 		size_t													m_size;
 
 		T*														m_begin;
 		T*														m_lastObject;
 		T*														m_nextFreeObject;
+		handle_type												m_nextFreeHandle;
+
+		FreeSlot*												m_freeSlots;
+
+		//	A bit per slot, by handle, set while the slot holds an object.  The markers are never set.
+
+		std::vector<uint64_t>									m_liveSlots;
+
+		std::vector<T*>											m_chunkBases;
+		std::vector<ChunkAddress>								m_chunksByAddress;
+
+
+		void*			allocateSlot(handle_type&		handle)
+		{
+			if (m_freeSlots != NULL)
+			{
+				FreeSlot*	slot = m_freeSlots;
+
+				m_freeSlots = slot->m_next;
+				handle = slot->m_handle;
+
+				return(slot);
+			}
+
+			if ((*m_currentChunk)->has_overflowed())
+			{
+				m_currentChunk++;
+				m_currentChunkIndex++;
+
+				if (m_currentChunk == m_poolChunks.end())
+				{
+					addChunk();
+
+					m_currentChunk = m_poolChunks.end();
+					--m_currentChunk;
+				}
+			}
+
+			//	The end marker's slot goes to the new object and a new end marker is taken from the chunk
+
+			T*		slot = m_nextFreeObject;
+
+			handle = m_nextFreeHandle;
+
+			m_nextFreeObject = (T*)((*m_currentChunk)->push_back_uninitialized());
+			m_nextFreeHandle = (handle_type)(m_currentChunkIndex * ChunkSize + (*m_currentChunk)->size() - 1);
+
+			return(slot);
+		}
+
+		//	The new object becomes the last object, so link everything accordingly
+
+		void			linkAtEnd(T*			newObject,
+								  handle_type	handle)
+		{
+			setLive(handle, true);
+
+			m_size++;
+
+			m_lastObject->m_next = newObject;
+			newObject->m_prev = m_lastObject;
+			m_lastObject = newObject;
+			newObject->m_next = m_nextFreeObject;
+		}
+
+
+		//	The chunks only hold raw slots, so the objects are destroyed by walking the live list from the begin
+		//		marker to the end marker.  The link is read before the object it sits in is destroyed.
+
+		void			destroyLiveObjects()
+		{
+			if (m_size == 0)
+			{
+				return;
+			}
+
+			T*		currentObject = m_begin->m_next;
+
+			while (currentObject != m_nextFreeObject)
+			{
+				T*		nextObject = currentObject->m_next;
+
+				currentObject->~T();
+
+				currentObject = nextObject;
+			}
+		}
+
+
+		void			addChunk()
+		{
+			assert((uint64_t)(m_chunkBases.size() + 1) * ChunkSize <= (uint64_t)INVALID_HANDLE);
+
+			m_poolChunks.push_back(new PoolChunk());
+
+			T*				base = m_poolChunks.back()->data();
+			ChunkAddress	chunkAddress(base, (handle_type)(m_chunkBases.size() * ChunkSize));
+
+			m_chunksByAddress.insert(std::upper_bound(m_chunksByAddress.begin(), m_chunksByAddress.end(), chunkAddress), chunkAddress);
+			m_chunkBases.push_back(base);
+
+			m_liveSlots.resize((m_chunkBases.size() * ChunkSize + 63) / 64, 0);
+		}
+
+
+		bool			isLive(handle_type		handle) const
+		{
+			return((m_liveSlots[handle / 64] >> (handle % 64)) & 1);
+		}
+
+		void			setLive(handle_type		handle,
+								bool			live)
+		{
+			uint64_t		bit = (uint64_t)1 << (handle % 64);
+
+			if (live)
+			{
+				m_liveSlots[handle / 64] |= bit;
+			}
+			else
+			{
+				m_liveSlots[handle / 64] &= ~bit;
+			}
+		}
 	};
 
 
 
 
-	template <typename T, unsigned int ChunkSize>
+	//
+	//	ObjectPoolManager may be shared by any number of threads.  Each thread keeps up to THREAD_CACHE_SIZE
+	//		checked in pools of its own, so a thread checking pools out and back in touches nothing shared.
+	//		Pools beyond that go to a depot shared by all threads, a lock free Treiber stack.
+	//
+	//	The depot stack links nodes from a fixed array rather than the pools themselves, so a node a popping
+	//		thread is looking at is never freed under it.  The stack heads carry a count bumped on every
+	//		change alongside the node index, so a node popped and pushed back between another thread's read
+	//		and its compare-and-swap fails that swap instead of corrupting the stack.  Once the depot holds
+	//		DEPOT_CAPACITY pools any further pool checked in is deleted.
+	//
+	//	A thread's cache outlives the thread, the next thread given the same ThreadIndex takes it over.  Each
+	//		cache has a cache line of its own, and the caches are allocated apart from the manager with
+	//		make_aligned() as new does not honour an alignment beyond that of max_align_t.
+	//
+	//	Pool is the kind of pool managed, ObjectPool or BitmapObjectPool.
+	//
+
+	template <typename T, unsigned int ChunkSize, class Pool>
 	class ObjectPoolManager : boost::noncopyable
 	{
 	public  :
 
-		typedef	ObjectPool<T, ChunkSize>			ObjectCollection;
+		typedef	Pool			ObjectCollection;
+
+		static const size_t			THREAD_CACHE_SIZE = 4;
+		static const uint32_t		DEPOT_CAPACITY = 1024;
 
 
 		ObjectPoolManager()
-			: m_freePools(10)
-		{}
+			: m_depotNodes(new DepotNode[DEPOT_CAPACITY]),
+			  m_threadCaches(make_aligned<ThreadCaches>()),
+			  m_readyPools(EMPTY_STACK),
+			  m_freeNodes(EMPTY_STACK)
+		{
+			for (uint32_t i = 0; i < DEPOT_CAPACITY; i++)
+			{
+				m_depotNodes[i].m_pool = NULL;
+				push(m_freeNodes, i);
+			}
+
+			for (ThreadCache& cache : m_threadCaches->m_caches)
+			{
+				cache.m_count = 0;
+			}
+		}
+
+		//	No thread may be checking pools in or out while the manager is destroyed.
 
 		~ObjectPoolManager()
-		{}
+		{
+			for (ThreadCache& cache : m_threadCaches->m_caches)
+			{
+				for (size_t i = 0; i < cache.m_count; i++)
+				{
+					delete cache.m_pools[i];
+				}
+			}
+
+			for (uint32_t node = pop(m_readyPools); node != NO_NODE; node = pop(m_readyPools))
+			{
+				delete m_depotNodes[node].m_pool;
+			}
+		}
 
 
 		std::unique_ptr<ObjectCollection>		getPool()
 		{
-			if (!m_freePools.empty())
+			ThreadCache&		cache = m_threadCaches->m_caches[ThreadIndex::current()];
+
+			if (cache.m_count > 0)
+			{
+				return(std::unique_ptr<ObjectCollection>(cache.m_pools[--cache.m_count]));
+			}
+
+			uint32_t			node = pop(m_readyPools);
+
+			if (node != NO_NODE)
 			{
-				return(std::unique_ptr<ObjectCollection>(m_freePools.pop_back().release()));
+				ObjectCollection*		pool = m_depotNodes[node].m_pool;
+
+				push(m_freeNodes, node);
+
+				return(std::unique_ptr<ObjectCollection>(pool));
 			}
 
 			return(std::unique_ptr<ObjectCollection>( new ObjectCollection() ));
@@ -309,14 +631,104 @@ namespace SEFUtility
 		void		returnPool(std::unique_ptr<ObjectCollection>&		poolToCheckin)
 		{
 			poolToCheckin->reset();
-			
-			m_freePools.push_back( poolToCheckin.release() );
+
+			ThreadCache&		cache = m_threadCaches->m_caches[ThreadIndex::current()];
+
+			if (cache.m_count < THREAD_CACHE_SIZE)
+			{
+				cache.m_pools[cache.m_count++] = poolToCheckin.release();
+				return;
+			}
+
+			uint32_t			node = pop(m_freeNodes);
+
+			if (node == NO_NODE)
+			{
+				poolToCheckin.reset();
+				return;
+			}
+
+			m_depotNodes[node].m_pool = poolToCheckin.release();
+
+			push(m_readyPools, node);
 		}
 
 
 	private :
 
-		boost::ptr_vector<ObjectCollection>			m_freePools;
+		//	A stack head packs the count of changes into the high 32 bits and the top node index into the low 32 bits.
+
+		static const uint32_t		NO_NODE = 0xFFFFFFFF;
+		static const uint64_t		EMPTY_STACK = NO_NODE;
+
+		static const size_t			CACHE_LINE_SIZE = 64;
+
+
+		struct DepotNode
+		{
+			ObjectCollection*			m_pool;
+			std::atomic<uint32_t>		m_next;
+		};
+
+		struct alignas(CACHE_LINE_SIZE) ThreadCache
+		{
+			ObjectCollection*		m_pools[THREAD_CACHE_SIZE];
+			size_t					m_count;
+		};
+
+		struct ThreadCaches
+		{
+			ThreadCache				m_caches[ThreadIndex::MAX_THREADS];
+		};
+
+
+		std::unique_ptr<DepotNode[]>		m_depotNodes;
+		aligned_unique_ptr<ThreadCaches>	m_threadCaches;
+
+		std::atomic<uint64_t>				m_readyPools;
+		std::atomic<uint64_t>				m_freeNodes;
+
+
+
+		static uint64_t		stackHead(uint64_t		version,
+									  uint32_t		node)
+		{
+			return((version << 32) | node);
+		}
+
+		void				push(std::atomic<uint64_t>&		stack,
+								 uint32_t					node)
+		{
+			uint64_t		head = stack.load(std::memory_order_relaxed);
+
+			do
+			{
+				m_depotNodes[node].m_next.store((uint32_t)head, std::memory_order_relaxed);
+			}
+			while (!stack.compare_exchange_weak(head, stackHead((head >> 32) + 1, node), std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		uint32_t			pop(std::atomic<uint64_t>&		stack)
+		{
+			uint64_t		head = stack.load(std::memory_order_acquire);
+
+			for (;;)
+			{
+				uint32_t		node = (uint32_t)head;
+
+				if (node == NO_NODE)
+				{
+					return(NO_NODE);
+				}
+
+				uint32_t		next = m_depotNodes[node].m_next.load(std::memory_order_relaxed);
+
+				if (stack.compare_exchange_weak(head, stackHead((head >> 32) + 1, next), std::memory_order_acquire, std::memory_order_acquire))
+				{
+					return(node);
+				}
+			}
+		}
 	};
 
 
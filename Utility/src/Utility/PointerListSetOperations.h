@@ -0,0 +1,414 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "SIMDIndexSearch.h"
+#include "FlatPointerSet.h"
+
+
+
+
+//
+//	Intersection and union across any number of SearchablePointerLists, or SearchableHandleLists, treating
+//		each list as a set of pointers.  intersect_each() and union_each() hand every pointer in the result
+//		to a visitor, in no particular order, and never build the result; intersection_of() and union_of()
+//		collect it into a vector for callers that want one.
+//
+//	Each call picks one of three strategies from the list sizes:
+//
+//		- When all the lists together hold no more than SMALL_TOTAL pointers they are copied into a buffer
+//			on the stack and sorted.  A pointer in every list shows up as a run as long as the list count.
+//		- Intersections probe the other lists with each pointer of the smallest, in order of size so that
+//			most misses are found by the cheapest lists.  Unions insert into a FlatPointerSet.
+//		- When the pointers fall in a narrow address range, as objects from one pool or array do, each list
+//			is turned into a bitmap over the range, one bit per possible object address, and the bitmaps
+//			are combined a word at a time.  For an intersection only the smallest list's range matters.
+//
+//	The inline tier of a list does not check for duplicates, so a list may hold a pointer more than once.
+//		Every strategy counts a pointer once per list and reports it at most once.
+//
+
+namespace SEFUtility
+{
+	namespace PointerListSetOperations
+	{
+		const size_t		SMALL_TOTAL = 256;
+
+
+		//	Address range of a list in units of the object alignment, every object address is a distinct bit.
+
+		template<class T>
+		struct AddressRange
+		{
+			AddressRange()
+				: m_lowest( UINTPTR_MAX ),
+				  m_highest( 0 )
+			{}
+
+			void		include( const T*		pointer )
+			{
+				m_lowest = std::min( m_lowest, (uintptr_t)pointer );
+				m_highest = std::max( m_highest, (uintptr_t)pointer );
+			}
+
+			bool		contains( const T*		pointer ) const
+			{
+				return(( (uintptr_t)pointer >= m_lowest ) && ( (uintptr_t)pointer <= m_highest ));
+			}
+
+			size_t		bitOf( const T*		pointer ) const
+			{
+				return( (size_t)(( (uintptr_t)pointer - m_lowest ) / __alignof( T )) );
+			}
+
+			T*			pointerOf( size_t		bit ) const
+			{
+				return( (T*)( m_lowest + bit * __alignof( T ) ));
+			}
+
+			size_t		words() const
+			{
+				return( m_lowest > m_highest ? 0 : bitOf( (const T*)m_highest ) / 64 + 1 );
+			}
+
+			uintptr_t		m_lowest;
+			uintptr_t		m_highest;
+		};
+
+
+		template<class List>
+		bool		smallerList( const List*		first,
+								 const List*		second )
+		{
+			return( first->size() < second->size() );
+		}
+
+
+		template<class List>
+		size_t		totalSize( const List* const*		lists,
+							   size_t					count )
+		{
+			size_t		total = 0;
+
+			for( size_t i = 0; i < count; i++ )
+			{
+				total += lists[i]->size();
+			}
+
+			return( total );
+		}
+
+
+		//	Copies every pointer into the buffer and sorts it, then hands the runs of at least minimumRun copies
+		//		of a pointer to the visitor - the list count for an intersection, one for a union.  Each list's
+		//		pointers are made distinct as they are copied, so a run counts the lists holding the pointer.
+
+		template<class List, class Visitor>
+		void		sortAndMerge( const List* const*		lists,
+								  size_t					count,
+								  size_t					minimumRun,
+								  Visitor&					visitor )
+		{
+			typedef typename List::value_type		T;
+
+			T*			buffer[SMALL_TOTAL];
+			size_t		bufferSize = 0;
+
+			for( size_t i = 0; i < count; i++ )
+			{
+				size_t		listStart = bufferSize;
+
+				for( T* entry : *lists[i] )
+				{
+					buffer[bufferSize++] = entry;
+				}
+
+				std::sort( buffer + listStart, buffer + bufferSize );
+
+				bufferSize = std::unique( buffer + listStart, buffer + bufferSize ) - buffer;
+			}
+
+			std::sort( buffer, buffer + bufferSize );
+
+			for( size_t runStart = 0; runStart < bufferSize; )
+			{
+				size_t		runEnd = runStart + 1;
+
+				while(( runEnd < bufferSize ) && ( buffer[runEnd] == buffer[runStart] ))
+				{
+					runEnd++;
+				}
+
+				if( runEnd - runStart >= minimumRun )
+				{
+					visitor( buffer[runStart] );
+				}
+
+				runStart = runEnd;
+			}
+		}
+
+
+		//	True if every list but the first in bySize holds the pointer, the lists are probed smallest first.
+
+		template<class List>
+		bool		inAllOthers( const std::vector<const List*>&		bySize,
+								 typename List::value_type*				entry )
+		{
+			for( size_t i = 1; i < bySize.size(); i++ )
+			{
+				if( !bySize[i]->contains( entry ) )
+				{
+					return( false );
+				}
+			}
+
+			return( true );
+		}
+
+
+		template<class List, class Visitor>
+		void		visitBits( const std::vector<uint64_t>&					bits,
+							   const AddressRange<typename List::value_type>&	range,
+							   Visitor&											visitor )
+		{
+			for( size_t word = 0; word < bits.size(); word++ )
+			{
+				for( uint64_t remaining = bits[word]; remaining != 0; remaining &= remaining - 1 )
+				{
+					visitor( range.pointerOf( word * 64 + SIMD::countTrailingZeros( remaining ) ) );
+				}
+			}
+		}
+
+		template<class List>
+		void		setBits( const List&										list,
+							 const AddressRange<typename List::value_type>&		range,
+							 std::vector<uint64_t>&								bits )
+		{
+			for( typename List::value_type* entry : list )
+			{
+				if( range.contains( entry ) )
+				{
+					size_t		bit = range.bitOf( entry );
+
+					bits[bit / 64] |= (uint64_t)1 << ( bit % 64 );
+				}
+			}
+		}
+	}
+
+
+
+	template<class List, class Visitor>
+	void		intersect_each( const List* const*		lists,
+								size_t					count,
+								Visitor&&				visitor )
+	{
+		using namespace PointerListSetOperations;
+
+		typedef typename List::value_type		T;
+
+		if( count == 0 )
+		{
+			return;
+		}
+
+		std::vector<const List*>		bySize( lists, lists + count );
+
+		std::sort( bySize.begin(), bySize.end(), smallerList<List> );
+
+		const List&		smallest = *bySize.front();
+
+		if( smallest.empty() )
+		{
+			return;
+		}
+
+		size_t		total = totalSize( lists, count );
+
+		if( total <= SMALL_TOTAL )
+		{
+			sortAndMerge( lists, count, count, visitor );
+			return;
+		}
+
+		//	The bitmap pays off when the smallest list is dense in its range and reading the other lists in
+		//		full costs no more than probing them a few times for each pointer of the smallest.
+
+		AddressRange<T>		range;
+
+		for( T* entry : smallest )
+		{
+			range.include( entry );
+		}
+
+		if(( range.words() <= smallest.size() ) && ( total <= 4 * smallest.size() * count ))
+		{
+			std::vector<uint64_t>		result( range.words(), 0 );
+			std::vector<uint64_t>		bits( range.words(), 0 );
+
+			setBits( smallest, range, result );
+
+			for( size_t i = 1; i < count; i++ )
+			{
+				std::fill( bits.begin(), bits.end(), 0 );
+
+				setBits( *bySize[i], range, bits );
+
+				for( size_t word = 0; word < result.size(); word++ )
+				{
+					result[word] &= bits[word];
+				}
+			}
+
+			visitBits<List>( result, range, visitor );
+			return;
+		}
+
+		//	Probing from the smallest list reports its duplicates as often as they occur, so a small list is
+		//		made distinct on the stack first and a larger one has its results filtered through a set.
+
+		if( smallest.size() <= SMALL_TOTAL )
+		{
+			T*			distinct[SMALL_TOTAL];
+			size_t		distinctSize = 0;
+
+			for( T* entry : smallest )
+			{
+				distinct[distinctSize++] = entry;
+			}
+
+			std::sort( distinct, distinct + distinctSize );
+
+			distinctSize = std::unique( distinct, distinct + distinctSize ) - distinct;
+
+			for( size_t i = 0; i < distinctSize; i++ )
+			{
+				if( inAllOthers( bySize, distinct[i] ) )
+				{
+					visitor( distinct[i] );
+				}
+			}
+
+			return;
+		}
+
+		FlatPointerSet<T>		reported;
+
+		for( T* entry : smallest )
+		{
+			if( inAllOthers( bySize, entry ) && reported.insert( entry ) )
+			{
+				visitor( entry );
+			}
+		}
+	}
+
+
+	template<class List, class Visitor>
+	void		union_each( const List* const*		lists,
+							size_t					count,
+							Visitor&&				visitor )
+	{
+		using namespace PointerListSetOperations;
+
+		typedef typename List::value_type		T;
+
+		size_t		total = totalSize( lists, count );
+
+		if( total <= SMALL_TOTAL )
+		{
+			sortAndMerge( lists, count, 1, visitor );
+			return;
+		}
+
+		AddressRange<T>		range;
+
+		for( size_t i = 0; i < count; i++ )
+		{
+			for( T* entry : *lists[i] )
+			{
+				range.include( entry );
+			}
+		}
+
+		if( range.words() <= total )
+		{
+			std::vector<uint64_t>		result( range.words(), 0 );
+
+			for( size_t i = 0; i < count; i++ )
+			{
+				setBits( *lists[i], range, result );
+			}
+
+			visitBits<List>( result, range, visitor );
+			return;
+		}
+
+		FlatPointerSet<T>		seen( total );
+
+		for( size_t i = 0; i < count; i++ )
+		{
+			for( T* entry : *lists[i] )
+			{
+				if( seen.insert( entry ) )
+				{
+					visitor( entry );
+				}
+			}
+		}
+	}
+
+
+
+	template<class List>
+	void		intersection_of( const List* const*								lists,
+								 size_t											count,
+								 std::vector<typename List::value_type*>&		result )
+	{
+		intersect_each( lists, count, [&result]( typename List::value_type*		entry ) { result.push_back( entry ); } );
+	}
+
+	template<class List>
+	void		union_of( const List* const*							lists,
+						  size_t										count,
+						  std::vector<typename List::value_type*>&		result )
+	{
+		union_each( lists, count, [&result]( typename List::value_type*		entry ) { result.push_back( entry ); } );
+	}
+
+}	//	namespace SEFUtility
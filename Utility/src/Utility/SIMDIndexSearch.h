@@ -0,0 +1,235 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined( __AVX2__ ) || defined( __SSE2__ ) || defined( _M_X64 )
+#include <immintrin.h>
+#endif
+
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+
+
+
+
+//
+//	Linear search of a contiguous array of integer keys, comparing several keys per instruction
+//		when the target supports it.  AVX2 compares four 64 bit or eight 32 bit keys at once, SSE2
+//		compares half as many.  Targets without either fall back to the plain scalar loop.
+//
+//	The searches return the position of the first matching key, or -1 if the key is not present.
+//		All loads are unaligned, so the arrays need no particular alignment.
+//
+
+
+namespace SEFUtility
+{
+	namespace SIMD
+	{
+
+		//	Position of the lowest set bit, value must be non-zero.  Compiles down to tzcnt/bsf.
+
+		inline unsigned int		countTrailingZeros( uint64_t		value )
+		{
+#if defined( _MSC_VER )
+			unsigned long		position;
+
+			_BitScanForward64( &position, value );
+
+			return( (unsigned int)position );
+#else
+			return( (unsigned int)__builtin_ctzll( value ) );
+#endif
+		}
+
+
+		//	Unsigned integer type of a given width, used to pick the search and hash specialized for a key size.
+
+		template<size_t WIDTH> struct UnsignedOfWidth;
+
+		template<> struct UnsignedOfWidth<4>
+		{
+			typedef uint32_t		type;
+		};
+
+		template<> struct UnsignedOfWidth<8>
+		{
+			typedef uint64_t		type;
+		};
+
+
+
+		//	The vector loops compare whole blocks of keys, set 'scanned' to the number of keys they covered
+		//		and leave any tail shorter than a block to the scalar loop in findIndex().
+
+		inline int		vectorFindIndex( const uint64_t*		keys,
+										 size_t					count,
+										 uint64_t				key,
+										 size_t&				scanned )
+		{
+			size_t		i = 0;
+
+#if defined( __AVX2__ )
+
+			const __m256i		target = _mm256_set1_epi64x( (long long)key );
+
+			for( ; i + 4 <= count; i += 4 )
+			{
+				__m256i		block = _mm256_loadu_si256( (const __m256i*)( keys + i ) );
+
+				int			mask = _mm256_movemask_pd( _mm256_castsi256_pd( _mm256_cmpeq_epi64( block, target ) ) );
+
+				if( mask != 0 )
+				{
+					return( (int)i + countTrailingZeros( (uint64_t)mask ) );
+				}
+			}
+
+#elif defined( __SSE2__ ) || defined( _M_X64 )
+
+			//	SSE2 has no 64 bit compare, so compare the 32 bit halves and require both halves of a lane to match.
+
+			const __m128i		target = _mm_set1_epi64x( (long long)key );
+
+			for( ; i + 2 <= count; i += 2 )
+			{
+				__m128i		halves = _mm_cmpeq_epi32( _mm_loadu_si128( (const __m128i*)( keys + i ) ), target );
+				__m128i		lanes = _mm_and_si128( halves, _mm_shuffle_epi32( halves, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+
+				int			mask = _mm_movemask_pd( _mm_castsi128_pd( lanes ) );
+
+				if( mask != 0 )
+				{
+					return( (int)i + ( mask & 1 ? 0 : 1 ) );
+				}
+			}
+
+#endif
+
+			scanned = i;
+
+			return( -1 );
+		}
+
+
+		//	32 bit keys fit twice as many to a register: eight per AVX2 compare and four per SSE2 compare.
+
+		inline int		vectorFindIndex( const uint32_t*		keys,
+										 size_t					count,
+										 uint32_t				key,
+										 size_t&				scanned )
+		{
+			size_t		i = 0;
+
+#if defined( __AVX2__ )
+
+			const __m256i		target = _mm256_set1_epi32( (int)key );
+
+			for( ; i + 8 <= count; i += 8 )
+			{
+				__m256i		block = _mm256_loadu_si256( (const __m256i*)( keys + i ) );
+
+				int			mask = _mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpeq_epi32( block, target ) ) );
+
+				if( mask != 0 )
+				{
+					return( (int)i + countTrailingZeros( (uint64_t)mask ) );
+				}
+			}
+
+#elif defined( __SSE2__ ) || defined( _M_X64 )
+
+			const __m128i		target = _mm_set1_epi32( (int)key );
+
+			for( ; i + 4 <= count; i += 4 )
+			{
+				__m128i		block = _mm_loadu_si128( (const __m128i*)( keys + i ) );
+
+				int			mask = _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( block, target ) ) );
+
+				if( mask != 0 )
+				{
+					return( (int)i + countTrailingZeros( (uint64_t)mask ) );
+				}
+			}
+
+#endif
+
+			scanned = i;
+
+			return( -1 );
+		}
+
+
+		//	Works for any 32 or 64 bit integer key type, e.g. size_t which is not always the same type as uint64_t.
+
+		template<class IndexType>
+		inline int		findIndex( const IndexType*		keys,
+								   size_t				count,
+								   IndexType			key )
+		{
+			typedef typename UnsignedOfWidth<sizeof( IndexType )>::type		Key;
+
+			size_t		scanned = 0;
+			int			found = vectorFindIndex( reinterpret_cast<const Key*>( keys ), count, (Key)key, scanned );
+
+			if( found >= 0 )
+			{
+				return( found );
+			}
+
+			for( size_t i = scanned; i < count; i++ )
+			{
+				if( keys[i] == key )
+				{
+					return( (int)i );
+				}
+			}
+
+			return( -1 );
+		}
+
+
+		//	Pointers are compared as integers of the same width, so a 64 bit target compares four per AVX2 instruction.
+
+		template<class T>
+		inline int		findPointer( T* const*		pointers,
+									 size_t			count,
+									 const T*		pointer )
+		{
+			return( findIndex( reinterpret_cast<const uintptr_t*>( pointers ), count, (uintptr_t)pointer ) );
+		}
+
+	}	//	namespace SIMD
+
+}	//	namespace SEFUtility
@@ -0,0 +1,427 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+#pragma once
+
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+#include <boost/container/static_vector.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+
+#include "SIMDIndexSearch.h"
+#include "FlatIndexMap.h"
+#include "SparseVector.h"
+
+
+
+
+//
+//	SearchableHandleList is a SearchablePointerList for objects that all live in one ObjectPool.  It stores the
+//		pool's 32 bit handles rather than pointers, so the same bytes hold twice as many entries inline and
+//		the inline search compares eight handles per AVX2 instruction.  Past the cutover the handles go to
+//		a FlatIndexMap.
+//
+//	The list keeps a pointer to the pool and resolves handles on the way out, so iteration, for_each() and
+//		for_each_chunk() hand out T* exactly as SearchablePointerList does.  Going the other way costs
+//		the pool's handleOf(), a binary search over its chunks, on every insert(), erase() and contains().
+//
+//	Any pool type providing value_type, handle_type, resolve(), handleOf() and INVALID_HANDLE will do.  A
+//		pointer from outside the pool is never contained in the list, so contains() and find() report it
+//		missing and erase() ignores it.
+//
+
+
+namespace SEFUtility
+{
+
+	template<class Pool, long CUTOVER_SIZE = DEFAULT_POINTER_LIST_CUTOVER_SIZE * 2>
+	class SearchableHandleList
+	{
+	public:
+
+		typedef typename Pool::value_type		value_type;
+		typedef typename Pool::handle_type		handle_type;
+
+	private:
+
+		typedef value_type		T;
+
+
+		struct HandleEntry
+		{
+			explicit HandleEntry( handle_type		handle )
+				: m_handle( handle )
+			{}
+
+			handle_type		index() const
+			{
+				return( m_handle );
+			}
+
+			handle_type		m_handle;
+		};
+
+
+		typedef boost::container::static_vector<handle_type, CUTOVER_SIZE>		HandleVector;
+		typedef FlatIndexMap<HandleEntry, handle_type>								HandleSet;
+
+		static const size_t		MAX_CHUNK_SIZE = 64;
+
+
+	public:
+
+
+		class iterator : public boost::iterator_facade<iterator, T*, boost::forward_traversal_tag, T*>
+		{
+		protected:
+
+			friend class SearchableHandleList;
+			friend class boost::iterator_core_access;
+
+
+			iterator( const Pool*				pool,
+					  const handle_type*		inlineHandle )
+				: m_pool( pool ),
+				  m_cutOver( false ),
+				  m_inlineHandle( inlineHandle )
+			{}
+
+			iterator( const Pool*										pool,
+					  const typename HandleSet::const_iterator&			setIterator )
+				: m_pool( pool ),
+				  m_cutOver( true ),
+				  m_inlineHandle( NULL ),
+				  m_setIterator( setIterator )
+			{}
+
+
+			void increment()
+			{
+				if (m_cutOver)
+				{
+					++m_setIterator;
+				}
+				else
+				{
+					m_inlineHandle++;
+				}
+			}
+
+			bool equal( iterator const& other ) const
+			{
+				if (m_cutOver)
+				{
+					return( m_setIterator == other.m_setIterator );
+				}
+
+				return( m_inlineHandle == other.m_inlineHandle );
+			}
+
+			T*		dereference() const
+			{
+				return( m_pool->resolve( m_cutOver ? m_setIterator->index() : *m_inlineHandle ) );
+			}
+
+
+			const Pool*									m_pool;
+
+			bool										m_cutOver;
+
+			const handle_type*							m_inlineHandle;
+			typename HandleSet::const_iterator			m_setIterator;
+		};
+
+		typedef iterator		const_iterator;
+
+
+
+
+		explicit SearchableHandleList( Pool&		pool )
+			: m_pool( &pool ),
+			  m_cutover( false ),
+			  m_set( NULL )
+		{}
+
+		SearchableHandleList( SearchableHandleList&&		listToMove ) noexcept
+			: m_pool( listToMove.m_pool ),
+			  m_cutover( false ),
+			  m_set( NULL )
+		{
+			takeFrom( listToMove );
+		}
+
+		~SearchableHandleList()
+		{
+			delete m_set;
+		}
+
+		SearchableHandleList&		operator=( SearchableHandleList&&		listToMove ) noexcept
+		{
+			if (this != &listToMove)
+			{
+				clear();
+
+				m_pool = listToMove.m_pool;
+				takeFrom( listToMove );
+			}
+
+			return( *this );
+		}
+
+
+
+		void					clear()
+		{
+			delete m_set;
+			m_set = NULL;
+
+			m_handles.clear();
+
+			m_cutover = false;
+		}
+
+		void					reserve( size_t		entries )
+		{
+			if (!m_cutover && ( entries > CUTOVER_SIZE ))
+			{
+				moveArrayIntoSet( entries );
+			}
+			else if (m_cutover)
+			{
+				m_set->reserve( entries );
+			}
+		}
+
+
+
+		size_t					size() const
+		{
+			if (!m_cutover)
+			{
+				return( m_handles.size() );
+			}
+
+			return( m_set->size() );
+		}
+
+		bool					empty() const
+		{
+			return( size() == 0 );
+		}
+
+		T*						front() const
+		{
+			return( *begin() );
+		}
+
+
+
+		iterator				begin() const
+		{
+			if (!m_cutover)
+			{
+				return( iterator( m_pool, m_handles.data() ) );
+			}
+
+			return( iterator( m_pool, static_cast<const HandleSet*>( m_set )->begin() ) );
+		}
+
+		iterator				end() const
+		{
+			if (!m_cutover)
+			{
+				return( iterator( m_pool, m_handles.data() + m_handles.size() ) );
+			}
+
+			return( iterator( m_pool, static_cast<const HandleSet*>( m_set )->end() ) );
+		}
+
+
+
+		bool					contains( const T*		value ) const
+		{
+			handle_type		handle = m_pool->handleOf( value );
+
+			if (handle == Pool::INVALID_HANDLE)
+			{
+				return( false );
+			}
+
+			if (!m_cutover)
+			{
+				return( SIMD::findIndex( m_handles.data(), m_handles.size(), handle ) >= 0 );
+			}
+
+			return( m_set->find( handle ) != NULL );
+		}
+
+		T*						find( const T*		value ) const
+		{
+			return( contains( value ) ? const_cast<T*>( value ) : NULL );
+		}
+
+
+		void					insert( T*		newValue )
+		{
+			handle_type		handle = m_pool->handleOf( newValue );
+
+			assert( handle != Pool::INVALID_HANDLE );
+
+			if (!m_cutover)
+			{
+				if (m_handles.size() < CUTOVER_SIZE)
+				{
+					m_handles.push_back( handle );
+					return;
+				}
+
+				moveArrayIntoSet( CUTOVER_SIZE * 2 );
+			}
+
+			m_set->find_or_add( handle );
+		}
+
+		void					erase( T*		value )
+		{
+			handle_type		handle = m_pool->handleOf( value );
+
+			if (handle == Pool::INVALID_HANDLE)
+			{
+				return;
+			}
+
+			if (!m_cutover)
+			{
+				int		position = SIMD::findIndex( m_handles.data(), m_handles.size(), handle );
+
+				if (position >= 0)
+				{
+					m_handles.erase( m_handles.begin() + position );
+				}
+			}
+			else
+			{
+				m_set->erase( handle );
+			}
+		}
+
+
+
+		inline void for_each( std::function<void( T &entry )> action )
+		{
+			for (T* currentEntry : *this)
+			{
+				action( *currentEntry );
+			}
+		}
+
+		template<class Action>
+		inline void for_each( Action&&		action )
+		{
+			for (T* currentEntry : *this)
+			{
+				action( *currentEntry );
+			}
+		}
+
+
+		//	Visits the pointers a run at a time as visitor( T* const* entries, size_t count ).  The handles are
+		//		resolved into a buffer, so the runs are at most 64 long in either tier.
+
+		template<class Visitor>
+		void			for_each_chunk( Visitor&&		visitor )
+		{
+			T*			run[MAX_CHUNK_SIZE];
+			size_t		runLength = 0;
+
+			for (T* currentEntry : *this)
+			{
+				run[runLength++] = currentEntry;
+
+				if (runLength == MAX_CHUNK_SIZE)
+				{
+					visitor( (T* const*)run, runLength );
+					runLength = 0;
+				}
+			}
+
+			if (runLength > 0)
+			{
+				visitor( (T* const*)run, runLength );
+			}
+		}
+
+
+	private:
+
+		SearchableHandleList( const SearchableHandleList&		listToCopy );
+		SearchableHandleList&		operator=( const SearchableHandleList&		listToCopy );
+
+
+		Pool*						m_pool;
+
+		bool						m_cutover;
+
+		HandleVector				m_handles;
+
+		HandleSet*					m_set;
+
+
+
+		void			takeFrom( SearchableHandleList&		listToMove )
+		{
+			m_cutover = listToMove.m_cutover;
+			m_handles = listToMove.m_handles;
+			m_set = listToMove.m_set;
+
+			listToMove.m_set = NULL;
+			listToMove.clear();
+		}
+
+		void			moveArrayIntoSet( size_t		capacity )
+		{
+			m_set = new HandleSet( capacity );
+
+			for (handle_type handle : m_handles)
+			{
+				m_set->find_or_add( handle );
+			}
+
+			m_handles.clear();
+
+			m_cutover = true;
+		}
+	};
+
+}	//	namespace SEFUtility
@@ -0,0 +1,264 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+#pragma once
+
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include "EpochDomain.h"
+#include "SparseVector.h"
+
+
+
+
+//
+//	SnapshotPointerList wraps a SearchablePointerList for one writer thread and any number of reader threads.
+//		Readers take a Snapshot, an immutable view of the list as it was when taken, without locking; the
+//		list seen through a snapshot never changes and stays valid until the snapshot is destroyed.
+//
+//	Every change is made on a copy of the current list, which is then published with a single atomic
+//		exchange.  The version it replaces is retired and freed by the writer once the EpochDomain shows
+//		no reader could still hold it.  Copying makes writes O(n), so group changes made together into
+//		one update() call.
+//
+//	Only one thread may write at a time.
+//
+//	A snapshot pins the reader slot and the thread local nesting depth of the thread that took it, so it
+//		must be destroyed on that thread.  It can be moved around within the thread, but not handed to
+//		another one; debug builds assert this.
+//
+
+namespace SEFUtility
+{
+
+	template<class T, long CUTOVER_SIZE = DEFAULT_POINTER_LIST_CUTOVER_SIZE, class OverflowPolicy = HashedOverflowPolicy>
+	class SnapshotPointerList : boost::noncopyable
+	{
+	public :
+
+		typedef SearchablePointerList<T, CUTOVER_SIZE, OverflowPolicy>		List;
+		typedef T															value_type;
+		typedef typename List::const_iterator								const_iterator;
+
+
+		//	Holds the reader inside the epoch domain for as long as it lives, so keep snapshots short lived
+		//		or the writer cannot free the versions they hold back.  Destroy it on the thread that took it.
+
+		class Snapshot : boost::noncopyable
+		{
+		public :
+
+			Snapshot( Snapshot&&		snapshotToMove )
+				: m_list( snapshotToMove.m_list ),
+				  m_owner( snapshotToMove.m_owner )
+			{
+				snapshotToMove.m_list = NULL;
+			}
+
+			~Snapshot()
+			{
+				if( m_list != NULL )
+				{
+					assert( std::this_thread::get_id() == m_owner );
+
+					EpochDomain::global().leave();
+				}
+			}
+
+
+			const List&			operator*() const
+			{
+				return( *m_list );
+			}
+
+			const List*			operator->() const
+			{
+				return( m_list );
+			}
+
+
+			size_t				size() const
+			{
+				return( m_list->size() );
+			}
+
+			bool				empty() const
+			{
+				return( m_list->empty() );
+			}
+
+			bool				contains( const T*		value ) const
+			{
+				return( m_list->contains( value ) );
+			}
+
+			const_iterator		begin() const
+			{
+				return( m_list->begin() );
+			}
+
+			const_iterator		end() const
+			{
+				return( m_list->end() );
+			}
+
+
+		private :
+
+			friend class SnapshotPointerList;
+
+
+			explicit Snapshot( const std::atomic<List*>&		current )
+				: m_owner( std::this_thread::get_id() )
+			{
+				EpochDomain::global().enter();
+
+				m_list = current.load( std::memory_order_seq_cst );
+			}
+
+
+			const List*			m_list;
+
+			std::thread::id		m_owner;
+		};
+
+
+
+		SnapshotPointerList()
+			: m_current( new List() )
+		{}
+
+		//	There must be no readers left when the list is destroyed.
+
+		~SnapshotPointerList()
+		{
+			delete m_current.load( std::memory_order_relaxed );
+
+			for( RetiredVersion& retired : m_retired )
+			{
+				delete retired.first;
+			}
+		}
+
+
+
+		Snapshot			snapshot() const
+		{
+			return( Snapshot( m_current ) );
+		}
+
+
+
+		//	The methods below are for the writer thread only.
+
+		void				insert( T*		newValue )
+		{
+			update( [newValue]( List&	list ) { if( !list.contains( newValue ) ) list.insert( newValue ); } );
+		}
+
+		void				erase( T*		value )
+		{
+			update( [value]( List&	list ) { list.erase( value ); } );
+		}
+
+		//	Applies mutation( List& ) to a copy of the current list and publishes the result.
+
+		template<class Mutation>
+		void				update( Mutation&&		mutation )
+		{
+			const List*		current = m_current.load( std::memory_order_relaxed );
+			List*			nextVersion = new List();
+
+			nextVersion->reserve( current->size() );
+
+			for( T* entry : *current )
+			{
+				nextVersion->insert( entry );
+			}
+
+			mutation( *nextVersion );
+
+			publish( nextVersion );
+		}
+
+		//	Frees the retired versions no reader can still see, returns the number still waiting.
+
+		size_t				reclaim()
+		{
+			uint64_t		oldestActive = EpochDomain::global().oldestActiveEpoch();
+			size_t			kept = 0;
+
+			for( size_t i = 0; i < m_retired.size(); i++ )
+			{
+				if( m_retired[i].second < oldestActive )
+				{
+					delete m_retired[i].first;
+				}
+				else
+				{
+					m_retired[kept++] = m_retired[i];
+				}
+			}
+
+			m_retired.resize( kept );
+
+			return( kept );
+		}
+
+
+	private :
+
+		typedef std::pair<List*, uint64_t>		RetiredVersion;
+
+
+		std::atomic<List*>				m_current;
+
+		std::vector<RetiredVersion>		m_retired;
+
+
+		void				publish( List*		nextVersion )
+		{
+			List*		previous = m_current.exchange( nextVersion, std::memory_order_seq_cst );
+
+			m_retired.push_back( RetiredVersion( previous, EpochDomain::global().advance() ));
+
+			reclaim();
+		}
+	};
+
+}	//	namespace SEFUtility
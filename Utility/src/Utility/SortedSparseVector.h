@@ -0,0 +1,926 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/container/static_vector.hpp>
+
+#include "SparseVector.h"
+
+
+
+
+//
+//	SortedSparseVector keeps its entries ordered by index, which SparseVector does not, so two vectors
+//		can be combined with a single merge pass instead of a hash probe per entry.  Small vectors hold
+//		a sorted inline array; past the cutover the entries move to a chunked array, a list of sorted
+//		fixed size chunks with a separate directory of the first index in each chunk.  A lookup binary
+//		searches the directory and then the chunk, an insertion only shifts the entries of one chunk.
+//
+//	The iterators walk the entries in index order.  Beyond the usual forward iterator operations they
+//		expose index() and advance_to(), which gallops forward to the first entry at or past a target
+//		index.  The kernels at the bottom of the file - intersection, union, dot and axpy - are built on
+//		those two operations and switch from a linear merge to galloping when one vector is much
+//		smaller than the other.
+//
+//	As with SparseVector, pointers and iterators are only stable until the next insertion or erasure.
+//
+
+
+namespace SEFUtility
+{
+	namespace SortedSparse
+	{
+		//	Past this size ratio the kernels walk the smaller vector and gallop through the larger one
+
+		const size_t		GALLOP_RATIO = 16;
+
+
+		//	First position at or after 'from' whose index is not less than the target, found by doubling the
+		//		step until the target is passed and then binary searching the last step.
+
+		template<class IndexType>
+		inline size_t		gallop( const IndexType*	indices,
+									size_t				from,
+									size_t				count,
+									IndexType			target )
+		{
+			size_t		low = from;
+			size_t		high = from;
+			size_t		step = 1;
+
+			while(( high < count ) && ( indices[high] < target ))
+			{
+				low = high + 1;
+				high += step;
+				step *= 2;
+			}
+
+			high = std::min( high, count );
+
+			return( std::lower_bound( indices + low, indices + high, target ) - indices );
+		}
+
+
+
+		//	A sorted run of at most CAPACITY entries, with the indices in their own array for searching.
+
+		template<class T, class IndexType, size_t CAPACITY>
+		class SortedRun
+		{
+		public :
+
+			size_t				size() const
+			{
+				return( m_entries.size() );
+			}
+
+			bool				empty() const
+			{
+				return( m_entries.empty() );
+			}
+
+			bool				full() const
+			{
+				return( m_entries.size() == CAPACITY );
+			}
+
+			const IndexType*	indices() const
+			{
+				return( m_indices );
+			}
+
+			IndexType			indexAt( size_t		position ) const
+			{
+				return( m_indices[position] );
+			}
+
+			T&					entryAt( size_t		position )
+			{
+				return( m_entries[position] );
+			}
+
+			const T&			entryAt( size_t		position ) const
+			{
+				return( m_entries[position] );
+			}
+
+
+			size_t				lowerBound( IndexType		index ) const
+			{
+				return( std::lower_bound( m_indices, m_indices + size(), index ) - m_indices );
+			}
+
+
+			T&					insertAt( size_t		position,
+										  IndexType		index )
+			{
+				std::copy_backward( m_indices + position, m_indices + size(), m_indices + size() + 1 );
+				m_indices[position] = index;
+
+				return( *m_entries.emplace( m_entries.begin() + position, index ) );
+			}
+
+			T&					append( IndexType		index )
+			{
+				m_indices[size()] = index;
+				m_entries.emplace_back( index );
+
+				return( m_entries.back() );
+			}
+
+			T&					append( T&&		entry )
+			{
+				m_indices[size()] = entry.index();
+				m_entries.push_back( std::move( entry ) );
+
+				return( m_entries.back() );
+			}
+
+			void				eraseAt( size_t		position )
+			{
+				std::copy( m_indices + position + 1, m_indices + size(), m_indices + position );
+
+				m_entries.erase( m_entries.begin() + position );
+			}
+
+			void				clear()
+			{
+				m_entries.clear();
+			}
+
+
+			//	Moves the upper half of this run to the end of the other run.
+
+			template<class OtherRun>
+			void				moveUpperHalfTo( OtherRun&		upper )
+			{
+				size_t		half = size() / 2;
+
+				for( size_t i = half; i < size(); i++ )
+				{
+					upper.append( std::move( m_entries[i] ) );
+				}
+
+				m_entries.erase( m_entries.begin() + half, m_entries.end() );
+			}
+
+
+		private :
+
+			IndexType										m_indices[CAPACITY];
+
+			boost::container::static_vector<T, CAPACITY>	m_entries;
+		};
+
+	}	//	namespace SortedSparse
+
+
+
+
+	template<class T, long CUTOVER_SIZE, class IndexType = typename SparseVectorIndexType<T>::type, size_t CHUNK_SIZE = 64>
+	class SortedSparseVector : boost::noncopyable
+	{
+	private :
+
+		typedef SortedSparse::SortedRun<T, IndexType, CUTOVER_SIZE>		InlineRun;
+		typedef SortedSparse::SortedRun<T, IndexType, CHUNK_SIZE>		Chunk;
+
+	public :
+
+		typedef IndexType		index_type;
+
+
+		template<class Owner, class Value>
+		class basic_iterator : public boost::iterator_facade<basic_iterator<Owner, Value>, Value*, boost::forward_traversal_tag, Value*>
+		{
+		public :
+
+			//	Index of the current entry
+
+			IndexType		index() const
+			{
+				if( !m_owner->m_cutover )
+				{
+					return( m_owner->m_inline.indexAt( m_position ) );
+				}
+
+				return( m_owner->m_chunks[m_chunk]->indexAt( m_position ) );
+			}
+
+
+			//	Moves forward to the first entry with an index at or past the target, or to end().
+
+			void			advance_to( IndexType		target )
+			{
+				if( !m_owner->m_cutover )
+				{
+					m_position = SortedSparse::gallop( m_owner->m_inline.indices(), m_position, m_owner->m_inline.size(), target );
+					return;
+				}
+
+				while( m_chunk < m_owner->m_chunks.size() )
+				{
+					const Chunk&	chunk = *m_owner->m_chunks[m_chunk];
+
+					if( chunk.indexAt( chunk.size() - 1 ) >= target )
+					{
+						m_position = SortedSparse::gallop( chunk.indices(), m_position, chunk.size(), target );
+						return;
+					}
+
+					//	The target lies beyond this chunk, gallop through the directory for the first chunk starting at or
+					//		after the target.  The target may still be inside the chunk just before that one.
+
+					size_t		next = SortedSparse::gallop( m_owner->m_chunkFirst.data(), m_chunk + 1, m_owner->m_chunks.size(), target );
+
+					m_position = 0;
+
+					if( next - 1 > m_chunk )
+					{
+						m_chunk = next - 1;
+					}
+					else
+					{
+						m_chunk = next;
+						return;
+					}
+				}
+			}
+
+
+		private :
+
+			friend class SortedSparseVector;
+			friend class boost::iterator_core_access;
+
+
+			basic_iterator( Owner*		owner,
+							size_t		chunk,
+							size_t		position )
+				: m_owner( owner ),
+				  m_chunk( chunk ),
+				  m_position( position )
+			{}
+
+
+			void		increment()
+			{
+				m_position++;
+
+				if( m_owner->m_cutover && ( m_position == m_owner->m_chunks[m_chunk]->size() ))
+				{
+					m_chunk++;
+					m_position = 0;
+				}
+			}
+
+			bool		equal( const basic_iterator&		other ) const
+			{
+				return(( m_chunk == other.m_chunk ) && ( m_position == other.m_position ));
+			}
+
+			Value*		dereference() const
+			{
+				if( !m_owner->m_cutover )
+				{
+					return( &m_owner->m_inline.entryAt( m_position ) );
+				}
+
+				return( &m_owner->m_chunks[m_chunk]->entryAt( m_position ) );
+			}
+
+
+			Owner*		m_owner;
+			size_t		m_chunk;
+			size_t		m_position;
+		};
+
+		typedef basic_iterator<SortedSparseVector, T>					iterator;
+		typedef basic_iterator<const SortedSparseVector, const T>		const_iterator;
+
+
+
+		SortedSparseVector()
+			: m_cutover( false ),
+			  m_size( 0 )
+		{}
+
+		SortedSparseVector( SortedSparseVector&&		vectorToMove )
+			: m_cutover( vectorToMove.m_cutover ),
+			  m_size( vectorToMove.m_size ),
+			  m_inline( std::move( vectorToMove.m_inline ) ),
+			  m_chunks( std::move( vectorToMove.m_chunks ) ),
+			  m_chunkFirst( std::move( vectorToMove.m_chunkFirst ) )
+		{
+			vectorToMove.reset();
+		}
+
+		~SortedSparseVector()
+		{
+			releaseChunks();
+		}
+
+		SortedSparseVector&		operator=( SortedSparseVector&&		vectorToMove )
+		{
+			if( this != &vectorToMove )
+			{
+				releaseChunks();
+
+				m_cutover = vectorToMove.m_cutover;
+				m_size = vectorToMove.m_size;
+				m_inline = std::move( vectorToMove.m_inline );
+				m_chunks = std::move( vectorToMove.m_chunks );
+				m_chunkFirst = std::move( vectorToMove.m_chunkFirst );
+
+				vectorToMove.reset();
+			}
+
+			return( *this );
+		}
+
+
+
+		size_t				size() const
+		{
+			return( m_size );
+		}
+
+		bool				empty() const
+		{
+			return( m_size == 0 );
+		}
+
+
+		iterator			begin()
+		{
+			return( iterator( this, 0, 0 ) );
+		}
+
+		const_iterator		begin() const
+		{
+			return( const_iterator( this, 0, 0 ) );
+		}
+
+		iterator			end()
+		{
+			return( m_cutover ? iterator( this, m_chunks.size(), 0 ) : iterator( this, 0, m_inline.size() ) );
+		}
+
+		const_iterator		end() const
+		{
+			return( m_cutover ? const_iterator( this, m_chunks.size(), 0 ) : const_iterator( this, 0, m_inline.size() ) );
+		}
+
+
+
+		T*					find( IndexType		index )
+		{
+			if( !m_cutover )
+			{
+				size_t		position = m_inline.lowerBound( index );
+
+				return(( position < m_inline.size() ) && ( m_inline.indexAt( position ) == index ) ? &m_inline.entryAt( position ) : NULL );
+			}
+
+			Chunk&		chunk = *m_chunks[chunkFor( index )];
+			size_t		position = chunk.lowerBound( index );
+
+			return(( position < chunk.size() ) && ( chunk.indexAt( position ) == index ) ? &chunk.entryAt( position ) : NULL );
+		}
+
+		const T*			find( IndexType		index ) const
+		{
+			return( const_cast<SortedSparseVector*>( this )->find( index ) );
+		}
+
+		T&					operator[]( IndexType		index )
+		{
+			T*		entry = find( index );
+
+			//	If we did not find the entry there is no choice but assert
+
+			assert( entry != NULL );
+
+			return( *entry );
+		}
+
+
+		T&					find_or_add( IndexType		index )
+		{
+			if( !m_cutover )
+			{
+				size_t		position = m_inline.lowerBound( index );
+
+				if(( position < m_inline.size() ) && ( m_inline.indexAt( position ) == index ))
+				{
+					return( m_inline.entryAt( position ) );
+				}
+
+				if( !m_inline.full() )
+				{
+					m_size++;
+
+					return( m_inline.insertAt( position, index ) );
+				}
+
+				moveIntoChunks();
+			}
+
+			size_t		chunkNumber = chunkFor( index );
+			size_t		position = m_chunks[chunkNumber]->lowerBound( index );
+
+			if(( position < m_chunks[chunkNumber]->size() ) && ( m_chunks[chunkNumber]->indexAt( position ) == index ))
+			{
+				return( m_chunks[chunkNumber]->entryAt( position ) );
+			}
+
+			if( m_chunks[chunkNumber]->full() )
+			{
+				splitChunk( chunkNumber );
+
+				if( position > m_chunks[chunkNumber]->size() )
+				{
+					position -= m_chunks[chunkNumber]->size();
+					chunkNumber++;
+				}
+			}
+
+			m_size++;
+
+			T&		newEntry = m_chunks[chunkNumber]->insertAt( position, index );
+
+			m_chunkFirst[chunkNumber] = m_chunks[chunkNumber]->indexAt( 0 );
+
+			return( newEntry );
+		}
+
+
+		//	Appends an index larger than every index already present, the cheap way to build a vector in order.
+
+		T&					push_back_sorted( IndexType		index )
+		{
+			assert( empty() || ( index > lastIndex() ));
+
+			if( !m_cutover )
+			{
+				if( !m_inline.full() )
+				{
+					m_size++;
+
+					return( m_inline.append( index ) );
+				}
+
+				moveIntoChunks();
+			}
+
+			if( m_chunks.back()->full() )
+			{
+				m_chunks.push_back( new Chunk() );
+				m_chunkFirst.push_back( index );
+			}
+
+			m_size++;
+
+			return( m_chunks.back()->append( index ) );
+		}
+
+
+		void				erase( IndexType		index )
+		{
+			if( !m_cutover )
+			{
+				size_t		position = m_inline.lowerBound( index );
+
+				if(( position < m_inline.size() ) && ( m_inline.indexAt( position ) == index ))
+				{
+					m_inline.eraseAt( position );
+					m_size--;
+				}
+
+				return;
+			}
+
+			size_t		chunkNumber = chunkFor( index );
+			Chunk&		chunk = *m_chunks[chunkNumber];
+			size_t		position = chunk.lowerBound( index );
+
+			if(( position == chunk.size() ) || ( chunk.indexAt( position ) != index ))
+			{
+				return;
+			}
+
+			chunk.eraseAt( position );
+			m_size--;
+
+			if( chunk.empty() )
+			{
+				delete m_chunks[chunkNumber];
+
+				m_chunks.erase( m_chunks.begin() + chunkNumber );
+				m_chunkFirst.erase( m_chunkFirst.begin() + chunkNumber );
+			}
+			else
+			{
+				m_chunkFirst[chunkNumber] = chunk.indexAt( 0 );
+			}
+
+			//	Same hysteresis as SparseVector, go back inline only once well below the cutover size
+
+			if( m_size <= CUTOVER_SIZE / 2 )
+			{
+				moveIntoInline();
+			}
+		}
+
+
+
+		inline void			for_each( std::function<void( T &entry )> action )
+		{
+			if( !m_cutover )
+			{
+				for( size_t i = 0; i < m_inline.size(); i++ )
+				{
+					action( m_inline.entryAt( i ) );
+				}
+
+				return;
+			}
+
+			for( Chunk* chunk : m_chunks )
+			{
+				for( size_t i = 0; i < chunk->size(); i++ )
+				{
+					action( chunk->entryAt( i ) );
+				}
+			}
+		}
+
+		template<class Action>
+		inline void			for_each( Action&&		action )
+		{
+			for_each_chunk( [&action]( const IndexType*, T* entries, size_t count )
+			{
+				for( size_t i = 0; i < count; i++ )
+				{
+					action( entries[i] );
+				}
+			});
+		}
+
+
+		//	Each run already keeps its indices beside its entries, so every run is handed over as it stands
+		//		as visitor( const IndexType* indices, T* entries, size_t count ).
+
+		template<class Visitor>
+		void				for_each_chunk( Visitor&&		visitor )
+		{
+			if( !m_cutover )
+			{
+				if( !m_inline.empty() )
+				{
+					visitor( m_inline.indices(), &m_inline.entryAt( 0 ), m_inline.size() );
+				}
+
+				return;
+			}
+
+			for( Chunk* chunk : m_chunks )
+			{
+				visitor( chunk->indices(), &chunk->entryAt( 0 ), chunk->size() );
+			}
+		}
+
+
+	private :
+
+		bool						m_cutover;
+		size_t						m_size;
+
+		InlineRun					m_inline;
+
+		std::vector<Chunk*>			m_chunks;
+		std::vector<IndexType>		m_chunkFirst;
+
+
+		IndexType			lastIndex() const
+		{
+			if( !m_cutover )
+			{
+				return( m_inline.indexAt( m_inline.size() - 1 ) );
+			}
+
+			return( m_chunks.back()->indexAt( m_chunks.back()->size() - 1 ) );
+		}
+
+
+		//	The chunk that holds the index, or would hold it were it present
+
+		size_t				chunkFor( IndexType		index ) const
+		{
+			size_t		chunkNumber = std::upper_bound( m_chunkFirst.begin(), m_chunkFirst.end(), index ) - m_chunkFirst.begin();
+
+			return( chunkNumber == 0 ? 0 : chunkNumber - 1 );
+		}
+
+		void				splitChunk( size_t		chunkNumber )
+		{
+			Chunk*		upper = new Chunk();
+
+			m_chunks[chunkNumber]->moveUpperHalfTo( *upper );
+
+			m_chunks.insert( m_chunks.begin() + chunkNumber + 1, upper );
+			m_chunkFirst.insert( m_chunkFirst.begin() + chunkNumber + 1, upper->indexAt( 0 ) );
+		}
+
+
+		//	Chunks built from the inline array are left half full so the next insertions do not split them straight away
+
+		void				moveIntoChunks()
+		{
+			const size_t		fill = std::max( CHUNK_SIZE / 2, (size_t)1 );
+
+			m_chunks.push_back( new Chunk() );
+
+			for( size_t i = 0; i < m_inline.size(); i++ )
+			{
+				if( m_chunks.back()->size() == fill )
+				{
+					m_chunks.push_back( new Chunk() );
+				}
+
+				m_chunks.back()->append( std::move( m_inline.entryAt( i ) ) );
+			}
+
+			m_inline.clear();
+
+			for( Chunk* chunk : m_chunks )
+			{
+				m_chunkFirst.push_back( chunk->empty() ? IndexType() : chunk->indexAt( 0 ) );
+			}
+
+			m_cutover = true;
+		}
+
+		void				moveIntoInline()
+		{
+			for( Chunk* chunk : m_chunks )
+			{
+				for( size_t i = 0; i < chunk->size(); i++ )
+				{
+					m_inline.append( std::move( chunk->entryAt( i ) ) );
+				}
+			}
+
+			releaseChunks();
+
+			m_cutover = false;
+		}
+
+		void				releaseChunks()
+		{
+			for( Chunk* chunk : m_chunks )
+			{
+				delete chunk;
+			}
+
+			m_chunks.clear();
+			m_chunkFirst.clear();
+		}
+
+		void				reset()
+		{
+			m_inline.clear();
+			releaseChunks();
+
+			m_cutover = false;
+			m_size = 0;
+		}
+	};
+
+
+
+
+	//
+	//	Merge kernels.  They accept any pair of vectors whose iterators supply index() and advance_to(),
+	//		which today means SortedSparseVector, and visit entries in increasing index order.
+	//
+
+	namespace SortedSparse
+	{
+		template<class Visitor>
+		struct SwapArguments
+		{
+			Visitor&		m_visitor;
+
+			template<class A, class B>
+			void		operator()( A&		first,
+									B&		second ) const
+			{
+				m_visitor( second, first );
+			}
+		};
+
+
+		//	Walks the smaller vector and gallops through the larger one, or merges linearly when the sizes are close.
+
+		template<class SmallerVector, class LargerVector, class Visitor>
+		void		intersect( SmallerVector&		smaller,
+							   LargerVector&		larger,
+							   Visitor&				visit )
+		{
+			auto		itrSmaller = smaller.begin();
+			auto		itrLarger = larger.begin();
+
+			if( larger.size() > GALLOP_RATIO * smaller.size() )
+			{
+				for( ; itrSmaller != smaller.end(); ++itrSmaller )
+				{
+					itrLarger.advance_to( itrSmaller.index() );
+
+					if( itrLarger == larger.end() )
+					{
+						return;
+					}
+
+					if( itrLarger.index() == itrSmaller.index() )
+					{
+						visit( **itrSmaller, **itrLarger );
+					}
+				}
+
+				return;
+			}
+
+			while(( itrSmaller != smaller.end() ) && ( itrLarger != larger.end() ))
+			{
+				if( itrSmaller.index() < itrLarger.index() )
+				{
+					++itrSmaller;
+				}
+				else if( itrLarger.index() < itrSmaller.index() )
+				{
+					++itrLarger;
+				}
+				else
+				{
+					visit( **itrSmaller, **itrLarger );
+
+					++itrSmaller;
+					++itrLarger;
+				}
+			}
+		}
+
+	}	//	namespace SortedSparse
+
+
+
+	//	Calls visit( entryA, entryB ) for every index present in both vectors.
+
+	template<class VectorA, class VectorB, class Visitor>
+	void		sparse_intersection( VectorA&		a,
+									 VectorB&		b,
+									 Visitor		visit )
+	{
+		if( a.size() <= b.size() )
+		{
+			SortedSparse::intersect( a, b, visit );
+		}
+		else
+		{
+			SortedSparse::SwapArguments<Visitor>		swapped = { visit };
+
+			SortedSparse::intersect( b, a, swapped );
+		}
+	}
+
+
+	//	Calls visit( index, entryA, entryB ) for every index present in either vector, with NULL for the side that lacks it.
+
+	template<class VectorA, class VectorB, class Visitor>
+	void		sparse_union( VectorA&		a,
+							  VectorB&		b,
+							  Visitor		visit )
+	{
+		auto		itrA = a.begin();
+		auto		itrB = b.begin();
+
+		while(( itrA != a.end() ) || ( itrB != b.end() ))
+		{
+			if(( itrB == b.end() ) || (( itrA != a.end() ) && ( itrA.index() < itrB.index() )))
+			{
+				visit( itrA.index(), *itrA, NULL );
+				++itrA;
+			}
+			else if(( itrA == a.end() ) || ( itrB.index() < itrA.index() ))
+			{
+				visit( itrB.index(), NULL, *itrB );
+				++itrB;
+			}
+			else
+			{
+				visit( itrA.index(), *itrA, *itrB );
+				++itrA;
+				++itrB;
+			}
+		}
+	}
+
+
+	//	Sum of valueOf( a[i] ) * valueOf( b[i] ) over the indices the vectors share.
+
+	template<class VectorA, class VectorB, class ValueOf>
+	double		sparse_dot( const VectorA&		a,
+							const VectorB&		b,
+							ValueOf				valueOf )
+	{
+		double		sum = 0;
+
+		sparse_intersection( a, b, [&]( const typename std::remove_pointer<decltype( *a.begin() )>::type&		entryA,
+										 const typename std::remove_pointer<decltype( *b.begin() )>::type&		entryB )
+		{
+			sum += valueOf( entryA ) * valueOf( entryB );
+		} );
+
+		return( sum );
+	}
+
+
+	//	y += alpha * x, where value( entry ) returns a reference to the entry's numeric value.
+	//		A small x is added in place with a lookup per entry, otherwise y is rebuilt by a single merge.
+
+	template<class VectorX, class T, long CUTOVER_SIZE, class IndexType, size_t CHUNK_SIZE, class Value>
+	void		sparse_axpy( double															alpha,
+							 VectorX&														x,
+							 SortedSparseVector<T, CUTOVER_SIZE, IndexType, CHUNK_SIZE>&		y,
+							 Value															value )
+	{
+		typedef SortedSparseVector<T, CUTOVER_SIZE, IndexType, CHUNK_SIZE>		VectorY;
+
+		if( y.size() > SortedSparse::GALLOP_RATIO * x.size() )
+		{
+			for( auto itrX = x.begin(); itrX != x.end(); ++itrX )
+			{
+				value( y.find_or_add( itrX.index() ) ) += alpha * value( **itrX );
+			}
+
+			return;
+		}
+
+		VectorY		result;
+
+		sparse_union( x, y, [&]( IndexType		index,
+								 typename std::remove_pointer<decltype( *x.begin() )>::type*		entryX,
+								 T*																	entryY )
+		{
+			T&		entry = result.push_back_sorted( index );
+
+			if( entryY != NULL )
+			{
+				entry = std::move( *entryY );
+			}
+
+			if( entryX != NULL )
+			{
+				value( entry ) += alpha * value( *entryX );
+			}
+		} );
+
+		y = std::move( result );
+	}
+
+}	//	namespace SEFUtility
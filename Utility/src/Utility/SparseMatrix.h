@@ -0,0 +1,734 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#endif
+
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+
+
+
+//
+//	SparseMatrix holds a matrix in compressed sparse row form: a row offsets array with one element per
+//		row plus one, and the column indices and values of the non-zeros of each row, in column order,
+//		at positions [offsets[r], offsets[r+1]).  It is built from an array of SparseVector rows, or from
+//		any other rows that iterate pointers to entries with an index() method, using a caller supplied
+//		function to pull the value out of an entry.
+//
+//	The compressed sparse column form of a matrix is the compressed sparse row form of its transpose,
+//		so transpose() doubles as the CSR to CSC conversion.
+//
+//	The kernels run on TBB over ranges of rows.  The innermost loops are written with AVX2 intrinsics
+//		for double and float values when the compiler targets AVX2; the gathers treat 32 bit column
+//		indices as signed, so those matrices are limited to 2^31 columns.
+//
+//	SparseAccumulator is the dense scratch row used for the sparse by sparse product: it accumulates a
+//		row of the result in a dense array and remembers which columns were touched, so resetting it
+//		costs only as much as the row it produced.
+//
+
+
+namespace SEFUtility
+{
+	namespace SparseKernels
+	{
+		//	Sum of values[i] * x[columns[i]] over a row
+
+		template<class Value, class IndexType>
+		inline Value		gatherDot( const Value*			values,
+									   const IndexType*		columns,
+									   size_t				count,
+									   const Value*			x )
+		{
+			Value		sum = Value();
+
+			for( size_t i = 0; i < count; i++ )
+			{
+				sum += values[i] * x[columns[i]];
+			}
+
+			return( sum );
+		}
+
+		//	y[i] += alpha * x[i]
+
+		template<class Value>
+		inline void			axpy( Value				alpha,
+								  const Value*		x,
+								  Value*			y,
+								  size_t			count )
+		{
+			for( size_t i = 0; i < count; i++ )
+			{
+				y[i] += alpha * x[i];
+			}
+		}
+
+
+#if defined( __AVX2__ )
+
+		inline __m256d		multiplyAdd( __m256d		a,
+										 __m256d		b,
+										 __m256d		c )
+		{
+#if defined( __FMA__ )
+			return( _mm256_fmadd_pd( a, b, c ) );
+#else
+			return( _mm256_add_pd( _mm256_mul_pd( a, b ), c ) );
+#endif
+		}
+
+		inline __m256		multiplyAdd( __m256		a,
+										 __m256		b,
+										 __m256		c )
+		{
+#if defined( __FMA__ )
+			return( _mm256_fmadd_ps( a, b, c ) );
+#else
+			return( _mm256_add_ps( _mm256_mul_ps( a, b ), c ) );
+#endif
+		}
+
+		inline double		horizontalSum( __m256d		sums )
+		{
+			__m128d		pairs = _mm_add_pd( _mm256_castpd256_pd128( sums ), _mm256_extractf128_pd( sums, 1 ) );
+
+			return( _mm_cvtsd_f64( _mm_add_sd( pairs, _mm_unpackhi_pd( pairs, pairs ) ) ) );
+		}
+
+		inline float		horizontalSum( __m256		sums )
+		{
+			__m128		quads = _mm_add_ps( _mm256_castps256_ps128( sums ), _mm256_extractf128_ps( sums, 1 ) );
+			__m128		pairs = _mm_add_ps( quads, _mm_movehl_ps( quads, quads ) );
+
+			return( _mm_cvtss_f32( _mm_add_ss( pairs, _mm_shuffle_ps( pairs, pairs, 1 ) ) ) );
+		}
+
+
+		inline double		gatherDot( const double*		values,
+									   const uint32_t*		columns,
+									   size_t				count,
+									   const double*		x )
+		{
+			__m256d		sums = _mm256_setzero_pd();
+			size_t		i = 0;
+
+			for( ; i + 4 <= count; i += 4 )
+			{
+				__m256d		gathered = _mm256_i32gather_pd( x, _mm_loadu_si128( (const __m128i*)( columns + i ) ), sizeof( double ) );
+
+				sums = multiplyAdd( _mm256_loadu_pd( values + i ), gathered, sums );
+			}
+
+			double		sum = horizontalSum( sums );
+
+			for( ; i < count; i++ )
+			{
+				sum += values[i] * x[columns[i]];
+			}
+
+			return( sum );
+		}
+
+		inline double		gatherDot( const double*		values,
+									   const uint64_t*		columns,
+									   size_t				count,
+									   const double*		x )
+		{
+			__m256d		sums = _mm256_setzero_pd();
+			size_t		i = 0;
+
+			for( ; i + 4 <= count; i += 4 )
+			{
+				__m256d		gathered = _mm256_i64gather_pd( x, _mm256_loadu_si256( (const __m256i*)( columns + i ) ), sizeof( double ) );
+
+				sums = multiplyAdd( _mm256_loadu_pd( values + i ), gathered, sums );
+			}
+
+			double		sum = horizontalSum( sums );
+
+			for( ; i < count; i++ )
+			{
+				sum += values[i] * x[columns[i]];
+			}
+
+			return( sum );
+		}
+
+		inline float		gatherDot( const float*			values,
+									   const uint32_t*		columns,
+									   size_t				count,
+									   const float*			x )
+		{
+			__m256		sums = _mm256_setzero_ps();
+			size_t		i = 0;
+
+			for( ; i + 8 <= count; i += 8 )
+			{
+				__m256		gathered = _mm256_i32gather_ps( x, _mm256_loadu_si256( (const __m256i*)( columns + i ) ), sizeof( float ) );
+
+				sums = multiplyAdd( _mm256_loadu_ps( values + i ), gathered, sums );
+			}
+
+			float		sum = horizontalSum( sums );
+
+			for( ; i < count; i++ )
+			{
+				sum += values[i] * x[columns[i]];
+			}
+
+			return( sum );
+		}
+
+
+		inline void			axpy( double			alpha,
+								  const double*		x,
+								  double*			y,
+								  size_t			count )
+		{
+			__m256d		alphas = _mm256_set1_pd( alpha );
+			size_t		i = 0;
+
+			for( ; i + 4 <= count; i += 4 )
+			{
+				_mm256_storeu_pd( y + i, multiplyAdd( alphas, _mm256_loadu_pd( x + i ), _mm256_loadu_pd( y + i ) ) );
+			}
+
+			for( ; i < count; i++ )
+			{
+				y[i] += alpha * x[i];
+			}
+		}
+
+		inline void			axpy( float				alpha,
+								  const float*		x,
+								  float*			y,
+								  size_t			count )
+		{
+			__m256		alphas = _mm256_set1_ps( alpha );
+			size_t		i = 0;
+
+			for( ; i + 8 <= count; i += 8 )
+			{
+				_mm256_storeu_ps( y + i, multiplyAdd( alphas, _mm256_loadu_ps( x + i ), _mm256_loadu_ps( y + i ) ) );
+			}
+
+			for( ; i < count; i++ )
+			{
+				y[i] += alpha * x[i];
+			}
+		}
+
+#endif
+	}
+
+
+
+	template<class Value, class IndexType = uint32_t>
+	class SparseAccumulator
+	{
+	public :
+
+		explicit SparseAccumulator( size_t		width )
+			: m_values( width, Value() ),
+			  m_occupied( width, 0 )
+		{
+			m_touched.reserve( 64 );
+		}
+
+
+		size_t				width() const
+		{
+			return( m_values.size() );
+		}
+
+		size_t				size() const
+		{
+			return( m_touched.size() );
+		}
+
+		bool				empty() const
+		{
+			return( m_touched.empty() );
+		}
+
+		//	The columns touched since the last gather() or clear(), in the order they were first touched
+
+		const std::vector<IndexType>&		touched() const
+		{
+			return( m_touched );
+		}
+
+		Value				value( IndexType		index ) const
+		{
+			return( m_occupied[index] ? m_values[index] : Value() );
+		}
+
+
+		//	Marks the column touched without adding a value, for counting the entries of a row ahead of
+		//		accumulating it.  clear() resets the marks.
+
+		void				touch( IndexType		index )
+		{
+			if( !m_occupied[index] )
+			{
+				m_occupied[index] = 1;
+				m_touched.push_back( index );
+			}
+		}
+
+		void				accumulate( IndexType		index,
+										Value			value )
+		{
+			if( m_occupied[index] )
+			{
+				m_values[index] += value;
+				return;
+			}
+
+			m_occupied[index] = 1;
+			m_values[index] = value;
+			m_touched.push_back( index );
+		}
+
+
+		//	Writes the accumulated row out in ascending column order, resets the accumulator and returns
+		//		the number of entries written.  A row touching a large share of the columns is collected by
+		//		scanning the flags rather than by sorting.
+
+		size_t				gather( IndexType*		indices,
+									Value*			values )
+		{
+			size_t		count = m_touched.size();
+
+			if( count * 16 > m_values.size() )
+			{
+				size_t		written = 0;
+
+				for( size_t column = 0; written < count; column++ )
+				{
+					if( m_occupied[column] )
+					{
+						indices[written] = (IndexType)column;
+						values[written++] = m_values[column];
+
+						m_occupied[column] = 0;
+					}
+				}
+
+				m_touched.clear();
+
+				return( count );
+			}
+
+			std::sort( m_touched.begin(), m_touched.end() );
+
+			for( size_t i = 0; i < count; i++ )
+			{
+				indices[i] = m_touched[i];
+				values[i] = m_values[m_touched[i]];
+			}
+
+			clear();
+
+			return( count );
+		}
+
+		void				clear()
+		{
+			for( IndexType column : m_touched )
+			{
+				m_occupied[column] = 0;
+			}
+
+			m_touched.clear();
+		}
+
+
+	private :
+
+		std::vector<Value>				m_values;
+		std::vector<unsigned char>		m_occupied;
+		std::vector<IndexType>			m_touched;
+	};
+
+
+
+	template<class Value = double, class IndexType = uint32_t>
+	class SparseMatrix
+	{
+	public :
+
+		typedef Value			value_type;
+		typedef IndexType		index_type;
+
+		typedef SparseAccumulator<Value, IndexType>		Accumulator;
+
+
+		SparseMatrix()
+			: m_rows( 0 ),
+			  m_columns( 0 ),
+			  m_rowOffsets( 1, 0 )
+		{}
+
+		//	Takes over arrays already in compressed sparse row form, columns ascending within each row
+
+		SparseMatrix( size_t						rows,
+					  size_t						columns,
+					  std::vector<size_t>&&			rowOffsets,
+					  std::vector<IndexType>&&		columnIndices,
+					  std::vector<Value>&&			values )
+			: m_rows( rows ),
+			  m_columns( columns ),
+			  m_rowOffsets( std::move( rowOffsets ) ),
+			  m_columnIndices( std::move( columnIndices ) ),
+			  m_values( std::move( values ) )
+		{
+			assert( m_rowOffsets.size() == rows + 1 );
+			assert( m_columnIndices.size() == m_rowOffsets.back() );
+			assert( m_values.size() == m_rowOffsets.back() );
+		}
+
+
+		//	Builds the matrix from rows of entries, valueOf( const Entry& ) giving the value of each entry.
+		//		The row sizes are summed up front and then the rows are copied and sorted in parallel.
+
+		template<class RowIterator, class ValueOf>
+		static SparseMatrix		fromRows( RowIterator		firstRow,
+										  RowIterator		lastRow,
+										  size_t			columns,
+										  ValueOf			valueOf )
+		{
+			typedef typename std::iterator_traits<RowIterator>::value_type		RowType;
+
+			std::vector<const RowType*>		rows;
+			std::vector<size_t>				rowOffsets( 1, 0 );
+
+			for( RowIterator itrRow = firstRow; itrRow != lastRow; ++itrRow )
+			{
+				rows.push_back( &*itrRow );
+				rowOffsets.push_back( rowOffsets.back() + itrRow->size() );
+			}
+
+			std::vector<IndexType>		columnIndices( rowOffsets.back() );
+			std::vector<Value>			values( rowOffsets.back() );
+
+			tbb::parallel_for( tbb::blocked_range<size_t>( 0, rows.size() ), [&]( const tbb::blocked_range<size_t>&		range )
+			{
+				std::vector<std::pair<IndexType, Value>>		rowEntries;
+
+				for( size_t row = range.begin(); row != range.end(); row++ )
+				{
+					rowEntries.clear();
+
+					for( auto itrEntry = rows[row]->begin(); itrEntry != rows[row]->end(); ++itrEntry )
+					{
+						assert( (size_t)( *itrEntry )->index() < columns );
+
+						rowEntries.push_back( std::make_pair( (IndexType)( *itrEntry )->index(), (Value)valueOf( **itrEntry ) ) );
+					}
+
+					std::sort( rowEntries.begin(), rowEntries.end(), []( const std::pair<IndexType, Value>&		lhs,
+																		 const std::pair<IndexType, Value>&		rhs ) { return( lhs.first < rhs.first ); } );
+
+					size_t		position = rowOffsets[row];
+
+					for( const std::pair<IndexType, Value>& entry : rowEntries )
+					{
+						columnIndices[position] = entry.first;
+						values[position++] = entry.second;
+					}
+				}
+			});
+
+			return( SparseMatrix( rows.size(), columns, std::move( rowOffsets ), std::move( columnIndices ), std::move( values ) ) );
+		}
+
+
+
+		size_t				rows() const
+		{
+			return( m_rows );
+		}
+
+		size_t				columns() const
+		{
+			return( m_columns );
+		}
+
+		size_t				nonZeros() const
+		{
+			return( m_values.size() );
+		}
+
+		const size_t*		rowOffsets() const
+		{
+			return( m_rowOffsets.data() );
+		}
+
+		const IndexType*	columnIndices() const
+		{
+			return( m_columnIndices.data() );
+		}
+
+		const Value*		values() const
+		{
+			return( m_values.data() );
+		}
+
+
+
+		//	The rows are split into one band per worker.  Each band counts its entries per column, the counts
+		//		are laid end to end column by column, and then every band scatters its entries into its own
+		//		positions.  Bands are visited in row order within each column, so the result needs no sort.
+		//
+		//	Each band keeps a cursor per column, so the bands are limited to one per m_columns non-zeros and
+		//		the cursors never outgrow the matrix.  A matrix with more columns than non-zeros is
+		//		transposed in a single band, serially.
+
+		SparseMatrix		transpose() const
+		{
+			size_t		bands = std::min<size_t>( (size_t)tbb::this_task_arena::max_concurrency(), m_rows );
+
+			bands = std::max<size_t>( 1, std::min<size_t>( bands, nonZeros() / std::max<size_t>( 1, m_columns ) ) );
+
+			std::vector<size_t>		bandCursors( bands * m_columns, 0 );
+
+			tbb::parallel_for( (size_t)0, bands, [&]( size_t		band )
+			{
+				size_t*		cursors = bandCursors.data() + band * m_columns;
+
+				for( size_t row = bandStart( band, bands ); row < bandStart( band + 1, bands ); row++ )
+				{
+					for( size_t i = m_rowOffsets[row]; i < m_rowOffsets[row + 1]; i++ )
+					{
+						cursors[m_columnIndices[i]]++;
+					}
+				}
+			});
+
+			std::vector<size_t>		rowOffsets( m_columns + 1, 0 );
+			size_t					position = 0;
+
+			for( size_t column = 0; column < m_columns; column++ )
+			{
+				for( size_t band = 0; band < bands; band++ )
+				{
+					size_t		count = bandCursors[band * m_columns + column];
+
+					bandCursors[band * m_columns + column] = position;
+					position += count;
+				}
+
+				rowOffsets[column + 1] = position;
+			}
+
+			std::vector<IndexType>		columnIndices( position );
+			std::vector<Value>			values( position );
+
+			tbb::parallel_for( (size_t)0, bands, [&]( size_t		band )
+			{
+				size_t*		cursors = bandCursors.data() + band * m_columns;
+
+				for( size_t row = bandStart( band, bands ); row < bandStart( band + 1, bands ); row++ )
+				{
+					for( size_t i = m_rowOffsets[row]; i < m_rowOffsets[row + 1]; i++ )
+					{
+						size_t		target = cursors[m_columnIndices[i]]++;
+
+						columnIndices[target] = (IndexType)row;
+						values[target] = m_values[i];
+					}
+				}
+			});
+
+			return( SparseMatrix( m_columns, m_rows, std::move( rowOffsets ), std::move( columnIndices ), std::move( values ) ) );
+		}
+
+
+
+		//	y = A * x
+
+		void				multiply( const Value*		x,
+									  Value*			y ) const
+		{
+			tbb::parallel_for( tbb::blocked_range<size_t>( 0, m_rows, ROW_GRAIN ), [&]( const tbb::blocked_range<size_t>&		range )
+			{
+				for( size_t row = range.begin(); row != range.end(); row++ )
+				{
+					size_t		first = m_rowOffsets[row];
+
+					y[row] = SparseKernels::gatherDot( m_values.data() + first, m_columnIndices.data() + first, m_rowOffsets[row + 1] - first, x );
+				}
+			});
+		}
+
+
+		//	C = A * B for a dense B with width columns, B and C both row major.  Each non-zero a(r,j) adds
+		//		a(r,j) times row j of B into row r of C.
+
+		void				multiply_dense( const Value*	b,
+											size_t			width,
+											Value*			c ) const
+		{
+			tbb::parallel_for( tbb::blocked_range<size_t>( 0, m_rows, ROW_GRAIN ), [&]( const tbb::blocked_range<size_t>&		range )
+			{
+				for( size_t row = range.begin(); row != range.end(); row++ )
+				{
+					Value*		cRow = c + row * width;
+
+					std::fill( cRow, cRow + width, Value() );
+
+					for( size_t i = m_rowOffsets[row]; i < m_rowOffsets[row + 1]; i++ )
+					{
+						SparseKernels::axpy( m_values[i], b + (size_t)m_columnIndices[i] * width, cRow, width );
+					}
+				}
+			});
+		}
+
+
+		//	C = A * B for a sparse B, row by row through a per thread SparseAccumulator.  A symbolic first pass
+		//		only marks the columns each result row touches, to size the rows, so the numeric second pass
+		//		can write the rows straight into place.
+
+		SparseMatrix		multiply( const SparseMatrix&		other ) const
+		{
+			assert( m_columns == other.m_rows );
+
+			tbb::enumerable_thread_specific<Accumulator>		accumulators( Accumulator( other.m_columns ) );
+
+			std::vector<size_t>		rowOffsets( m_rows + 1, 0 );
+
+			tbb::parallel_for( tbb::blocked_range<size_t>( 0, m_rows, ROW_GRAIN ), [&]( const tbb::blocked_range<size_t>&		range )
+			{
+				Accumulator&	accumulator = accumulators.local();
+
+				for( size_t row = range.begin(); row != range.end(); row++ )
+				{
+					touchRow( row, other, accumulator );
+
+					rowOffsets[row + 1] = accumulator.size();
+
+					accumulator.clear();
+				}
+			});
+
+			for( size_t row = 0; row < m_rows; row++ )
+			{
+				rowOffsets[row + 1] += rowOffsets[row];
+			}
+
+			std::vector<IndexType>		columnIndices( rowOffsets.back() );
+			std::vector<Value>			values( rowOffsets.back() );
+
+			tbb::parallel_for( tbb::blocked_range<size_t>( 0, m_rows, ROW_GRAIN ), [&]( const tbb::blocked_range<size_t>&		range )
+			{
+				Accumulator&	accumulator = accumulators.local();
+
+				for( size_t row = range.begin(); row != range.end(); row++ )
+				{
+					accumulateRow( row, other, accumulator );
+
+					accumulator.gather( columnIndices.data() + rowOffsets[row], values.data() + rowOffsets[row] );
+				}
+			});
+
+			return( SparseMatrix( m_rows, other.m_columns, std::move( rowOffsets ), std::move( columnIndices ), std::move( values ) ) );
+		}
+
+
+	private :
+
+		//	Rows per task, enough that neighbouring tasks rarely write to the same cache line of the output
+
+		static const size_t		ROW_GRAIN = 256;
+
+
+		size_t						m_rows;
+		size_t						m_columns;
+
+		std::vector<size_t>			m_rowOffsets;
+		std::vector<IndexType>		m_columnIndices;
+		std::vector<Value>			m_values;
+
+
+		size_t				bandStart( size_t		band,
+									   size_t		bands ) const
+		{
+			return( band * m_rows / bands );
+		}
+
+		void				touchRow( size_t					row,
+									  const SparseMatrix&		other,
+									  Accumulator&				accumulator ) const
+		{
+			for( size_t i = m_rowOffsets[row]; i < m_rowOffsets[row + 1]; i++ )
+			{
+				size_t		otherRow = m_columnIndices[i];
+
+				for( size_t j = other.m_rowOffsets[otherRow]; j < other.m_rowOffsets[otherRow + 1]; j++ )
+				{
+					accumulator.touch( other.m_columnIndices[j] );
+				}
+			}
+		}
+
+		void				accumulateRow( size_t					row,
+										   const SparseMatrix&		other,
+										   Accumulator&				accumulator ) const
+		{
+			for( size_t i = m_rowOffsets[row]; i < m_rowOffsets[row + 1]; i++ )
+			{
+				size_t		otherRow = m_columnIndices[i];
+				Value		scale = m_values[i];
+
+				for( size_t j = other.m_rowOffsets[otherRow]; j < other.m_rowOffsets[otherRow + 1]; j++ )
+				{
+					accumulator.accumulate( other.m_columnIndices[j], scale * other.m_values[j] );
+				}
+			}
+		}
+	};
+
+}	//	namespace SEFUtility
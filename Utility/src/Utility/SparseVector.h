@@ -28,32 +28,53 @@ THE SOFTWARE.
 #pragma once
 
 
+#include <algorithm>
 #include <functional>
-#include <unordered_map>
+#include <limits>
 #include <set>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-#include <boost\integer\static_min_max.hpp>
 #include <boost\iterator\iterator_facade.hpp>
 #include <boost\container\static_vector.hpp>
 
 #include <tbb\concurrent_unordered_map.h>
 #include <tbb\concurrent_unordered_set.h>
+#include <tbb\blocked_range.h>
+#include <tbb\parallel_for.h>
+#include <tbb\parallel_reduce.h>
+
+#include "SIMDIndexSearch.h"
+#include "FlatIndexMap.h"
+#include "FlatPointerSet.h"
+#include "DenseIndexMap.h"
+#include "TieringStats.h"
 
 
 
 
 namespace SEFUtility
 {
-	class SparseVectorEntry
+	//
+	//	Base class for SparseVector entries.  The index type defaults to size_t, index spaces that fit in
+	//		32 bits can use BasicSparseVectorEntry<uint32_t> to halve the size of every stored index.
+	//
+
+	template<class IndexType = size_t>
+	class BasicSparseVectorEntry
 	{
 	public :
 
-		SparseVectorEntry( size_t		index )
+		typedef IndexType		index_type;
+
+
+		BasicSparseVectorEntry( IndexType		index )
 			: m_index( index )
 		{}
 
 
-		size_t		index() const
+		IndexType		index() const
 		{
 			return( m_index );
 		}
@@ -61,22 +82,113 @@ namespace SEFUtility
 
 	private :
 
-		size_t		m_index;
+		IndexType		m_index;
+	};
+
+
+	typedef BasicSparseVectorEntry<size_t>		SparseVectorEntry;
+
+
+	//	The index type of an entry class is whatever its index() method returns
+
+	template<class T>
+	struct SparseVectorIndexType
+	{
+		typedef typename std::decay<decltype( std::declval<const T&>().index() )>::type		type;
+	};
+
+
+
+	//
+	//	Tiering policies decide how many entries a SparseVector holds inline before cutting over to the
+	//		map, and how far the map has to shrink before the entries move back inline.  The gap between
+	//		the two keeps a vector that hovers around the cutover size from bouncing between tiers.
+	//
+	//	Past the cutover, indices that cluster so that at least DENSE_PERCENT of the range between the
+	//		smallest and largest index is occupied move to a bitmap indexed tier with no hashing at all.
+	//		They move back to the map once occupancy falls to half of that.  A DENSE_PERCENT of zero
+	//		turns the dense tier off.
+	//
+	//	FixedCutoverPolicy uses the CUTOVER_SIZE given to the SparseVector.  CacheLineCutoverPolicy sizes the
+	//		inline tier from sizeof(T) so the payloads and their indices fill a whole number of cache lines,
+	//		use it with AUTO_CUTOVER_SIZE in place of an explicit cutover size:
+	//
+	//			SparseVector<Entry, AUTO_CUTOVER_SIZE, CacheLineCutoverPolicy<2>>
+	//
+
+	const long		AUTO_CUTOVER_SIZE = 0;
+
+
+	template<unsigned int DEMOTE_PERCENT = 50, unsigned int DENSE_PERCENT = 50>
+	struct FixedCutoverPolicy
+	{
+		static const unsigned int		DEMOTE_PERCENTAGE = DEMOTE_PERCENT;
+		static const unsigned int		DENSE_PERCENTAGE = DENSE_PERCENT;
+
+		template<class T, long CUTOVER_SIZE, class IndexType = size_t>
+		struct InlineCapacity
+		{
+			static_assert( CUTOVER_SIZE > 0, "FixedCutoverPolicy requires an explicit cutover size" );
+
+			static const long		value = CUTOVER_SIZE;
+		};
 	};
 
 
+	template<unsigned int CACHE_LINES = 1, unsigned int DEMOTE_PERCENT = 50, unsigned int DENSE_PERCENT = 50>
+	struct CacheLineCutoverPolicy
+	{
+		static const unsigned int		DEMOTE_PERCENTAGE = DEMOTE_PERCENT;
+		static const unsigned int		DENSE_PERCENTAGE = DENSE_PERCENT;
+
+		static const size_t				CACHE_LINE_SIZE = 64;
+		static const size_t				MINIMUM_INLINE_ENTRIES = 4;
+
+		template<class T, long CUTOVER_SIZE, class IndexType = size_t>
+		struct InlineCapacity
+		{
+			static_assert( CUTOVER_SIZE == AUTO_CUTOVER_SIZE, "CacheLineCutoverPolicy picks the cutover size itself" );
+
+			static const size_t		BYTES_PER_ENTRY = sizeof( T ) + sizeof( IndexType );
+
+			//	Large entries get as many cache lines as it takes to hold the minimum number of entries
+
+			static const size_t		LINES_FOR_MINIMUM = ( MINIMUM_INLINE_ENTRIES * BYTES_PER_ENTRY + CACHE_LINE_SIZE - 1 ) / CACHE_LINE_SIZE;
+			static const size_t		LINES = LINES_FOR_MINIMUM > CACHE_LINES ? LINES_FOR_MINIMUM : CACHE_LINES;
 
-    template<class T,long CUTOVER_SIZE>
+			static const long		value = (long)( LINES * CACHE_LINE_SIZE / BYTES_PER_ENTRY );
+		};
+	};
+
+
+
+    template<class T,long CUTOVER_SIZE, class TieringPolicy = FixedCutoverPolicy<>, class IndexType = typename SparseVectorIndexType<T>::type>
 	class SparseVector
 	{
+	public :
+
+		typedef IndexType		index_type;
+
+		static const long		INLINE_CAPACITY = TieringPolicy::template InlineCapacity<T, CUTOVER_SIZE, IndexType>::value;
+		static const long		DEMOTION_SIZE = INLINE_CAPACITY * TieringPolicy::DEMOTE_PERCENTAGE / 100;
+
+		//	The storage currently holding the entries
+
+		enum class Tier : unsigned char { INLINE, MAP, DENSE };
+
 	private :
 
-		typedef boost::container::static_vector<T, CUTOVER_SIZE>								EntryVector;
-		typedef typename boost::container::static_vector<T, CUTOVER_SIZE>::iterator				EntryVectorIterator;
-		typedef typename boost::container::static_vector<T, CUTOVER_SIZE>::const_iterator		EntryVectorConstIterator;
+		typedef boost::container::static_vector<T, INLINE_CAPACITY>								EntryVector;
+		typedef typename EntryVector::iterator													EntryVectorIterator;
+		typedef typename EntryVector::const_iterator											EntryVectorConstIterator;
 
-		typedef std::unordered_map<size_t, T>													EntryMap;
+		typedef FlatIndexMap<T, IndexType, SparseVector>										EntryMap;
 		typedef typename EntryMap::iterator														EntryMapIterator;
+		typedef typename EntryMap::const_iterator												EntryMapConstIterator;
+
+		typedef DenseIndexMap<T, IndexType, SparseVector>										EntryDenseMap;
+		typedef typename EntryDenseMap::iterator												EntryDenseMapIterator;
+		typedef typename EntryDenseMap::const_iterator											EntryDenseMapConstIterator;
 
 	public :
 
@@ -89,15 +201,21 @@ namespace SEFUtility
 
 
 			iterator( const EntryVectorIterator&			vectorIterator )
-				: m_cutOver(false)
+				: m_tier( Tier::INLINE )
 			{
 				m_vectorIterator = vectorIterator;
 			}
 
-			iterator( const EntryMapIterator&		setIterator )
-				: m_cutOver(true)
+			iterator( const EntryMapIterator&		mapIterator )
+				: m_tier( Tier::MAP )
 			{
-				m_setIterator = setIterator;
+				m_mapIterator = mapIterator;
+			}
+
+			iterator( const EntryDenseMapIterator&		denseIterator )
+				: m_tier( Tier::DENSE )
+			{
+				m_denseIterator = denseIterator;
 			}
 
 
@@ -105,48 +223,61 @@ namespace SEFUtility
 
 			void increment()
 			{
-				if (m_cutOver)
-				{
-					m_setIterator++;
-				}
-				else
+				switch( m_tier )
 				{
-					m_vectorIterator++;
+					case Tier::INLINE :
+						m_vectorIterator++;
+						break;
+
+					case Tier::MAP :
+						m_mapIterator++;
+						break;
+
+					case Tier::DENSE :
+						m_denseIterator++;
+						break;
 				}
 			}
 
 			bool equal( iterator const& other ) const
 			{
-				if (m_cutOver)
-				{
-					return( m_setIterator == other.m_setIterator );
-				}
-				else
+				switch( m_tier )
 				{
-					return( m_vectorIterator == other.m_vectorIterator );
+					case Tier::MAP :
+						return( m_mapIterator == other.m_mapIterator );
+
+					case Tier::DENSE :
+						return( m_denseIterator == other.m_denseIterator );
+
+					default :
+						return( m_vectorIterator == other.m_vectorIterator );
 				}
 			}
 
 			T*		dereference() const
 			{
-				if (m_cutOver)
-				{
-					return( &(m_setIterator->second) );
-				}
-				else
+				switch( m_tier )
 				{
-					return( &*m_vectorIterator );
+					case Tier::MAP :
+						return( &*m_mapIterator );
+
+					case Tier::DENSE :
+						return( &*m_denseIterator );
+
+					default :
+						return( &*m_vectorIterator );
 				}
 			}
 
 
-			bool					m_cutOver;
+			Tier					m_tier;
 
 			EntryVectorIterator		m_vectorIterator;
-			EntryMapIterator		m_setIterator;
+			EntryMapIterator		m_mapIterator;
+			EntryDenseMapIterator	m_denseIterator;
 		};
 
-		class const_iterator : public boost::iterator_facade<const_iterator, T*, boost::forward_traversal_tag, const T*>
+		class const_iterator : public boost::iterator_facade<const_iterator, const T*, boost::forward_traversal_tag, const T*>
 		{
 
 		protected:
@@ -154,16 +285,22 @@ namespace SEFUtility
 			friend class SparseVector;
 
 
-			const_iterator( const EntryVectorIterator&			vectorIterator )
-				: m_cutOver(false)
+			const_iterator( const EntryVectorConstIterator&			vectorIterator )
+				: m_tier( Tier::INLINE )
 			{
 				m_vectorIterator = vectorIterator;
 			}
 
-			const_iterator( const EntryMapIterator&		setIterator )
-				: m_cutOver(true)
+			const_iterator( const EntryMapConstIterator&		mapIterator )
+				: m_tier( Tier::MAP )
 			{
-				m_setIterator = setIterator;
+				m_mapIterator = mapIterator;
+			}
+
+			const_iterator( const EntryDenseMapConstIterator&		denseIterator )
+				: m_tier( Tier::DENSE )
+			{
+				m_denseIterator = denseIterator;
 			}
 
 
@@ -171,54 +308,73 @@ namespace SEFUtility
 
 			void increment()
 			{
-				if (m_cutOver)
+				switch( m_tier )
 				{
-					m_setIterator++;
-				}
-				else
-				{
-					m_vectorIterator++;
+					case Tier::INLINE :
+						m_vectorIterator++;
+						break;
+
+					case Tier::MAP :
+						m_mapIterator++;
+						break;
+
+					case Tier::DENSE :
+						m_denseIterator++;
+						break;
 				}
 			}
 
-			bool equal( iterator const& other ) const
+			bool equal( const_iterator const& other ) const
 			{
-				if (m_cutOver)
-				{
-					return( m_setIterator == other.m_setIterator );
-				}
-				else
+				switch( m_tier )
 				{
-					return( m_vectorIterator == other.m_vectorIterator );
+					case Tier::MAP :
+						return( m_mapIterator == other.m_mapIterator );
+
+					case Tier::DENSE :
+						return( m_denseIterator == other.m_denseIterator );
+
+					default :
+						return( m_vectorIterator == other.m_vectorIterator );
 				}
 			}
 
-			T*		dereference() const
+			const T*		dereference() const
 			{
-				if (m_cutOver)
+				switch( m_tier )
 				{
-					return( &(m_setIterator->second) );
-				}
-				else
-				{
-					return( m_vectorIterator );
+					case Tier::MAP :
+						return( &*m_mapIterator );
+
+					case Tier::DENSE :
+						return( &*m_denseIterator );
+
+					default :
+						return( &*m_vectorIterator );
 				}
 			}
 
 
-			bool					m_cutOver;
+			Tier							m_tier;
 
-			EntryVectorIterator		m_vectorIterator;
-			EntryMapIterator		m_setIterator;
+			EntryVectorConstIterator		m_vectorIterator;
+			EntryMapConstIterator			m_mapIterator;
+			EntryDenseMapConstIterator		m_denseIterator;
 		};
 
 
 
 		SparseVector()
-			: m_cutover( false ),
-			  m_inserter( &SparseVector<T,10>::insertIntoArray ),
-			  m_map( NULL )
-		{}
+			: m_tier( Tier::INLINE ),
+			  m_inserter( &SparseVector::insertIntoArray ),
+			  m_map( NULL ),
+			  m_denseMap( NULL ),
+			  m_boundsStale( false ),
+			  m_minIndex( 0 ),
+			  m_maxIndex( 0 )
+		{
+			SEFUTILITY_TIERING_STAT( tieringCounters().created() );
+		}
 
 		//	Need the copy constructor to keep the compiler quiet about being unable to copy fixed_vectors,
 		//		but we should never call it - thus the assert.
@@ -228,12 +384,28 @@ namespace SEFUtility
 			assert( false );
 		}
 
+		//	Moving hands over the map or dense tier as it stands and relocates the inline entries, the
+		//		source is left empty.
+
+		SparseVector( SparseVector&&		vectorToMove ) noexcept( std::is_nothrow_move_constructible<T>::value )
+			: SparseVector()
+		{
+			takeFrom( vectorToMove );
+		}
+
 		~SparseVector()
 		{
+			SEFUTILITY_TIERING_STAT( tieringCounters().destroyed( (size_t)m_tier ) );
+
 			if( m_map != NULL )
 			{
 				delete m_map;
 			}
+
+			if( m_denseMap != NULL )
+			{
+				delete m_denseMap;
+			}
 		}
 
 		//	Need the assignment operator to keep the compiler quiet about being unable to copy fixed_vectors,
@@ -244,232 +416,912 @@ namespace SEFUtility
 			assert( false );
 		}
 
-
-		unsigned int			size() const
+		SparseVector&			operator=( SparseVector&&		vectorToMove ) noexcept( std::is_nothrow_move_constructible<T>::value )
 		{
-			if( !m_cutover )
+			if( this != &vectorToMove )
 			{
-				return( m_arraySize );
+				clear();
+				takeFrom( vectorToMove );
 			}
 
-			return( m_map->size() );
+			return( *this );
 		}
 
-		bool					empty() const
+
+		Tier					tier() const
 		{
-			if( !m_cutover )
+			return( m_tier );
+		}
+
+		unsigned int			size() const
+		{
+			switch( m_tier )
 			{
-				return( m_arraySize == 0 );
+				case Tier::MAP :
+					return( m_map->size() );
+
+				case Tier::DENSE :
+					return( m_denseMap->size() );
+
+				default :
+					return( m_array.size() );
 			}
+		}
 
-			return( m_map->empty() );
+		bool					empty() const
+		{
+			return( size() == 0 );
 		}
 
 		
 		iterator			begin()
 		{
-			if( !m_cutover )
+			switch( m_tier )
 			{
-				return( iterator( m_array.begin() ) );
-			}
+				case Tier::MAP :
+					return( iterator( m_map->begin() ) );
 
-			return( iterator( m_map->begin() ) );
+				case Tier::DENSE :
+					return( iterator( m_denseMap->begin() ) );
+
+				default :
+					return( iterator( m_array.begin() ) );
+			}
 		}
 
 		const_iterator			begin() const
 		{
-			if (!m_cutover)
+			switch( m_tier )
 			{
-				return( const_iterator( m_array.begin() ) );
-			}
+				case Tier::MAP :
+					return( const_iterator( ((const EntryMap*)m_map)->begin() ) );
 
-			return( const_iterator( m_map->begin() ) );
+				case Tier::DENSE :
+					return( const_iterator( ((const EntryDenseMap*)m_denseMap)->begin() ) );
+
+				default :
+					return( const_iterator( m_array.begin() ) );
+			}
 		}
 
 		iterator			end()
 		{
-			if (!m_cutover)
+			switch( m_tier )
 			{
-				return( iterator( m_array.end() ) );
+				case Tier::MAP :
+					return( iterator( m_map->end() ) );
+
+				case Tier::DENSE :
+					return( iterator( m_denseMap->end() ) );
+
+				default :
+					return( iterator( m_array.end() ) );
 			}
+		}
 
-			return( iterator( m_map->end() ) );
+		const_iterator			end() const
+		{
+			switch( m_tier )
+			{
+				case Tier::MAP :
+					return( const_iterator( ((const EntryMap*)m_map)->end() ) );
+
+				case Tier::DENSE :
+					return( const_iterator( ((const EntryDenseMap*)m_denseMap)->end() ) );
+
+				default :
+					return( const_iterator( m_array.end() ) );
+			}
+		}
+
+
+
+		T&		operator[]( IndexType		index )
+		{
+			T*		entry = find( index );
+
+			//	If we did not find the entry there is no choice but assert
+
+			assert( entry != NULL );
+
+			return( *entry );
+		}
+
+
+		T*			find( IndexType		index )
+		{
+			switch( m_tier )
+			{
+				case Tier::MAP :
+					return( m_map->find( index ) );
+
+				case Tier::DENSE :
+					return( m_denseMap->find( index ) );
+
+				default :
+				{
+					int		position = findInArray( index );
+
+					return( position >= 0 ? &m_array[position] : NULL );
+				}
+			}
+		}
+
+
+
+		T&			find_or_add( IndexType		index )
+		{
+			T*		entry = find( index );
+
+			if( entry != NULL )
+			{
+				return( *entry );
+			}
+
+			return((this->*m_inserter)( index ));
+		}
+
+
+
+		void			erase( IndexType		index )
+		{
+			switch( m_tier )
+			{
+				case Tier::INLINE :
+				{
+					int		position = findInArray( index );
+
+					if( position >= 0 )
+					{
+						//	Move the last entry into the hole so both arrays stay dense
+
+						size_t		last = m_array.size() - 1;
+
+						if( (size_t)position < last )
+						{
+							m_array[position] = std::move( m_array[last] );
+							m_indices[position] = m_indices[last];
+						}
+
+						m_array.pop_back();
+					}
+				}
+				break;
+
+				//	Only an erasure that removed an entry can demote, so erasing an absent index does not undo reserve()
+				//		or from_sorted_range() choosing the map or dense tier for a vector that is not yet full.
+
+				case Tier::MAP :
+					if( !m_map->erase( index ) )
+					{
+						break;
+					}
+
+					noteErased( index );
+
+					if( m_map->size() <= DEMOTION_SIZE )
+					{
+						moveIntoArray( *m_map );
+					}
+					break;
+
+				case Tier::DENSE :
+					if( !m_denseMap->erase( index ) )
+					{
+						break;
+					}
+
+					noteErased( index );
+
+					if( m_denseMap->size() <= DEMOTION_SIZE )
+					{
+						moveIntoArray( *m_denseMap );
+						break;
+					}
+
+					refreshBounds();
+
+					if( !denseEnough( m_denseMap->size() * 2, rangeOf( m_minIndex, m_maxIndex ) ) )
+					{
+						//	Occupancy has fallen to half the promotion threshold, hashing is cheaper again
+
+						moveDenseIntoMap();
+					}
+					break;
+			}
+		}
+
+
+
+		void			clear()
+		{
+			delete m_map;
+			m_map = NULL;
+
+			delete m_denseMap;
+			m_denseMap = NULL;
+
+			m_array.clear();
+
+			SEFUTILITY_TIERING_STAT( tieringCounters().relocated( (size_t)m_tier, TIERING_TIER_INLINE ) );
+
+			m_tier = Tier::INLINE;
+			m_inserter = &SparseVector::insertIntoArray;
+		}
+
+
+		//	Sizes the hash table for the given number of entries so filling it does not rehash along the way.
+		//		An inline vector that will not fit cuts over to an empty table of that size straight away.
+		//		The dense tier is sized by the spread of the indices rather than their number, so is left as is.
+
+		void			reserve( size_t		entries )
+		{
+			switch( m_tier )
+			{
+				case Tier::INLINE :
+					if( entries > INLINE_CAPACITY )
+					{
+						moveArrayIntoMap( entries );
+					}
+					break;
+
+				case Tier::MAP :
+					m_map->reserve( entries );
+					break;
+
+				default :
+					break;
+			}
+		}
+
+
+		//	Builds a vector from entries already sorted by index, moving them in.  The tier is chosen up front
+		//		from the number of entries and the span of their indices, and the storage is sized once, so
+		//		there is no cutover, rehashing or window growth along the way and no lookups.
+
+		template<class Iterator>
+		static SparseVector		from_sorted_range( Iterator		first,
+												   Iterator		last )
+		{
+			SparseVector		vector;
+
+			size_t		count = std::distance( first, last );
+
+			if( count == 0 )
+			{
+				return( vector );
+			}
+
+			if( count <= INLINE_CAPACITY )
+			{
+				for( ; first != last; ++first )
+				{
+					vector.m_indices[vector.m_array.size()] = first->index();
+					vector.m_array.push_back( std::move( *first ) );
+				}
+
+				return( vector );
+			}
+
+			Iterator		lastEntry = first;
+
+			std::advance( lastEntry, count - 1 );
+
+			vector.m_minIndex = first->index();
+			vector.m_maxIndex = lastEntry->index();
+
+			if( denseEnough( count, rangeOf( vector.m_minIndex, vector.m_maxIndex ) ) )
+			{
+				vector.m_denseMap = new EntryDenseMap( vector.m_minIndex, vector.m_maxIndex );
+
+				for( ; first != last; ++first )
+				{
+					vector.m_denseMap->insert_unique( std::move( *first ) );
+				}
+
+				SEFUTILITY_TIERING_STAT( tieringCounters().changedTier( TIERING_TIER_INLINE, TIERING_TIER_DENSE, count ) );
+
+				vector.m_tier = Tier::DENSE;
+				vector.m_inserter = &SparseVector::insertIntoDense;
+
+				return( vector );
+			}
+
+			vector.m_map = new EntryMap( count );
+
+			for( ; first != last; ++first )
+			{
+				vector.m_map->insert_unique( std::move( *first ) );
+			}
+
+			SEFUTILITY_TIERING_STAT( tieringCounters().changedTier( TIERING_TIER_INLINE, TIERING_TIER_MAP, count ) );
+
+			vector.m_tier = Tier::MAP;
+			vector.m_inserter = &SparseVector::insertIntoMap;
+
+			return( vector );
+		}
+
+
+
+		//	Batched forms of find(), find_or_add() and erase() for callers with many indices to resolve at once.
+		//		In the map tier the whole batch is hashed and the buckets prefetched before any is probed.
+		//		find_many() returns the number of indices found and leaves NULL in results for the others.
+
+		size_t			find_many( const IndexType*		indices,
+								   size_t				count,
+								   T**					results )
+		{
+			if( m_tier == Tier::MAP )
+			{
+				return( m_map->find_many( indices, count, results ) );
+			}
+
+			size_t		found = 0;
+
+			for( size_t i = 0; i < count; i++ )
+			{
+				results[i] = find( indices[i] );
+				found += ( results[i] != NULL );
+			}
+
+			return( found );
+		}
+
+
+		//	Every pointer in results is valid when the call returns, until the next insertion or erasure.
+
+		void			find_or_add_many( const IndexType*		indices,
+										  size_t				count,
+										  T**					results )
+		{
+			if( m_tier == Tier::MAP )
+			{
+				refreshBounds();
+
+				IndexType		minIndex = m_minIndex;
+				IndexType		maxIndex = m_maxIndex;
+
+				for( size_t i = 0; i < count; i++ )
+				{
+					minIndex = std::min( minIndex, indices[i] );
+					maxIndex = std::max( maxIndex, indices[i] );
+				}
+
+				//	If the batch cannot make the map dense enough for the bitmap tier, it can go in all at once
+
+				if( !denseEnough( m_map->size() + count, rangeOf( minIndex, maxIndex ) ) )
+				{
+					m_minIndex = minIndex;
+					m_maxIndex = maxIndex;
+
+					m_map->find_or_add_many( indices, count, results );
+					return;
+				}
+			}
+
+			//	Adding the entries one at a time may move them between tiers, so the pointers are only
+			//		collected once they are all in.
+
+			for( size_t i = 0; i < count; i++ )
+			{
+				find_or_add( indices[i] );
+			}
+
+			find_many( indices, count, results );
 		}
 
-		const_iterator			end() const
-		{
-			if (!m_cutover)
+
+		//	Returns the number of entries erased.  In the map tier the move back inline waits for the end of the batch.
+
+		size_t			erase_many( const IndexType*		indices,
+									size_t				count )
+		{
+			if( m_tier == Tier::MAP )
+			{
+				size_t		erased = m_map->erase_many( indices, count );
+
+				if( erased > 0 )
+				{
+					m_boundsStale = true;
+
+					if( m_map->size() <= DEMOTION_SIZE )
+					{
+						moveIntoArray( *m_map );
+					}
+				}
+
+				return( erased );
+			}
+
+			size_t		sizeBefore = size();
+
+			for( size_t i = 0; i < count; i++ )
+			{
+				erase( indices[i] );
+			}
+
+			return( sizeBefore - size() );
+		}
+
+
+
+
+		inline void for_each( std::function<void( T &entry )> action )
+		{
+			switch( m_tier )
+			{
+				case Tier::MAP :
+					m_map->for_each( action );
+					break;
+
+				case Tier::DENSE :
+					m_denseMap->for_each( action );
+					break;
+
+				default :
+					for( unsigned int i = 0; i < m_array.size(); i++ )
+					{
+						action( m_array[i] );
+					}
+					break;
+			}
+		}
+
+		//	Takes any callable directly, so the action can be inlined into the loop instead of being called
+		//		through std::function.
+
+		template<class Action>
+		inline void for_each( Action&&		action )
+		{
+			switch( m_tier )
+			{
+				case Tier::MAP :
+					m_map->for_each( action );
+					break;
+
+				case Tier::DENSE :
+					m_denseMap->for_each( action );
+					break;
+
+				default :
+					for( size_t i = 0; i < m_array.size(); i++ )
+					{
+						action( m_array[i] );
+					}
+					break;
+			}
+		}
+
+
+		//	Visits the entries a contiguous run at a time as visitor( const IndexType* indices, T* entries, size_t count ),
+		//		where indices[i] is the index of entries[i], so the loop over a run can be vectorized.  Inline the
+		//		whole vector is a single run; in the map and dense tiers runs end at an empty slot or after 64 entries.
+
+		template<class Visitor>
+		void			for_each_chunk( Visitor&&		visitor )
+		{
+			switch( m_tier )
+			{
+				case Tier::MAP :
+					m_map->for_each_chunk( visitor );
+					break;
+
+				case Tier::DENSE :
+					m_denseMap->for_each_chunk( visitor );
+					break;
+
+				default :
+					if( !m_array.empty() )
+					{
+						visitor( (const IndexType*)m_indices, m_array.data(), m_array.size() );
+					}
+					break;
+			}
+		}
+
+
+
+		//	Parallel forms of for_each() and of a map/reduce over the entries, run on TBB.  The map and dense
+		//		tiers are split into ranges of whole PARALLEL_BLOCK_SLOTS slot blocks; the slot arrays start on a
+		//		cache line and a block is always a whole number of cache lines, so no two workers write to the
+		//		same line.  The inline tier is a few cache lines at most and is processed on the calling thread.
+		//
+		//	The action is called concurrently from several threads.  parallel_reduce() folds transform( entry )
+		//		into identity with combine(), which must be associative; the order of the combinations is not fixed.
+
+		template<class Action>
+		void			parallel_for_each( Action&&		action )
+		{
+			switch( m_tier )
+			{
+				case Tier::MAP :
+					parallelForEachInSlots( *m_map, m_map->capacity(), action );
+					break;
+
+				case Tier::DENSE :
+					parallelForEachInSlots( *m_denseMap, m_denseMap->span(), action );
+					break;
+
+				default :
+					for_each( action );
+					break;
+			}
+		}
+
+		template<class Value, class Transform, class Combine>
+		Value			parallel_reduce( const Value&		identity,
+										 Transform			transform,
+										 Combine			combine )
+		{
+			switch( m_tier )
+			{
+				case Tier::MAP :
+					return( parallelReduceInSlots( *m_map, m_map->capacity(), identity, transform, combine ) );
+
+				case Tier::DENSE :
+					return( parallelReduceInSlots( *m_denseMap, m_denseMap->span(), identity, transform, combine ) );
+
+				default :
+				{
+					Value		result = identity;
+
+					for( size_t i = 0; i < m_array.size(); i++ )
+					{
+						result = combine( result, transform( m_array[i] ) );
+					}
+
+					return( result );
+				}
+			}
+		}
+
+
+		void		elements( std::vector<T*>&		elementVector )
+		{
+			for( iterator itrEntry = begin(); itrEntry != end(); itrEntry++ )
+			{
+				elementVector.push_back( *itrEntry );
+			}
+		}
+
+
+	private :
+
+		typedef T& (SparseVector::*InsertFunctionPointer)( IndexType );
+
+
+		Tier						m_tier;
+		InsertFunctionPointer		m_inserter;
+
+		//	The indices of the inline entries are kept in their own array, parallel to m_array, so the
+		//		probe in findInArray() touches a single dense run of keys rather than every payload.
+		//		The SIMD search uses unaligned loads, so the array carries no alignment of its own.
+
+		IndexType					m_indices[INLINE_CAPACITY];
+
+		EntryVector					m_array;
+
+		EntryMap*					m_map;
+		EntryDenseMap*				m_denseMap;
+
+		//	Bounds of the indices held since leaving the inline tier.  Erasing an index at either bound only
+		//		marks them stale, and they are recomputed from the entries at the next tiering check, so an
+		//		erased outlier does not keep the vector out of the dense tier.
+
+		bool						m_boundsStale;
+
+		IndexType					m_minIndex;
+		IndexType					m_maxIndex;
+
+
+		//	64 slots of any size are a whole number of cache lines, and a whole number of hash groups and bitmap words
+
+		static const size_t			PARALLEL_BLOCK_SLOTS = 64;
+
+
+		template<class Storage, class Action>
+		static void				parallelForEachInSlots( Storage&		storage,
+														size_t			slots,
+														Action&			action )
+		{
+			size_t		blocks = ( slots + PARALLEL_BLOCK_SLOTS - 1 ) / PARALLEL_BLOCK_SLOTS;
+
+			tbb::parallel_for( tbb::blocked_range<size_t>( 0, blocks ), [&]( const tbb::blocked_range<size_t>&		range )
+			{
+				size_t		last = range.end() * PARALLEL_BLOCK_SLOTS;
+
+				storage.for_each_in_slots( range.begin() * PARALLEL_BLOCK_SLOTS, std::min( last, slots ), action );
+			});
+		}
+
+		template<class Storage, class Value, class Transform, class Combine>
+		static Value			parallelReduceInSlots( Storage&				storage,
+													   size_t				slots,
+													   const Value&			identity,
+													   Transform&			transform,
+													   Combine&				combine )
+		{
+			size_t		blocks = ( slots + PARALLEL_BLOCK_SLOTS - 1 ) / PARALLEL_BLOCK_SLOTS;
+
+			auto		reduceRange = [&]( const tbb::blocked_range<size_t>&		range,
+										   Value								partial ) -> Value
+			{
+				size_t		last = range.end() * PARALLEL_BLOCK_SLOTS;
+
+				storage.for_each_in_slots( range.begin() * PARALLEL_BLOCK_SLOTS, std::min( last, slots ), [&]( T&		entry )
+				{
+					partial = combine( partial, transform( entry ) );
+				});
+
+				return( partial );
+			};
+
+			return( tbb::parallel_reduce( tbb::blocked_range<size_t>( 0, blocks ), identity, reduceRange, combine ) );
+		}
+
+
+		int						findInArray( IndexType		index ) const
+		{
+			return( SIMD::findIndex( m_indices, m_array.size(), index ) );
+		}
+
+#if defined( SEFUTILITY_TIERING_STATS )
+		static TieringCounters&	tieringCounters()
+		{
+			return( TieringStats::countersFor<SparseVector>() );
+		}
+#endif
+
+		static size_t			rangeOf( IndexType		minIndex,
+										 IndexType		maxIndex )
+		{
+			return( (size_t)( maxIndex - minIndex ) + 1 );
+		}
+
+		static bool				denseEnough( size_t		entries,
+											 size_t		span )
+		{
+			return(( TieringPolicy::DENSE_PERCENTAGE > 0 ) && ( entries * 100 >= span * TieringPolicy::DENSE_PERCENTAGE ));
+		}
+
+
+		void					takeFrom( SparseVector&		vectorToMove )
+		{
+			SEFUTILITY_TIERING_STAT( tieringCounters().relocated( (size_t)m_tier, (size_t)vectorToMove.m_tier ) );
+
+			m_tier = vectorToMove.m_tier;
+			m_inserter = vectorToMove.m_inserter;
+
+			m_array = std::move( vectorToMove.m_array );
+			std::copy( vectorToMove.m_indices, vectorToMove.m_indices + m_array.size(), m_indices );
+
+			m_map = vectorToMove.m_map;
+			m_denseMap = vectorToMove.m_denseMap;
+			m_boundsStale = vectorToMove.m_boundsStale;
+			m_minIndex = vectorToMove.m_minIndex;
+			m_maxIndex = vectorToMove.m_maxIndex;
+
+			vectorToMove.m_map = NULL;
+			vectorToMove.m_denseMap = NULL;
+			vectorToMove.clear();
+		}
+
+
+		T&						insertIntoArray( IndexType	index )
+		{
+			if( m_array.size() < INLINE_CAPACITY )
+			{
+				m_indices[m_array.size()] = index;
+				m_array.emplace_back( index );
+				
+				return( m_array.back() );
+			}
+
+			moveArrayIntoMap( INLINE_CAPACITY * 4 );
+
+			m_minIndex = std::min( m_minIndex, index );
+			m_maxIndex = std::max( m_maxIndex, index );
+
+			T&		newEntry = m_map->emplace_unique( index );
+
+			if( denseEnough( m_map->size(), rangeOf( m_minIndex, m_maxIndex ) ) )
 			{
-				return( const_iterator( m_array.end() ) );
+				return( *moveMapIntoDense( index ) );
 			}
 
-			return( const_iterator( m_map->end() ) );
+			return( newEntry );
 		}
 
+		T&						insertIntoMap( IndexType	index )
+		{
+			refreshBounds();
 
+			m_minIndex = std::min( m_minIndex, index );
+			m_maxIndex = std::max( m_maxIndex, index );
 
-		T&		operator[]( size_t		index )
-		{
-			if( !m_cutover )
+			//	A table cut over early by reserve() stays a table until it holds more than the inline capacity
+
+			if(( m_map->size() >= INLINE_CAPACITY ) && denseEnough( m_map->size() + 1, rangeOf( m_minIndex, m_maxIndex ) ))
 			{
-				for( unsigned int i = 0; i < m_array.size(); i++ )
-				{
-					if( m_array[i].index() == index )
-					{
-						return( m_array[i] );
-					}
-				}
+				m_map->emplace_unique( index );
 
-				//	We did not find the entry so there is no choice but assert	
-				
-				assert( false );
+				return( *moveMapIntoDense( index ) );
 			}
 
-			EntryMapIterator		itrEntry;
+			return( m_map->emplace_unique( index ) );
+		}
+
+		T&						insertIntoDense( IndexType	index )
+		{
+			refreshBounds();
 
-			itrEntry = m_map->find( index );
+			IndexType		minIndex = std::min( m_minIndex, index );
+			IndexType		maxIndex = std::max( m_maxIndex, index );
 
-			if( itrEntry == m_map->end() )
+			if( !denseEnough( m_denseMap->size() + 1, rangeOf( minIndex, maxIndex ) ) )
 			{
-				//	We did not find the entry so there is no choice but assert	
-				
-				assert( false );
+				moveDenseIntoMap();
+
+				return( insertIntoMap( index ) );
 			}
 
-			return( itrEntry->second );
-		}
+			m_minIndex = minIndex;
+			m_maxIndex = maxIndex;
 
+			return( m_denseMap->emplace_unique( index ) );
+		}
 
 
-		T&			find_or_add( size_t		index )
+		void					noteErased( IndexType		index )
 		{
-			if( !m_cutover )
+			if(( index == m_minIndex ) || ( index == m_maxIndex ))
 			{
-				for( unsigned int i = 0; i < m_array.size(); i++ )
-				{
-					if( m_array[i].index() == index )
-					{
-						return( m_array[i] );
-					}
-				}
+				m_boundsStale = true;
 			}
-			else
-			{
-				EntryMapIterator		itrEntry;
+		}
 
-				itrEntry = m_map->find( index );
+		//	Scans the map or dense tier for the true bounds, once per run of erasures that touched them.
 
-				if( itrEntry != m_map->end() )
-				{
-					return( itrEntry->second );
-				}
+		void					refreshBounds()
+		{
+			if( !m_boundsStale )
+			{
+				return;
 			}
 
-			return((this->*m_inserter)( index ));
-		}
-
+			m_boundsStale = false;
 
+			m_minIndex = std::numeric_limits<IndexType>::max();
+			m_maxIndex = 0;
 
-		void			erase( unsigned int		index )
-		{
-			if (!m_cutover)
+			if( m_tier == Tier::MAP )
 			{
-				for ( unsigned int i = 0; i < m_array.size(); i++ )
+				for( const T& entry : *m_map )
 				{
-					if ( m_array[i].index() == index)
-					{
-						if( i < m_arraySize - 1 )
-						{
-							m_array[i] = m_array[m_arraySize--];
-						}
-					}
+					m_minIndex = std::min( m_minIndex, entry.index() );
+					m_maxIndex = std::max( m_maxIndex, entry.index() );
 				}
 			}
 			else
 			{
-				itrEntry = m_map->erase( index );
+				for( const T& entry : *m_denseMap )
+				{
+					m_minIndex = std::min( m_minIndex, entry.index() );
+					m_maxIndex = std::max( m_maxIndex, entry.index() );
+				}
 			}
 		}
 
 
+		void					moveArrayIntoMap( size_t		capacity )
+		{
+			m_map = new EntryMap( std::max( capacity, (size_t)m_array.size() ) );
 
+			m_boundsStale = false;
 
-		inline void for_each( std::function<void( T &entry )> action )
-		{
-			if( !m_cutover )
-			{
-				for( unsigned int i = 0; i < m_array.size(); i++ )
-				{
-					action( m_array[i] );
-				}
-			}
-			else
+			m_minIndex = std::numeric_limits<IndexType>::max();
+			m_maxIndex = 0;
+
+			for( unsigned int i = 0; i < m_array.size(); i++ )
 			{
-				for( auto& currentEntry : *m_map )
-				{
-					action( currentEntry.second );
-				}
+				m_minIndex = std::min( m_minIndex, m_indices[i] );
+				m_maxIndex = std::max( m_maxIndex, m_indices[i] );
+
+				m_map->insert_unique( std::move( m_array[i] ) );
 			}
+
+			m_array.clear();
+
+			SEFUTILITY_TIERING_STAT( tieringCounters().changedTier( TIERING_TIER_INLINE, TIERING_TIER_MAP, m_map->size() ) );
+
+			m_tier = Tier::MAP;
+			m_inserter = &SparseVector::insertIntoMap;
 		}
 
 
-		void		elements( std::vector<T*>&		elementVector )
+		//	The map indices have clustered into a narrow range, so swap the hash table for the bitmap tier.
+		//		The bounds are recomputed first as erasures may have left them wider than the entries.
+
+		T*						moveMapIntoDense( IndexType	index )
 		{
-			if( !m_cutover )
+			m_boundsStale = false;
+
+			m_minIndex = index;
+			m_maxIndex = index;
+
+			for( const T& entry : *m_map )
 			{
-				for( unsigned int i = 0; i < m_array.size(); i++ )
-				{
-					elementVector.push_back( m_array + i );
-				}
+				m_minIndex = std::min( m_minIndex, entry.index() );
+				m_maxIndex = std::max( m_maxIndex, entry.index() );
 			}
-			else
+
+			m_denseMap = new EntryDenseMap( m_minIndex, m_maxIndex );
+
+			for( T& entry : *m_map )
 			{
-				for( auto& currentEntry : *m_map )
-				{
-					elementVector.push_back( &(currentEntry.second) );
-				}
+				m_denseMap->insert_unique( std::move( entry ) );
 			}
+
+			delete m_map;
+			m_map = NULL;
+
+			SEFUTILITY_TIERING_STAT( tieringCounters().changedTier( TIERING_TIER_MAP, TIERING_TIER_DENSE, m_denseMap->size() ) );
+
+			m_tier = Tier::DENSE;
+			m_inserter = &SparseVector::insertIntoDense;
+
+			return( m_denseMap->find( index ) );
 		}
 
+		void					moveDenseIntoMap()
+		{
+			m_map = new EntryMap( m_denseMap->size() * 2 );
+
+			m_boundsStale = false;
 
-	private :
+			m_minIndex = std::numeric_limits<IndexType>::max();
+			m_maxIndex = 0;
 
-		typedef T& (SparseVector<T,10>::*InsertFunctionPointer)( size_t );	
+			for( T& entry : *m_denseMap )
+			{
+				m_minIndex = std::min( m_minIndex, entry.index() );
+				m_maxIndex = std::max( m_maxIndex, entry.index() );
 
+				m_map->insert_unique( std::move( entry ) );
+			}
 
-		bool						m_cutover;
-		InsertFunctionPointer		m_inserter;
+			delete m_denseMap;
+			m_denseMap = NULL;
 
-		EntryVector					m_array;
+			SEFUTILITY_TIERING_STAT( tieringCounters().changedTier( TIERING_TIER_DENSE, TIERING_TIER_MAP, m_map->size() ) );
+
+			m_tier = Tier::MAP;
+			m_inserter = &SparseVector::insertIntoMap;
+		}
 
-		EntryMap*					m_map;
 
+		//	The vector has shrunk well below the cutover size, so move the entries back inline and release the other tier.
 
-		T&						insertIntoArray( size_t	index )
+		template<class Storage>
+		void					moveIntoArray( Storage&		entries )
 		{
-			if( m_array.size() < CUTOVER_SIZE )
+			for( T& entry : entries )
 			{
-				m_array.emplace_back( index );
-				
-				return( m_array.back() );
+				m_indices[m_array.size()] = entry.index();
+				m_array.push_back( std::move( entry ) );
 			}
 
-			m_map = new EntryMap( CUTOVER_SIZE * 4 );
-				
-			for( unsigned int i = 0; i < m_array.size(); i++ )
-			{
-				m_map->emplace( m_array[i].index(), m_array[i] );
-			}
+			delete m_map;
+			m_map = NULL;
 
-			m_cutover = true;
-			m_inserter = &SparseVector<T,CUTOVER_SIZE>::insertIntoMap;
+			delete m_denseMap;
+			m_denseMap = NULL;
 
-			return( m_map->emplace( index, index ).first->second );
-		}
+			SEFUTILITY_TIERING_STAT( tieringCounters().changedTier( (size_t)m_tier, TIERING_TIER_INLINE, m_array.size() ) );
 
-		T&						insertIntoMap( size_t	index )
-		{
-			return( m_map->emplace( index, index ).first->second );
+			m_tier = Tier::INLINE;
+			m_inserter = &SparseVector::insertIntoArray;
 		}
 
 	};
@@ -478,7 +1330,56 @@ namespace SEFUtility
 
 	
 
-	template<class T,long CUTOVER_SIZE>
+	//
+	//	SearchablePointerList keeps up to CUTOVER_SIZE pointers inline and then cuts over to a set.  The
+	//		overflow policy picks the set: HashedOverflowPolicy, the default, uses a FlatPointerSet and
+	//		iterates in no particular order, OrderedOverflowPolicy uses a std::set and iterates in
+	//		address order for callers that depend on it.
+	//
+	//	The inline pointers are searched with SIMD compares.  PointerListInlineAgainstSet in the benchmarks
+	//		has the scan ahead of the FlatPointerSet up to about 8 pointers, level with it at 16 and well
+	//		behind from 32, where the set's lookup stays flat.  The default cuts over at 16, four AVX2
+	//		compares over two cache lines, which also keeps the inline array small.
+	//
+
+	const long		DEFAULT_POINTER_LIST_CUTOVER_SIZE = 16;
+
+	struct HashedOverflowPolicy
+	{
+		template<class T, class StatsOwner>
+		struct Set
+		{
+			typedef FlatPointerSet<T, StatsOwner>		type;
+		};
+
+		template<class SetType>
+		static void		reserve( SetType&	set,
+								 size_t		entries )
+		{
+			set.reserve( entries );
+		}
+	};
+
+
+	struct OrderedOverflowPolicy
+	{
+		template<class T, class StatsOwner>
+		struct Set
+		{
+			typedef std::set<T*>		type;
+		};
+
+		//	A tree has no capacity to reserve
+
+		template<class SetType>
+		static void		reserve( SetType&	set,
+								 size_t		entries )
+		{}
+	};
+
+
+
+	template<class T, long CUTOVER_SIZE = DEFAULT_POINTER_LIST_CUTOVER_SIZE, class OverflowPolicy = HashedOverflowPolicy>
 	class SearchablePointerList
 	{
 	private:
@@ -487,13 +1388,16 @@ namespace SEFUtility
 		typedef typename boost::container::static_vector<T*, CUTOVER_SIZE>::iterator				EntryVectorIterator;
 		typedef typename boost::container::static_vector<T*, CUTOVER_SIZE>::const_iterator			EntryVectorConstIterator;
 
-		typedef std::set<T*>																		EntrySet;
+		typedef typename OverflowPolicy::template Set<T, SearchablePointerList>::type				EntrySet;
 		typedef typename EntrySet::iterator															EntrySetIterator;
 		typedef typename EntrySet::const_iterator													EntrySetConstIterator;
 
 
 	public:
 
+		typedef T		value_type;
+
+
 
 		class iterator : public boost::iterator_facade<iterator, T*, boost::forward_traversal_tag, T*>
 		{
@@ -506,13 +1410,13 @@ namespace SEFUtility
 			iterator( const EntryVectorIterator&	vectorIterator )
 				: m_cutOver(false)
 			{
-				m_vectorIterator = new( m_buffer )EntryVectorIterator( vectorIterator );
+				m_vectorIterator = vectorIterator;
 			}
 
 			iterator( const EntrySetIterator&		setIterator )
 				: m_cutOver(true)
 			{
-				m_setIterator = new( m_buffer )EntrySetIterator( setIterator );
+				m_setIterator = setIterator;
 			}
 
 
@@ -522,11 +1426,11 @@ namespace SEFUtility
 			{
 				if (m_cutOver)
 				{
-					(*m_setIterator)++;
+					m_setIterator++;
 				}
 				else
 				{
-					(*m_vectorIterator)++;
+					m_vectorIterator++;
 				}
 			}
 
@@ -534,11 +1438,11 @@ namespace SEFUtility
 			{
 				if (m_cutOver)
 				{
-					return( *m_setIterator == *(other.m_setIterator) );
+					return( m_setIterator == other.m_setIterator );
 				}
 				else
 				{
-					return( *m_vectorIterator == *(other.m_vectorIterator) );
+					return( m_vectorIterator == other.m_vectorIterator );
 				}
 			}
 
@@ -546,24 +1450,21 @@ namespace SEFUtility
 			{
 				if (m_cutOver)
 				{
-					return( *(*m_setIterator) );
+					return( *m_setIterator );
 				}
 				else
 				{
-					return( *(*m_vectorIterator ));
+					return( *m_vectorIterator );
 				}
 			}
 
 
-			unsigned char		m_buffer[boost::static_unsigned_max< sizeof( EntryVectorIterator ), sizeof( EntrySetIterator ) >::value];
+			//	Both are held by value so a copied iterator is self contained, only the one m_cutOver selects is used.
 
 			bool				m_cutOver;
 
-			union
-			{
-				EntryVectorIterator*		m_vectorIterator;
-				EntrySetIterator*			m_setIterator;
-			};
+			EntryVectorIterator		m_vectorIterator;
+			EntrySetIterator			m_setIterator;
 		};
 
 
@@ -578,13 +1479,13 @@ namespace SEFUtility
 			const_iterator( const EntryVectorConstIterator&	vectorIterator )
 				: m_cutOver( false )
 			{
-				m_vectorIterator = new(m_buffer)EntryVectorConstIterator( vectorIterator );
+				m_vectorIterator = vectorIterator;
 			}
 
 			const_iterator( const EntrySetConstIterator&		setIterator )
 				: m_cutOver( true )
 			{
-				m_setIterator = new(m_buffer)EntrySetConstIterator( setIterator );
+				m_setIterator = setIterator;
 			}
 
 
@@ -594,11 +1495,11 @@ namespace SEFUtility
 			{
 				if (m_cutOver)
 				{
-					( *m_setIterator )++;
+					m_setIterator++;
 				}
 				else
 				{
-					( *m_vectorIterator )++;
+					m_vectorIterator++;
 				}
 			}
 
@@ -606,11 +1507,11 @@ namespace SEFUtility
 			{
 				if (m_cutOver)
 				{
-					return( *m_setIterator == *( other.m_setIterator ) );
+					return( m_setIterator == other.m_setIterator );
 				}
 				else
 				{
-					return( *m_vectorIterator == *( other.m_vectorIterator ) );
+					return( m_vectorIterator == other.m_vectorIterator );
 				}
 			}
 
@@ -618,24 +1519,19 @@ namespace SEFUtility
 			{
 				if (m_cutOver)
 				{
-					return( *( *m_setIterator ) );
+					return( *m_setIterator );
 				}
 				else
 				{
-					return( *( *m_vectorIterator ) );
+					return( *m_vectorIterator );
 				}
 			}
 
 
-			unsigned char		m_buffer[boost::static_unsigned_max< sizeof( EntryVectorConstIterator ), sizeof( EntrySetConstIterator ) >::value];
-
 			bool				m_cutOver;
 
-			union
-			{
-				EntryVectorConstIterator*		m_vectorIterator;
-				EntrySetConstIterator*			m_setIterator;
-			};
+			EntryVectorConstIterator		m_vectorIterator;
+			EntrySetConstIterator			m_setIterator;
 		};
 
 
@@ -645,9 +1541,11 @@ namespace SEFUtility
 
 		SearchablePointerList()
 			: m_cutover( false ),
-			  m_inserter( &SearchablePointerList<T,10>::insertIntoArray ),
+			  m_inserter( &SearchablePointerList::insertIntoArray ),
 			  m_map( NULL )
-		{}
+		{
+			SEFUTILITY_TIERING_STAT( tieringCounters().created() );
+		}
 
 		//	Need the copy constructor to keep the compiler quiet about being unable to copy fixed_vectors,
 		//		but we should never call it - thus the assert.
@@ -657,8 +1555,18 @@ namespace SEFUtility
 			assert( false );
 		}
 
+		//	Moving hands over the set or copies the inline pointers, the source is left empty.
+
+		SearchablePointerList( SearchablePointerList&&		listToMove ) noexcept
+			: SearchablePointerList()
+		{
+			takeFrom( listToMove );
+		}
+
 		~SearchablePointerList()
 		{
+			SEFUTILITY_TIERING_STAT( tieringCounters().destroyed( m_cutover ? TIERING_TIER_MAP : TIERING_TIER_INLINE ) );
+
 			if (m_map != NULL)
 			{
 				delete m_map;
@@ -673,6 +1581,76 @@ namespace SEFUtility
 			assert( false );
 		}
 
+		SearchablePointerList&		operator=( SearchablePointerList&&		listToMove ) noexcept
+		{
+			if (this != &listToMove)
+			{
+				clear();
+				takeFrom( listToMove );
+			}
+
+			return( *this );
+		}
+
+
+
+		void					clear()
+		{
+			delete m_map;
+			m_map = NULL;
+
+			m_array.clear();
+
+			SEFUTILITY_TIERING_STAT( tieringCounters().relocated( m_cutover ? TIERING_TIER_MAP : TIERING_TIER_INLINE, TIERING_TIER_INLINE ) );
+
+			m_cutover = false;
+			m_inserter = &SearchablePointerList::insertIntoArray;
+		}
+
+
+		//	A list that is going to outgrow the inline array cuts over now rather than copying the array into
+		//		the set part way through filling it, and the set is then sized for the entries if it can be.
+
+		void					reserve( size_t		entries )
+		{
+			if (!m_cutover && ( entries > CUTOVER_SIZE ))
+			{
+				moveArrayIntoSet();
+			}
+
+			if (m_cutover)
+			{
+				OverflowPolicy::reserve( *m_map, entries );
+			}
+		}
+
+
+		//	Builds a list from pointers already in ascending order, going straight to the set when there are
+		//		too many to hold inline.  Either set is built in a single pass without rebalancing or rehashing.
+
+		template<class Iterator>
+		static SearchablePointerList		from_sorted_range( Iterator		first,
+															   Iterator		last )
+		{
+			SearchablePointerList		list;
+
+			if (std::distance( first, last ) <= CUTOVER_SIZE)
+			{
+				list.m_array.assign( first, last );
+
+				return( list );
+			}
+
+			list.m_map = new EntrySet( first, last );
+
+			SEFUTILITY_TIERING_STAT( tieringCounters().changedTier( TIERING_TIER_INLINE, TIERING_TIER_MAP, list.m_map->size() ) );
+
+			list.m_cutover = true;
+			list.m_inserter = &SearchablePointerList::insertIntoMap;
+
+			return( list );
+		}
+
 
 
 		size_t					size() const
@@ -750,31 +1728,42 @@ namespace SEFUtility
 		
 
 
-		T*		operator[]( unsigned int		index )
+		bool			contains( const T*		value ) const
 		{
 			if (!m_cutover)
 			{
-				for (T& entry : m_array)
-				{
-					if (entry.index() == index)
-					{
-						return( entry );
-					}
-				}
+				return( SIMD::findPointer( m_array.data(), m_array.size(), value ) >= 0 );
 			}
 
-			EntryMapIterator		itrEntry;
+			return( m_map->count( const_cast<T*>( value ) ) != 0 );
+		}
+
+		//	Returns the pointer if it is in the list and NULL otherwise.
+
+		T*				find( const T*		value ) const
+		{
+			return( contains( value ) ? const_cast<T*>( value ) : NULL );
+		}
+
 
-			itrEntry = m_map->find( index );
+		//	Looks up the entry the list points to by its index.  The pointers are not keyed by index, so this is
+		//		a linear scan in either tier.
 
-			if (itrEntry != m_map->end())
+		T*		operator[]( unsigned int		index )
+		{
+			for (T* entry : *this)
 			{
-				return( itrEntry );
+				if (entry->index() == index)
+				{
+					return( entry );
+				}
 			}
 
 			//	We should never get here, so assert.
 
 			assert( false );
+
+			return( NULL );
 		}
 
 
@@ -815,13 +1804,11 @@ namespace SEFUtility
 		{
 			if (!m_cutover)
 			{
-				for (EntryVectorIterator itrElement = m_array.begin(); itrElement != m_array.end(); itrElement++)
+				int		position = SIMD::findPointer( m_array.data(), m_array.size(), index );
+
+				if (position >= 0)
 				{
-					if (*itrElement == index)
-					{
-						m_array.erase( itrElement );
-						break;
-					}
+					m_array.erase( m_array.begin() + position );
 				}
 			}
 			else
@@ -839,22 +1826,78 @@ namespace SEFUtility
 			{
 				for (auto& currentEntry : m_array)
 				{
-					action( currentEntry );
+					action( *currentEntry );
 				}
 			}
 			else
 			{
 				for (auto& currentEntry : *m_map)
 				{
-					action( currentEntry );
+					action( *currentEntry );
+				}
+			}
+		}
+
+		template<class Action>
+		inline void for_each( Action&&		action )
+		{
+			if (!m_cutover)
+			{
+				for (T* currentEntry : m_array)
+				{
+					action( *currentEntry );
+				}
+			}
+			else
+			{
+				for (T* currentEntry : *m_map)
+				{
+					action( *currentEntry );
+				}
+			}
+		}
+
+
+		//	Visits the pointers a contiguous run at a time as visitor( T* const* entries, size_t count ).  Inline the
+		//		whole list is one run, once cut over the pointers are copied out of the set in runs of up to 64.
+
+		template<class Visitor>
+		void			for_each_chunk( Visitor&&		visitor )
+		{
+			if (!m_cutover)
+			{
+				if (!m_array.empty())
+				{
+					visitor( (T* const*)m_array.data(), m_array.size() );
+				}
+
+				return;
+			}
+
+			T*			run[64];
+			size_t		runLength = 0;
+
+			for (T* currentEntry : *m_map)
+			{
+				run[runLength++] = currentEntry;
+
+				if (runLength == 64)
+				{
+					visitor( (T* const*)run, runLength );
+					runLength = 0;
 				}
 			}
+
+			if (runLength > 0)
+			{
+				visitor( (T* const*)run, runLength );
+			}
 		}
 
 
 	protected:
 
-		typedef void (SearchablePointerList<T,10>::*InsertFunctionPointer)( T* );	
+		typedef void (SearchablePointerList::*InsertFunctionPointer)( T* );	
 
 
 		bool						m_cutover;
@@ -868,6 +1911,20 @@ namespace SEFUtility
 
 
 
+		void			takeFrom( SearchablePointerList&		listToMove )
+		{
+			SEFUTILITY_TIERING_STAT( tieringCounters().relocated( TIERING_TIER_INLINE, listToMove.m_cutover ? TIERING_TIER_MAP : TIERING_TIER_INLINE ) );
+
+			m_cutover = listToMove.m_cutover;
+			m_inserter = listToMove.m_inserter;
+			m_array = listToMove.m_array;
+			m_map = listToMove.m_map;
+
+			listToMove.m_map = NULL;
+			listToMove.clear();
+		}
+
+
 		void			insertIntoArray( T*		newValue )
 		{
 			if (m_array.size() < CUTOVER_SIZE)
@@ -876,20 +1933,31 @@ namespace SEFUtility
 			}
 			else
 			{
-				m_map = new EntrySet();
-
-				for (T* value : m_array)
-				{
-					m_map->insert( value );
-				}
+				moveArrayIntoSet();
 
 				m_map->insert( newValue );
+			}
+		}
+
+		void			moveArrayIntoSet()
+		{
+			m_map = new EntrySet( m_array.begin(), m_array.end() );
 
-				m_cutover = true;
+			m_array.clear();
 
-				m_inserter = &SearchablePointerList<T,CUTOVER_SIZE>::insertIntoMap;
-			}
+			SEFUTILITY_TIERING_STAT( tieringCounters().changedTier( TIERING_TIER_INLINE, TIERING_TIER_MAP, m_map->size() ) );
+
+			m_cutover = true;
+
+			m_inserter = &SearchablePointerList::insertIntoMap;
+		}
+
+#if defined( SEFUTILITY_TIERING_STATS )
+		static TieringCounters&		tieringCounters()
+		{
+			return( TieringStats::countersFor<SearchablePointerList>() );
 		}
+#endif
 
 		void			insertIntoMap( T*	newValue )
 		{
@@ -0,0 +1,594 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+
+#include "Result.h"
+#include "SparseVector.h"
+
+
+
+
+//
+//	A collection of sparse vectors saved in compressed sparse row form, so it can be mapped straight
+//		back into memory instead of being rebuilt entry by entry.  The file holds a header, then an
+//		offsets array with one element per row plus one, then the indices of every row and finally the
+//		entries themselves.  Row r occupies positions [offsets[r], offsets[r+1]) of the indices and
+//		entries arrays, sorted by index.
+//
+//	The entries are written as raw bytes, so the entry class must be trivially copyable, and the file
+//		is only readable on a machine with the same endianness and the same entry layout.  The header
+//		records the index and entry sizes so a mismatched reader fails to open the file rather than
+//		misreading it.
+//
+//	MappedSparseVectorFile maps the file read-only and hands out SparseVectorViews over the rows.  The
+//		views point directly into the mapping, nothing is copied and the pages are shared with every
+//		other process mapping the same file.
+//
+
+
+namespace SEFUtility
+{
+	namespace SparseVectorFile
+	{
+		enum class ErrorCodes { SUCCESS = 0, OPEN_FAILED, WRITE_FAILED, STAT_FAILED, MMAP_FAILED, BAD_HEADER, LAYOUT_MISMATCH, TRUNCATED };
+
+		typedef Result<ErrorCodes>		FileResult;
+
+
+		const char			MAGIC[8] = { 'S', 'E', 'F', 'S', 'P', 'V', 'E', 'C' };
+		const uint32_t		VERSION = 1;
+
+		//	Sections start on cache line boundaries
+
+		const uint64_t		SECTION_ALIGNMENT = 64;
+
+
+		struct Header
+		{
+			char		magic[8];
+			uint32_t	version;
+			uint32_t	indexSize;
+			uint32_t	entrySize;
+			uint32_t	entryAlignment;
+			uint64_t	rowCount;
+			uint64_t	entryCount;
+			uint64_t	offsetsStart;
+			uint64_t	indicesStart;
+			uint64_t	entriesStart;
+			uint64_t	fileSize;
+		};
+
+
+		inline uint64_t		alignSection( uint64_t		position )
+		{
+			return(( position + SECTION_ALIGNMENT - 1 ) & ~( SECTION_ALIGNMENT - 1 ));
+		}
+
+		inline void			padTo( std::ofstream&		file,
+								   uint64_t				position )
+		{
+			static const char		zeroes[SECTION_ALIGNMENT] = { 0 };
+
+			uint64_t		current = (uint64_t)file.tellp();
+
+			file.write( zeroes, position - current );
+		}
+
+
+		//	The entries of each row are collected and sorted once for the indices section and again for
+		//		the entries section, so only one row's worth of pointers is ever held.
+
+		template<class RowIterator>
+		FileResult			Write( const std::string&		filename,
+								   RowIterator				firstRow,
+								   RowIterator				lastRow )
+		{
+			typedef typename std::iterator_traits<RowIterator>::value_type							RowType;
+			typedef typename RowType::index_type													IndexType;
+			typedef typename std::remove_const<typename std::remove_pointer<decltype( *std::declval<const RowType&>().begin() )>::type>::type		EntryType;
+
+			static_assert( std::is_trivially_copyable<EntryType>::value, "SparseVectorFile entries are written as raw bytes" );
+
+
+			std::ofstream		file( filename.c_str(), std::ios::binary | std::ios::trunc );
+
+			if( !file )
+			{
+				return( FileResult::Failure( ErrorCodes::OPEN_FAILED, std::string( "Could not open " ) + filename + " for writing: " + strerror( errno )));
+			}
+
+			std::vector<uint64_t>		offsets( 1, 0 );
+
+			for( RowIterator itrRow = firstRow; itrRow != lastRow; ++itrRow )
+			{
+				offsets.push_back( offsets.back() + itrRow->size() );
+			}
+
+			Header		header;
+
+			memset( &header, 0, sizeof( header ) );
+			memcpy( header.magic, MAGIC, sizeof( MAGIC ) );
+
+			header.version = VERSION;
+			header.indexSize = sizeof( IndexType );
+			header.entrySize = sizeof( EntryType );
+			header.entryAlignment = __alignof( EntryType );
+			header.rowCount = offsets.size() - 1;
+			header.entryCount = offsets.back();
+			header.offsetsStart = alignSection( sizeof( Header ) );
+			header.indicesStart = alignSection( header.offsetsStart + offsets.size() * sizeof( uint64_t ) );
+			header.entriesStart = alignSection( header.indicesStart + header.entryCount * sizeof( IndexType ) );
+			header.fileSize = header.entriesStart + header.entryCount * sizeof( EntryType );
+
+			file.write( (const char*)&header, sizeof( header ) );
+
+			padTo( file, header.offsetsStart );
+			file.write( (const char*)offsets.data(), offsets.size() * sizeof( uint64_t ) );
+
+			std::vector<const EntryType*>		rowEntries;
+
+			auto		collectRow = [&rowEntries]( const RowType&		row )
+			{
+				rowEntries.clear();
+
+				for( auto itrEntry = row.begin(); itrEntry != row.end(); ++itrEntry )
+				{
+					rowEntries.push_back( *itrEntry );
+				}
+
+				std::sort( rowEntries.begin(), rowEntries.end(), []( const EntryType* lhs, const EntryType* rhs ) { return( lhs->index() < rhs->index() ); } );
+			};
+
+			padTo( file, header.indicesStart );
+
+			for( RowIterator itrRow = firstRow; itrRow != lastRow; ++itrRow )
+			{
+				collectRow( *itrRow );
+
+				for( const EntryType* entry : rowEntries )
+				{
+					IndexType		index = entry->index();
+
+					file.write( (const char*)&index, sizeof( IndexType ) );
+				}
+			}
+
+			padTo( file, header.entriesStart );
+
+			for( RowIterator itrRow = firstRow; itrRow != lastRow; ++itrRow )
+			{
+				collectRow( *itrRow );
+
+				for( const EntryType* entry : rowEntries )
+				{
+					file.write( (const char*)entry, sizeof( EntryType ) );
+				}
+			}
+
+			file.close();
+
+			if( !file )
+			{
+				return( FileResult::Failure( ErrorCodes::WRITE_FAILED, std::string( "Error writing " ) + filename + ": " + strerror( errno )));
+			}
+
+			return( FileResult::Success() );
+		}
+	}
+
+
+
+	//	A read-only row of a mapped file, with the same iteration and lookup interface as the containers.
+
+	template<class T, class IndexType = typename SparseVectorIndexType<T>::type>
+	class SparseVectorView
+	{
+	public :
+
+		typedef IndexType		index_type;
+
+
+		class const_iterator : public boost::iterator_facade<const_iterator, const T*, boost::random_access_traversal_tag, const T*>
+		{
+		protected :
+
+			friend class SparseVectorView;
+			friend class boost::iterator_core_access;
+
+
+			const_iterator( const T*		entry )
+				: m_entry( entry )
+			{}
+
+
+			void			increment()
+			{
+				m_entry++;
+			}
+
+			void			decrement()
+			{
+				m_entry--;
+			}
+
+			void			advance( ptrdiff_t		distance )
+			{
+				m_entry += distance;
+			}
+
+			ptrdiff_t		distance_to( const_iterator const&		other ) const
+			{
+				return( other.m_entry - m_entry );
+			}
+
+			bool			equal( const_iterator const&		other ) const
+			{
+				return( m_entry == other.m_entry );
+			}
+
+			const T*		dereference() const
+			{
+				return( m_entry );
+			}
+
+
+			const T*		m_entry;
+		};
+
+		typedef const_iterator		iterator;
+
+
+
+		SparseVectorView()
+			: m_indices( NULL ),
+			  m_entries( NULL ),
+			  m_size( 0 )
+		{}
+
+		SparseVectorView( const IndexType*		indices,
+						  const T*				entries,
+						  size_t				size )
+			: m_indices( indices ),
+			  m_entries( entries ),
+			  m_size( size )
+		{}
+
+
+
+		size_t				size() const
+		{
+			return( m_size );
+		}
+
+		bool				empty() const
+		{
+			return( m_size == 0 );
+		}
+
+		//	The indices of the row, in ascending order and parallel to the entries
+
+		const IndexType*	indices() const
+		{
+			return( m_indices );
+		}
+
+
+		const_iterator		begin() const
+		{
+			return( const_iterator( m_entries ) );
+		}
+
+		const_iterator		end() const
+		{
+			return( const_iterator( m_entries + m_size ) );
+		}
+
+
+
+		const T*			find( IndexType		index ) const
+		{
+			const IndexType*	found = std::lower_bound( m_indices, m_indices + m_size, index );
+
+			return((( found != m_indices + m_size ) && ( *found == index )) ? m_entries + ( found - m_indices ) : NULL );
+		}
+
+		const T&			operator[]( IndexType		index ) const
+		{
+			const T*		entry = find( index );
+
+			//	If we did not find the entry there is no choice but assert
+
+			assert( entry != NULL );
+
+			return( *entry );
+		}
+
+
+		inline void			for_each( std::function<void( const T &entry )> action ) const
+		{
+			for( size_t i = 0; i < m_size; i++ )
+			{
+				action( m_entries[i] );
+			}
+		}
+
+		template<class Action>
+		inline void			for_each( Action&&		action ) const
+		{
+			for( size_t i = 0; i < m_size; i++ )
+			{
+				action( m_entries[i] );
+			}
+		}
+
+		//	The whole row is one contiguous run
+
+		template<class Visitor>
+		void				for_each_chunk( Visitor&&		visitor ) const
+		{
+			if( m_size > 0 )
+			{
+				visitor( m_indices, m_entries, m_size );
+			}
+		}
+
+
+	private :
+
+		const IndexType*		m_indices;
+		const T*				m_entries;
+		size_t					m_size;
+	};
+
+
+
+	template<class T, class IndexType = typename SparseVectorIndexType<T>::type>
+	class MappedSparseVectorFile : boost::noncopyable
+	{
+	public :
+
+		typedef SparseVectorFile::ErrorCodes		ErrorCodes;
+		typedef SparseVectorFile::FileResult		OpenResult;
+
+		typedef SparseVectorView<T, IndexType>		View;
+
+
+		MappedSparseVectorFile()
+			: m_descriptor( -1 ),
+			  m_mapping( NULL ),
+			  m_mappingSize( 0 ),
+			  m_header( NULL ),
+			  m_offsets( NULL ),
+			  m_indices( NULL ),
+			  m_entries( NULL )
+		{}
+
+		~MappedSparseVectorFile()
+		{
+			Close();
+		}
+
+
+
+		OpenResult			Open( const std::string&		filename )
+		{
+			Close();
+
+			m_descriptor = open( filename.c_str(), O_RDONLY );
+
+			if( m_descriptor < 0 )
+			{
+				return( OpenResult::Failure( ErrorCodes::OPEN_FAILED, std::string( "Could not open " ) + filename + ": " + strerror( errno )));
+			}
+
+			struct stat		fileStatus;
+
+			if( fstat( m_descriptor, &fileStatus ) != 0 )
+			{
+				int		error = errno;
+
+				Close();
+
+				return( OpenResult::Failure( ErrorCodes::STAT_FAILED, std::string( "Call to fstat() failed with error: " ) + strerror( error )));
+			}
+
+			if( (size_t)fileStatus.st_size < sizeof( SparseVectorFile::Header ) )
+			{
+				Close();
+
+				return( OpenResult::Failure( ErrorCodes::TRUNCATED, filename + " is too short to hold a sparse vector file header" ));
+			}
+
+			m_mappingSize = (size_t)fileStatus.st_size;
+
+			void*		mapping = mmap( NULL, m_mappingSize, PROT_READ, MAP_SHARED, m_descriptor, 0 );
+
+			if( mapping == MAP_FAILED )
+			{
+				int		error = errno;
+
+				Close();
+
+				return( OpenResult::Failure( ErrorCodes::MMAP_FAILED, std::string( "Call to mmap() failed with error: " ) + strerror( error )));
+			}
+
+			m_mapping = mapping;
+			m_header = (const SparseVectorFile::Header*)mapping;
+
+			OpenResult		headerCheck = checkHeader( filename );
+
+			if( headerCheck.Failed() )
+			{
+				Close();
+
+				return( headerCheck );
+			}
+
+			m_offsets = (const uint64_t*)( (const char*)mapping + m_header->offsetsStart );
+			m_indices = (const IndexType*)( (const char*)mapping + m_header->indicesStart );
+			m_entries = (const T*)( (const char*)mapping + m_header->entriesStart );
+
+			return( OpenResult::Success() );
+		}
+
+
+		void				Close()
+		{
+			if( m_mapping != NULL )
+			{
+				munmap( m_mapping, m_mappingSize );
+			}
+
+			if( m_descriptor >= 0 )
+			{
+				close( m_descriptor );
+			}
+
+			m_descriptor = -1;
+			m_mapping = NULL;
+			m_mappingSize = 0;
+			m_header = NULL;
+			m_offsets = NULL;
+			m_indices = NULL;
+			m_entries = NULL;
+		}
+
+
+
+		bool				isOpen() const
+		{
+			return( m_mapping != NULL );
+		}
+
+		size_t				size() const
+		{
+			return( m_header != NULL ? m_header->rowCount : 0 );
+		}
+
+		size_t				entryCount() const
+		{
+			return( m_header != NULL ? m_header->entryCount : 0 );
+		}
+
+
+		View				operator[]( size_t		row ) const
+		{
+			assert( row < size() );
+
+			uint64_t		first = m_offsets[row];
+
+			return( View( m_indices + first, m_entries + first, m_offsets[row + 1] - first ) );
+		}
+
+
+	private :
+
+		int									m_descriptor;
+
+		void*								m_mapping;
+		size_t								m_mappingSize;
+
+		const SparseVectorFile::Header*		m_header;
+		const uint64_t*						m_offsets;
+		const IndexType*					m_indices;
+		const T*							m_entries;
+
+
+		OpenResult			checkHeader( const std::string&		filename ) const
+		{
+			if(( memcmp( m_header->magic, SparseVectorFile::MAGIC, sizeof( SparseVectorFile::MAGIC ) ) != 0 ) ||
+			   ( m_header->version != SparseVectorFile::VERSION ))
+			{
+				return( OpenResult::Failure( ErrorCodes::BAD_HEADER, filename + " is not a sparse vector file this version can read" ));
+			}
+
+			if(( m_header->indexSize != sizeof( IndexType ) ) ||
+			   ( m_header->entrySize != sizeof( T ) ) ||
+			   ( m_header->entryAlignment != __alignof( T ) ))
+			{
+				return( OpenResult::Failure( ErrorCodes::LAYOUT_MISMATCH, filename + " was written with a different index or entry layout" ));
+			}
+
+			//	The counts are bounded by the mapping first so the section ends below cannot overflow
+
+			if(( m_header->fileSize > m_mappingSize ) ||
+			   ( m_header->rowCount >= m_mappingSize / sizeof( uint64_t ) ) ||
+			   ( m_header->entryCount > m_mappingSize / sizeof( IndexType ) ) ||
+			   ( m_header->offsetsStart > m_header->fileSize ) ||
+			   ( m_header->indicesStart > m_header->fileSize ) ||
+			   ( m_header->entriesStart > m_header->fileSize ) ||
+			   ( m_header->offsetsStart + ( m_header->rowCount + 1 ) * sizeof( uint64_t ) > m_header->indicesStart ) ||
+			   ( m_header->indicesStart + m_header->entryCount * sizeof( IndexType ) > m_header->entriesStart ) ||
+			   ( m_header->entriesStart + m_header->entryCount * sizeof( T ) > m_header->fileSize ))
+			{
+				return( OpenResult::Failure( ErrorCodes::TRUNCATED, filename + " is shorter than its header describes" ));
+			}
+
+			//	operator[] trusts the offsets, so every row must lie within the entries before the file is accepted
+
+			const uint64_t*		offsets = (const uint64_t*)( (const char*)m_mapping + m_header->offsetsStart );
+
+			if(( offsets[0] != 0 ) || ( offsets[m_header->rowCount] != m_header->entryCount ))
+			{
+				return( OpenResult::Failure( ErrorCodes::BAD_HEADER, filename + " has row offsets that do not match its entry count" ));
+			}
+
+			for( uint64_t row = 0; row < m_header->rowCount; row++ )
+			{
+				if(( offsets[row] > offsets[row + 1] ) || ( offsets[row + 1] > m_header->entryCount ))
+				{
+					return( OpenResult::Failure( ErrorCodes::BAD_HEADER, filename + " has row offsets out of order or past its entries" ));
+				}
+			}
+
+			return( OpenResult::Success() );
+		}
+	};
+
+}	//	namespace SEFUtility
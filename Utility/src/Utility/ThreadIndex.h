@@ -0,0 +1,106 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+#pragma once
+
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+
+
+
+//
+//	ThreadIndex hands each thread a small integer, unique among the live threads, for indexing per-thread
+//		state kept in plain arrays.  A thread claims the lowest free index the first time it asks and gives
+//		it back when it exits, so a later thread may be given the same index.  A thread finding all
+//		MAX_THREADS indices taken waits for one to be released.
+//
+
+namespace SEFUtility
+{
+
+	class ThreadIndex
+	{
+	public :
+
+		static const size_t		MAX_THREADS = 256;
+
+
+		static size_t		current()
+		{
+			static thread_local Claim		claim;
+
+			return( claim.m_index );
+		}
+
+
+	private :
+
+		static std::atomic<bool>*		claimed()
+		{
+			//	Zero initialized, as a static, before any thread can run
+
+			static std::atomic<bool>		claimedIndices[MAX_THREADS];
+
+			return( claimedIndices );
+		}
+
+
+		struct Claim
+		{
+			Claim()
+			{
+				for( ; ; )
+				{
+					for( m_index = 0; m_index < MAX_THREADS; m_index++ )
+					{
+						bool		expected = false;
+
+						if( claimed()[m_index].compare_exchange_strong( expected, true, std::memory_order_acq_rel ))
+						{
+							return;
+						}
+					}
+
+					std::this_thread::yield();
+				}
+			}
+
+			~Claim()
+			{
+				claimed()[m_index].store( false, std::memory_order_release );
+			}
+
+			size_t		m_index;
+		};
+	};
+
+}	//	namespace SEFUtility
@@ -0,0 +1,374 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+#pragma once
+
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include <boost/core/demangle.hpp>
+#include <boost/noncopyable.hpp>
+
+
+
+
+//
+//	Opt-in instrumentation of the tiered containers.  Building with SEFUTILITY_TIERING_STATS defined makes
+//		SparseVector, SearchablePointerList and the hash and bitmap tables behind them count, per
+//		instantiated type:
+//
+//			- how many containers are live in each tier, and the moves between tiers
+//			- a histogram of the container size at each cutover out of the inline tier, in powers of two
+//			- the bytes held in each tier: the containers themselves count as inline bytes, the tables
+//				behind them as map or dense bytes of the container that owns them
+//			- lookups and groups probed in the hash tables, for the average probe length
+//
+//	Without the define the hooks compile to nothing and the reports are empty.  With it every hook is a
+//		relaxed atomic add on a counter shared by all containers of a type, so expect some slowdown
+//		when many threads work on containers of the same type.
+//
+//	TieringStats::report() returns the counters for every type seen so far, write() formats them as a
+//		table and TieringStatsLogger in TieringStatsLogger.h writes that table to a log periodically.
+//
+
+#if defined( SEFUTILITY_TIERING_STATS )
+#define SEFUTILITY_TIERING_STAT( ... )		__VA_ARGS__
+#else
+#define SEFUTILITY_TIERING_STAT( ... )
+#endif
+
+
+namespace SEFUtility
+{
+
+	const size_t		TIERING_TIER_INLINE = 0;
+	const size_t		TIERING_TIER_MAP = 1;
+	const size_t		TIERING_TIER_DENSE = 2;
+	const size_t		TIERING_TIER_COUNT = 3;
+
+	const size_t		TIERING_HISTOGRAM_BUCKETS = 32;
+
+
+
+	struct TieringReport
+	{
+		std::string			m_typeName;
+
+		int64_t				m_live[TIERING_TIER_COUNT];
+		int64_t				m_bytes[TIERING_TIER_COUNT];
+
+		uint64_t			m_transitions[TIERING_TIER_COUNT][TIERING_TIER_COUNT];
+		uint64_t			m_cutoverSizes[TIERING_HISTOGRAM_BUCKETS];
+
+		uint64_t			m_lookups;
+		uint64_t			m_groupsProbed;
+
+
+		uint64_t			cutovers() const
+		{
+			return( m_transitions[TIERING_TIER_INLINE][TIERING_TIER_MAP] + m_transitions[TIERING_TIER_INLINE][TIERING_TIER_DENSE] );
+		}
+
+		double				averageProbeLength() const
+		{
+			return( m_lookups == 0 ? 0.0 : (double)m_groupsProbed / (double)m_lookups );
+		}
+	};
+
+
+
+	class TieringCounters : boost::noncopyable
+	{
+	public :
+
+		TieringCounters( const std::string&		typeName,
+						 size_t					containerBytes )
+			: m_typeName( typeName ),
+			  m_containerBytes( (int64_t)containerBytes ),
+			  m_lookups( 0 ),
+			  m_groupsProbed( 0 )
+		{
+			for( size_t from = 0; from < TIERING_TIER_COUNT; from++ )
+			{
+				m_live[from].store( 0, std::memory_order_relaxed );
+				m_bytes[from].store( 0, std::memory_order_relaxed );
+
+				for( size_t to = 0; to < TIERING_TIER_COUNT; to++ )
+				{
+					m_transitions[from][to].store( 0, std::memory_order_relaxed );
+				}
+			}
+
+			for( size_t i = 0; i < TIERING_HISTOGRAM_BUCKETS; i++ )
+			{
+				m_cutoverSizes[i].store( 0, std::memory_order_relaxed );
+			}
+		}
+
+
+
+		void			created()
+		{
+			m_live[TIERING_TIER_INLINE].fetch_add( 1, std::memory_order_relaxed );
+			m_bytes[TIERING_TIER_INLINE].fetch_add( m_containerBytes, std::memory_order_relaxed );
+		}
+
+		void			destroyed( size_t		tier )
+		{
+			m_live[tier].fetch_sub( 1, std::memory_order_relaxed );
+			m_bytes[TIERING_TIER_INLINE].fetch_sub( m_containerBytes, std::memory_order_relaxed );
+		}
+
+		//	A container has grown or shrunk into another tier, size is the number of entries it holds after the move.
+
+		void			changedTier( size_t		from,
+									 size_t		to,
+									 size_t		size )
+		{
+			relocated( from, to );
+
+			m_transitions[from][to].fetch_add( 1, std::memory_order_relaxed );
+
+			if( from == TIERING_TIER_INLINE )
+			{
+				m_cutoverSizes[bucketOf( size )].fetch_add( 1, std::memory_order_relaxed );
+			}
+		}
+
+		//	A container has changed tier without growing or shrinking into it, by clear() or a move.
+
+		void			relocated( size_t		from,
+								   size_t		to )
+		{
+			m_live[from].fetch_sub( 1, std::memory_order_relaxed );
+			m_live[to].fetch_add( 1, std::memory_order_relaxed );
+		}
+
+		void			allocated( size_t		tier,
+								   int64_t		bytes )
+		{
+			m_bytes[tier].fetch_add( bytes, std::memory_order_relaxed );
+		}
+
+		void			probed( size_t		groups )
+		{
+			m_lookups.fetch_add( 1, std::memory_order_relaxed );
+			m_groupsProbed.fetch_add( groups, std::memory_order_relaxed );
+		}
+
+
+		TieringReport	report() const
+		{
+			TieringReport		report;
+
+			report.m_typeName = m_typeName;
+
+			for( size_t from = 0; from < TIERING_TIER_COUNT; from++ )
+			{
+				report.m_live[from] = m_live[from].load( std::memory_order_relaxed );
+				report.m_bytes[from] = m_bytes[from].load( std::memory_order_relaxed );
+
+				for( size_t to = 0; to < TIERING_TIER_COUNT; to++ )
+				{
+					report.m_transitions[from][to] = m_transitions[from][to].load( std::memory_order_relaxed );
+				}
+			}
+
+			for( size_t i = 0; i < TIERING_HISTOGRAM_BUCKETS; i++ )
+			{
+				report.m_cutoverSizes[i] = m_cutoverSizes[i].load( std::memory_order_relaxed );
+			}
+
+			report.m_lookups = m_lookups.load( std::memory_order_relaxed );
+			report.m_groupsProbed = m_groupsProbed.load( std::memory_order_relaxed );
+
+			return( report );
+		}
+
+
+	private :
+
+		const std::string			m_typeName;
+		const int64_t				m_containerBytes;
+
+		std::atomic<int64_t>		m_live[TIERING_TIER_COUNT];
+		std::atomic<int64_t>		m_bytes[TIERING_TIER_COUNT];
+
+		std::atomic<uint64_t>		m_transitions[TIERING_TIER_COUNT][TIERING_TIER_COUNT];
+		std::atomic<uint64_t>		m_cutoverSizes[TIERING_HISTOGRAM_BUCKETS];
+
+		std::atomic<uint64_t>		m_lookups;
+		std::atomic<uint64_t>		m_groupsProbed;
+
+
+		//	Bucket b holds sizes from 2^b up to 2^(b+1) - 1, with sizes of zero and one both in the first
+
+		static size_t		bucketOf( size_t		size )
+		{
+			size_t		bucket = 0;
+
+			while(( size > 1 ) && ( bucket < TIERING_HISTOGRAM_BUCKETS - 1 ))
+			{
+				size >>= 1;
+				bucket++;
+			}
+
+			return( bucket );
+		}
+	};
+
+
+
+	//	The type a table's allocations and probes are counted against: the container that owns it, or the
+	//		table itself when it is used on its own and the owner is void.
+
+	template<class StatsOwner, class Table>
+	struct TieringOwner
+	{
+		typedef StatsOwner		type;
+	};
+
+	template<class Table>
+	struct TieringOwner<void, Table>
+	{
+		typedef Table		type;
+	};
+
+
+
+	class TieringStats
+	{
+	public :
+
+		//	The counters for a type are created and registered the first time they are asked for.
+
+		template<class Container>
+		static TieringCounters&			countersFor()
+		{
+			static TieringCounters&		counters = registerCounters( boost::core::demangle( typeid( Container ).name() ), sizeof( Container ) );
+
+			return( counters );
+		}
+
+
+		static std::vector<TieringReport>		report()
+		{
+			Registry&						registry = getRegistry();
+			std::lock_guard<std::mutex>		lock( registry.m_mutex );
+
+			std::vector<TieringReport>		reports;
+
+			for( const std::unique_ptr<TieringCounters>& counters : registry.m_counters )
+			{
+				reports.push_back( counters->report() );
+			}
+
+			return( reports );
+		}
+
+
+		static void						write( std::ostream&		output )
+		{
+			static const char*		TIER_NAMES[TIERING_TIER_COUNT] = { "inline", "map", "dense" };
+
+			for( const TieringReport& report : TieringStats::report() )
+			{
+				output << report.m_typeName << std::endl;
+
+				for( size_t tier = 0; tier < TIERING_TIER_COUNT; tier++ )
+				{
+					output << "    " << std::setw( 8 ) << TIER_NAMES[tier] << ": " << report.m_live[tier] << " live, " << report.m_bytes[tier] << " bytes" << std::endl;
+				}
+
+				output << "    transitions:";
+
+				for( size_t from = 0; from < TIERING_TIER_COUNT; from++ )
+				{
+					for( size_t to = 0; to < TIERING_TIER_COUNT; to++ )
+					{
+						if( report.m_transitions[from][to] > 0 )
+						{
+							output << " " << TIER_NAMES[from] << "->" << TIER_NAMES[to] << "=" << report.m_transitions[from][to];
+						}
+					}
+				}
+
+				output << std::endl << "    size at cutover:";
+
+				for( size_t bucket = 0; bucket < TIERING_HISTOGRAM_BUCKETS; bucket++ )
+				{
+					if( report.m_cutoverSizes[bucket] > 0 )
+					{
+						output << " " << ( (uint64_t)1 << bucket ) << "+=" << report.m_cutoverSizes[bucket];
+					}
+				}
+
+				output << std::endl << "    lookups: " << report.m_lookups << ", average probe length " << report.averageProbeLength() << std::endl;
+			}
+		}
+
+
+	private :
+
+		struct Registry
+		{
+			std::mutex										m_mutex;
+			std::vector<std::unique_ptr<TieringCounters>>	m_counters;
+		};
+
+
+		static Registry&				getRegistry()
+		{
+			static Registry		registry;
+
+			return( registry );
+		}
+
+		static TieringCounters&			registerCounters( const std::string&		typeName,
+														  size_t					containerBytes )
+		{
+			Registry&						registry = getRegistry();
+			std::lock_guard<std::mutex>		lock( registry.m_mutex );
+
+			registry.m_counters.push_back( std::unique_ptr<TieringCounters>( new TieringCounters( typeName, containerBytes ) ));
+
+			return( *registry.m_counters.back() );
+		}
+	};
+
+}	//	namespace SEFUtility
@@ -0,0 +1,117 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+#pragma once
+
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <boost/noncopyable.hpp>
+
+#include "Logging.h"
+#include "TieringStats.h"
+
+
+
+
+//
+//	TieringStatsLogger writes the TieringStats table to a logger's info stream every interval, from its own
+//		thread, for as long as it lives.  The thread is woken and joined on destruction.
+//
+//		TieringStatsLogger		statsLogger( *Logging::GetLogger( "TieringStats" ), std::chrono::seconds( 60 ) );
+//
+
+namespace SEFUtility
+{
+
+	class TieringStatsLogger : boost::noncopyable
+	{
+	public :
+
+		TieringStatsLogger( ILogger&					logger,
+							std::chrono::milliseconds	interval )
+			: m_logger( logger ),
+			  m_interval( interval ),
+			  m_stopping( false ),
+			  m_thread( &TieringStatsLogger::run, this )
+		{}
+
+		~TieringStatsLogger()
+		{
+			{
+				std::lock_guard<std::mutex>		lock( m_mutex );
+
+				m_stopping = true;
+			}
+
+			m_wakeup.notify_one();
+			m_thread.join();
+		}
+
+
+		void			logNow()
+		{
+			std::ostringstream		table;
+
+			TieringStats::write( table );
+
+			m_logger.InfoStream() << "Tiering statistics\n" << table.str() << std::endl;
+		}
+
+
+	private :
+
+		ILogger&						m_logger;
+		std::chrono::milliseconds		m_interval;
+
+		std::mutex						m_mutex;
+		std::condition_variable			m_wakeup;
+		bool							m_stopping;
+
+		std::thread						m_thread;
+
+
+		void			run()
+		{
+			std::unique_lock<std::mutex>		lock( m_mutex );
+
+			while( !m_wakeup.wait_for( lock, m_interval, [this]() { return( m_stopping ); } ))
+			{
+				lock.unlock();
+				logNow();
+				lock.lock();
+			}
+		}
+	};
+
+}	//	namespace SEFUtility
@@ -0,0 +1,344 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+
+
+#define BOOST_TEST_MODULE ConcurrentObjectPoolTest
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <boost/test/included/unit_test.hpp>
+
+#include "Utility/ConcurrentObjectPool.h"
+
+
+
+using namespace SEFUtility;
+
+
+std::atomic<int>		liveNodes( 0 );
+
+
+struct Node
+{
+	Node( int		owner,
+		  int		serial )
+		: m_owner( owner ),
+		  m_serial( serial )
+	{
+		liveNodes++;
+	}
+
+	~Node()
+	{
+		liveNodes--;
+	}
+
+	int		m_owner;
+	int		m_serial;
+};
+
+
+typedef ConcurrentObjectPool<Node, 64>		NodePool;
+
+
+//	An odd size, so the slots do not divide the chunk evenly and the header is followed by spare space
+
+struct OddNode
+{
+	OddNode( int		key )
+		: m_key( key )
+	{
+		liveNodes++;
+	}
+
+	~OddNode()
+	{
+		liveNodes--;
+	}
+
+	int		m_key;
+	char	m_padding[36];
+};
+
+
+//	Refuses a negative key from its constructor
+
+struct ThrowingNode
+{
+	ThrowingNode( int		key )
+		: m_key( key )
+	{
+		if( key < 0 )
+		{
+			throw std::invalid_argument( "negative key" );
+		}
+
+		liveNodes++;
+	}
+
+	~ThrowingNode()
+	{
+		liveNodes--;
+	}
+
+	int		m_key;
+	char	m_padding[12];
+};
+
+
+const int		THREADS = 8;
+const int		ITERATIONS = 20000;
+
+
+
+//	Random news and frees on one thread against a map of key to object, over enough objects to fill many
+//		chunks, checking after every step that iterating the pool finds exactly the map's objects.
+
+template<class Pool>
+static void			churnAgainstMap( unsigned int		seed )
+{
+	{
+		Pool							pool;
+		std::map<int, OddNode*>			reference;
+		std::mt19937					random( seed );
+
+		for( int step = 0; step < 20000; step++ )
+		{
+			int		key = random() % 3000;
+
+			if( reference.count( key ) != 0 )
+			{
+				pool.free( reference[key] );
+				reference.erase( key );
+			}
+			else
+			{
+				reference[key] = pool.newObject( key );
+			}
+
+			if( step % 499 == 0 )
+			{
+				std::map<int, OddNode*>		found;
+
+				for( typename Pool::iterator itrNode = pool.begin(); itrNode != pool.end(); ++itrNode )
+				{
+					found[itrNode->m_key] = &*itrNode;
+				}
+
+				BOOST_REQUIRE( found == reference );
+				BOOST_REQUIRE_EQUAL( pool.size(), reference.size() );
+			}
+		}
+
+		BOOST_CHECK_EQUAL( liveNodes.load(), (int)reference.size() );
+	}
+
+	//	The pool destroys the objects still in it
+
+	BOOST_CHECK_EQUAL( liveNodes.load(), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( ChurnMatchesMap )
+{
+	churnAgainstMap<ConcurrentObjectPool<OddNode, 1>>( 1 );
+	churnAgainstMap<ConcurrentObjectPool<OddNode, 7>>( 7 );
+	churnAgainstMap<ConcurrentObjectPool<OddNode, 64>>( 64 );
+	churnAgainstMap<ConcurrentObjectPool<OddNode, 1000>>( 1000 );
+}
+
+
+BOOST_AUTO_TEST_CASE( ThrowingConstructorReturnsSlot )
+{
+	{
+		ConcurrentObjectPool<ThrowingNode, 4>		pool;
+
+		//	A fresh slot taken from the chunk goes back on the free list and is the next one handed out
+
+		ThrowingNode*		first = pool.newObject( 1 );
+
+		BOOST_CHECK_THROW( pool.newObject( -1 ), std::invalid_argument );
+
+		ThrowingNode*		second = pool.newObject( 2 );
+
+		BOOST_CHECK( second == first + 1 );
+
+		//	So does a slot taken from the free list
+
+		pool.free( first );
+
+		BOOST_CHECK_THROW( pool.newObject( -1 ), std::invalid_argument );
+
+		ThrowingNode*		third = pool.newObject( 3 );
+
+		BOOST_CHECK( third == first );
+
+		//	Many failures neither grow the pool nor show up when iterating it
+
+		for( int i = 0; i < 1000; i++ )
+		{
+			BOOST_CHECK_THROW( pool.newObject( -1 ), std::invalid_argument );
+		}
+
+		BOOST_CHECK( pool.newObject( 4 ) == second + 1 );
+
+		std::set<int>		keys;
+
+		for( ConcurrentObjectPool<ThrowingNode, 4>::iterator itrNode = pool.begin(); itrNode != pool.end(); ++itrNode )
+		{
+			keys.insert( itrNode->m_key );
+		}
+
+		BOOST_CHECK( keys == std::set<int>( { 2, 3, 4 } ));
+		BOOST_CHECK_EQUAL( pool.size(), 3u );
+		BOOST_CHECK_EQUAL( liveNodes.load(), 3 );
+	}
+
+	BOOST_CHECK_EQUAL( liveNodes.load(), 0 );
+}
+
+
+//	The threads allocate, free their own objects and hand objects to each other to free, so frees go
+//		through both the owner's free list and the remote free queues.  Boost.Test assertions are not
+//		thread safe, so the threads count what they find wrong.
+
+BOOST_AUTO_TEST_CASE( ObjectsSurviveLocalAndRemoteFrees )
+{
+	NodePool						pool;
+	std::atomic<int>				failures( 0 );
+	std::vector<std::vector<Node*>>	handedOff( THREADS );
+	std::mutex						handOffLocks[THREADS];
+	std::vector<std::thread>		threads;
+
+	for( int thread = 0; thread < THREADS; thread++ )
+	{
+		threads.emplace_back( [&, thread]
+		{
+			std::mt19937		random( thread );
+			std::vector<Node*>	owned;
+
+			for( int iteration = 0; iteration < ITERATIONS; iteration++ )
+			{
+				switch( random() % 4 )
+				{
+					case 0 :
+					case 1 :
+					{
+						Node*		node = pool.newObject( thread, iteration );
+
+						if(( node->m_owner != thread ) || ( node->m_serial != iteration ))
+						{
+							failures++;
+						}
+
+						owned.push_back( node );
+						break;
+					}
+
+					case 2 :
+						if( !owned.empty() )
+						{
+							pool.free( owned.back() );
+							owned.pop_back();
+						}
+						break;
+
+					default :
+						if( !owned.empty() )
+						{
+							int								other = random() % THREADS;
+							std::lock_guard<std::mutex>		lock( handOffLocks[other] );
+
+							handedOff[other].push_back( owned.back() );
+							owned.pop_back();
+						}
+						break;
+				}
+
+				if( iteration % 64 == 0 )
+				{
+					std::vector<Node*>		received;
+
+					{
+						std::lock_guard<std::mutex>		lock( handOffLocks[thread] );
+
+						received.swap( handedOff[thread] );
+					}
+
+					for( Node* node : received )
+					{
+						if( node->m_owner < 0 || node->m_owner >= THREADS )
+						{
+							failures++;
+						}
+
+						pool.free( node );
+					}
+				}
+			}
+
+			std::lock_guard<std::mutex>		lock( handOffLocks[thread] );
+
+			handedOff[thread].insert( handedOff[thread].end(), owned.begin(), owned.end() );
+		});
+	}
+
+	for( std::thread& thread : threads )
+	{
+		thread.join();
+	}
+
+	BOOST_REQUIRE_EQUAL( failures.load(), 0 );
+
+	std::set<Node*>		remaining;
+
+	for( std::vector<Node*>& nodes : handedOff )
+	{
+		remaining.insert( nodes.begin(), nodes.end() );
+	}
+
+	BOOST_CHECK_EQUAL( pool.size(), remaining.size() );
+	BOOST_CHECK_EQUAL( liveNodes.load(), (int)remaining.size() );
+
+	std::set<Node*>		iterated;
+
+	for( NodePool::iterator itrNode = pool.begin(); itrNode != pool.end(); ++itrNode )
+	{
+		iterated.insert( &*itrNode );
+	}
+
+	BOOST_CHECK( iterated == remaining );
+}
@@ -0,0 +1,257 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+
+
+#define BOOST_TEST_MODULE ConcurrentSparseVectorTest
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <boost/test/included/unit_test.hpp>
+
+#include "Utility/ConcurrentSparseVector.h"
+
+
+
+using namespace SEFUtility;
+
+
+struct Counter
+{
+	Counter( size_t		index )
+		: m_index( index ),
+		  m_hits( 0 )
+	{}
+
+	Counter( const Counter&		counterToCopy )
+		: m_index( counterToCopy.m_index ),
+		  m_hits( counterToCopy.m_hits.load() )
+	{}
+
+	size_t				index() const
+	{
+		return( m_index );
+	}
+
+	size_t				m_index;
+	std::atomic<int>	m_hits;
+};
+
+
+const int		THREADS = 8;
+const int		ITERATIONS = 2000;
+const size_t	INDICES = 300;
+
+
+
+//	The threads add overlapping indices concurrently, so every index is raced for by several threads.
+//		Boost.Test assertions are not thread safe, so the threads count what they find wrong.
+
+BOOST_AUTO_TEST_CASE( ConcurrentAddsCreateEachIndexOnce )
+{
+	for( int round = 0; round < 20; round++ )
+	{
+		ConcurrentSparseVector<Counter, 8>		vector;
+		std::atomic<int>						failures( 0 );
+		std::vector<std::thread>				threads;
+
+		for( int thread = 0; thread < THREADS; thread++ )
+		{
+			threads.emplace_back( [&vector, &failures, thread]
+			{
+				for( int iteration = 0; iteration < ITERATIONS; iteration++ )
+				{
+					size_t		index = ( iteration * 7 + thread ) % INDICES;
+					Counter&	counter = vector.find_or_add( index );
+
+					if(( counter.index() != index ) || ( vector.find( index ) != &counter ))
+					{
+						failures++;
+					}
+
+					counter.m_hits++;
+				}
+			});
+		}
+
+		for( std::thread& thread : threads )
+		{
+			thread.join();
+		}
+
+		BOOST_REQUIRE_EQUAL( failures.load(), 0 );
+		BOOST_REQUIRE_EQUAL( vector.size(), INDICES );
+
+		std::set<size_t>		seen;
+		int						hits = 0;
+
+		vector.for_each( [&seen, &hits]( Counter&	counter )
+		{
+			seen.insert( counter.index() );
+			hits += counter.m_hits;
+		});
+
+		BOOST_CHECK_EQUAL( seen.size(), INDICES );
+		BOOST_CHECK_EQUAL( hits, THREADS * ITERATIONS );
+	}
+}
+
+
+
+BOOST_AUTO_TEST_CASE( SingleThreadMatchesMap )
+{
+	ConcurrentSparseVector<Counter, 16>		vector;
+	std::map<size_t, int>					reference;
+
+	for( size_t i = 0; i < 5000; i++ )
+	{
+		size_t		index = ( i * 7919 ) % 1000;
+
+		vector.find_or_add( index ).m_hits++;
+		reference[index]++;
+
+		BOOST_REQUIRE_EQUAL( vector.size(), reference.size() );
+		BOOST_REQUIRE( vector.find( index + 1000 ) == NULL );
+	}
+
+	for( const auto& entry : reference )
+	{
+		BOOST_REQUIRE( vector.find( entry.first ) != NULL );
+		BOOST_CHECK_EQUAL( vector[entry.first].m_hits.load(), entry.second );
+	}
+
+	std::map<size_t, int>		visited;
+
+	for( auto itrEntry = vector.begin(); itrEntry != vector.end(); ++itrEntry )
+	{
+		visited[(*itrEntry)->index()] += (*itrEntry)->m_hits;
+	}
+
+	BOOST_CHECK( visited == reference );
+}
+
+
+
+//	Throws from the constructor for index 42 while throwsLeft is positive, after a pause so other threads
+//		can find the slot claimed and start waiting on it.
+
+std::atomic<int>		throwsLeft( 0 );
+
+struct Thrower : public SparseVectorEntry
+{
+	Thrower( size_t		index )
+		: SparseVectorEntry( index )
+	{
+		if(( index == 42 ) && ( throwsLeft.fetch_sub( 1 ) > 0 ))
+		{
+			std::this_thread::sleep_for( std::chrono::milliseconds( 20 ));
+
+			throw std::runtime_error( "no entry for 42" );
+		}
+	}
+};
+
+
+BOOST_AUTO_TEST_CASE( ThrowingConstructorLeavesIndexAddable )
+{
+	ConcurrentSparseVector<Thrower, 8>		vector;
+
+	vector.find_or_add( 1 );
+
+	throwsLeft = 1;
+
+	BOOST_CHECK_THROW( vector.find_or_add( 42 ), std::runtime_error );
+
+	//	The failed slot holds no entry and is skipped by searches and iteration
+
+	BOOST_CHECK( vector.find( 42 ) == NULL );
+	BOOST_CHECK_EQUAL( vector.size(), 1 );
+
+	Thrower&	entry = vector.find_or_add( 42 );
+
+	BOOST_CHECK_EQUAL( entry.index(), 42 );
+	BOOST_CHECK_EQUAL( vector.find( 42 ), &entry );
+	BOOST_CHECK_EQUAL( vector.find( 1 )->index(), 1 );
+	BOOST_CHECK_EQUAL( vector.size(), 2 );
+
+	size_t		visited = 0;
+
+	vector.for_each( [&visited]( Thrower& ) { visited++; } );
+
+	BOOST_CHECK_EQUAL( visited, 2 );
+}
+
+
+BOOST_AUTO_TEST_CASE( WaitersSeeAFailedConstruction )
+{
+	//	Before the fix the waiters spun forever on a slot whose constructor had thrown
+
+	for( int round = 0; round < 10; round++ )
+	{
+		ConcurrentSparseVector<Thrower, 8>		vector;
+		std::atomic<int>						thrown( 0 );
+		std::atomic<int>						added( 0 );
+		std::vector<std::thread>				threads;
+
+		throwsLeft = 1;
+
+		for( int thread = 0; thread < 4; thread++ )
+		{
+			threads.emplace_back( [&, thread]
+			{
+				std::this_thread::sleep_for( std::chrono::milliseconds( thread * 5 ));
+
+				try
+				{
+					added += ( vector.find_or_add( 42 ).index() == 42 );
+				}
+				catch( const std::runtime_error& )
+				{
+					thrown++;
+				}
+			});
+		}
+
+		for( std::thread& thread : threads )
+		{
+			thread.join();
+		}
+
+		BOOST_CHECK_EQUAL( thrown.load(), 1 );
+		BOOST_CHECK_EQUAL( added.load(), 3 );
+		BOOST_CHECK_EQUAL( vector.size(), 1 );
+		BOOST_REQUIRE( vector.find( 42 ) != NULL );
+	}
+}
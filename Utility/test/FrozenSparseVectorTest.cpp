@@ -0,0 +1,230 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+#define BOOST_TEST_MODULE FrozenSparseVectorTest
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <boost/test/included/unit_test.hpp>
+
+#include "Utility/FrozenSparseVector.h"
+
+
+
+using namespace SEFUtility;
+
+
+struct Entry : public SparseVectorEntry
+{
+	Entry( size_t		index )
+		: SparseVectorEntry( index ),
+		  m_value( 0 )
+	{}
+
+	bool		operator==( const Entry&		other ) const
+	{
+		return(( index() == other.index() ) && ( m_value == other.m_value ));
+	}
+
+	double		m_value;
+};
+
+
+//	The index sits between payload members, so the payload is split around it
+
+struct Leading
+{
+	Leading()
+		: m_flag( 0 )
+	{}
+
+	char		m_flag;
+};
+
+struct CompactEntry : public Leading, public BasicSparseVectorEntry<uint32_t>
+{
+	CompactEntry( uint32_t		index )
+		: BasicSparseVectorEntry<uint32_t>( index ),
+		  m_count( 0 )
+	{}
+
+	bool		operator==( const CompactEntry&		other ) const
+	{
+		return(( index() == other.index() ) && ( m_flag == other.m_flag ) && ( m_count == other.m_count ));
+	}
+
+	uint32_t		m_count;
+};
+
+
+
+//	Every way of reading the frozen vector yields the reference's entries in index order
+
+template<class T, class IndexType>
+static void		checkAgainst( const FrozenSparseVector<T, IndexType>&		frozen,
+							  const std::map<IndexType, T>&					reference )
+{
+	BOOST_REQUIRE_EQUAL( frozen.size(), reference.size() );
+
+	std::vector<T>		expected;
+
+	for( const auto& entry : reference )
+	{
+		expected.push_back( entry.second );
+	}
+
+	std::vector<T>		fromIterator;
+	std::vector<T>		fromForEach;
+	std::vector<T>		fromChunks;
+
+	for( auto itrEntry = frozen.begin(); itrEntry != frozen.end(); ++itrEntry )
+	{
+		fromIterator.push_back( **itrEntry );
+	}
+
+	frozen.for_each( [&]( const T&		entry ) { fromForEach.push_back( entry ); } );
+
+	frozen.for_each_chunk( [&]( const IndexType*		indices,
+								const T*				entries,
+								size_t					count )
+	{
+		for( size_t i = 0; i < count; i++ )
+		{
+			BOOST_REQUIRE_EQUAL( indices[i], entries[i].index() );
+
+			fromChunks.push_back( entries[i] );
+		}
+	});
+
+	BOOST_CHECK( fromIterator == expected );
+	BOOST_CHECK( fromForEach == expected );
+	BOOST_CHECK( fromChunks == expected );
+
+	for( const auto& referenceEntry : reference )
+	{
+		T		entry( 0 );
+
+		BOOST_REQUIRE( frozen.find( referenceEntry.first, entry ) );
+		BOOST_CHECK( entry == referenceEntry.second );
+		BOOST_CHECK( frozen[referenceEntry.first] == referenceEntry.second );
+
+		BOOST_CHECK( !frozen.contains( referenceEntry.first + 1 ) || reference.count( referenceEntry.first + 1 ) );
+	}
+}
+
+
+
+BOOST_AUTO_TEST_CASE( FreezeFromEveryTier )
+{
+	std::mt19937		random( 1 );
+
+	//	Sizes and spreads that leave the live vector inline, in the hash table and in the dense tier, and
+	//		spreads that need each width of offset within a block
+
+	size_t		cases[][2] = { { 0, 10 }, { 5, 100 }, { 300, 1000 }, { 300, 100000 }, { 1000, 50000000 }, { 1000, (size_t)1 << 40 } };
+
+	for( auto& testCase : cases )
+	{
+		SparseVector<Entry, 8>			vector;
+		std::map<size_t, Entry>			reference;
+
+		while( reference.size() < testCase[0] )
+		{
+			size_t		index = ( (size_t)random() << 20 ^ random() ) % testCase[1];
+
+			vector.find_or_add( index ).m_value = (double)index / 3;
+
+			Entry		entry( index );
+
+			entry.m_value = (double)index / 3;
+			reference.emplace( index, entry );
+		}
+
+		FrozenSparseVector<Entry>		frozen = freeze( vector );
+
+		BOOST_CHECK( vector.empty() );
+
+		checkAgainst( frozen, reference );
+
+		Entry		missing( 0 );
+
+		BOOST_CHECK( !frozen.find( testCase[1], missing ));
+		BOOST_CHECK( !frozen.contains( testCase[1] ));
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE( PayloadAroundTheIndexSurvives )
+{
+	SparseVector<CompactEntry, 8>			vector;
+	std::map<uint32_t, CompactEntry>		reference;
+
+	for( uint32_t i = 0; i < 1000; i++ )
+	{
+		CompactEntry&	entry = vector.find_or_add( i * 37 );
+
+		entry.m_flag = (char)( i % 100 );
+		entry.m_count = i * 3;
+
+		reference.emplace( i * 37, entry );
+	}
+
+	FrozenSparseVector<CompactEntry>		frozen = freeze( vector );
+
+	checkAgainst( frozen, reference );
+}
+
+
+BOOST_AUTO_TEST_CASE( FrozenFormIsSmallerThanTheEntries )
+{
+	//	The index is stored once, encoded, rather than in every entry.  Offsets up to 381 within a block
+	//		take two bytes each.
+
+	SparseVector<Entry, 8>		vector;
+
+	for( size_t i = 0; i < 100000; i++ )
+	{
+		vector.find_or_add( i * 3 );
+	}
+
+	FrozenSparseVector<Entry>		frozen = freeze( vector );
+
+	BOOST_CHECK_EQUAL( frozen.size(), 100000 );
+	BOOST_CHECK( frozen.memoryUsed() < frozen.size() * ( sizeof( double ) + 3 ));
+	BOOST_CHECK( frozen.memoryUsed() * 3 < frozen.size() * sizeof( Entry ) * 2 );
+
+	//	A moved frozen vector is left empty
+
+	FrozenSparseVector<Entry>		moved( std::move( frozen ));
+
+	BOOST_CHECK_EQUAL( moved.size(), 100000 );
+	BOOST_CHECK( frozen.empty() );
+	BOOST_CHECK( frozen.begin() == frozen.end() );
+}
@@ -0,0 +1,412 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+
+
+#define BOOST_TEST_MODULE ObjectPoolBenchmark
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/test/included/unit_test.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+#include "Utility/BitmapObjectPool.h"
+#include "Utility/ObjectPool.h"
+
+
+
+//
+//	Timings for the object pools against the allocator and the behaviour they replaced.  Each case prints
+//		its baseline and measured figures and checks that both sides did the same work.  Build with -O2
+//		for useful numbers.
+//
+
+
+using namespace SEFUtility;
+
+
+struct Payload : public ObjectPoolable<Payload>
+{
+	Payload( uint64_t		value )
+		: m_value( value )
+	{}
+
+	uint64_t		m_value;
+	uint64_t		m_padding[5];
+};
+
+
+const unsigned int		CHUNK_SIZE = 1024;
+
+typedef ObjectPoolManager<Payload, CHUNK_SIZE>		PayloadPoolManager;
+typedef PayloadPoolManager::ObjectCollection		PayloadPool;
+
+
+template<class Operation>
+static double		nanosecondsPer( size_t			operations,
+									Operation		operation )
+{
+	std::chrono::steady_clock::time_point		start = std::chrono::steady_clock::now();
+
+	operation();
+
+	return( std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count() / operations );
+}
+
+
+//	One line per measurement: the size, the baseline and measured figures, and the ratio between them
+
+static void			report( const char*		name,
+							size_t			size,
+							double			baseline,
+							double			measured )
+{
+	std::cout << std::left << std::setw( 44 ) << name << std::right << std::setw( 10 ) << size
+			  << std::fixed << std::setprecision( 2 ) << std::setw( 12 ) << baseline << std::setw( 12 ) << measured
+			  << std::setw( 10 ) << baseline / measured << "x" << std::endl;
+}
+
+
+
+BOOST_AUTO_TEST_CASE( ChurnSteadyState )
+{
+	//	A working set of live objects, each churn step frees one and allocates a replacement.  Time is
+	//		compared with new and delete, memory with the pool before free() recycled slots, which kept
+	//		every slot ever handed out until reset().  The slots held are read from chunkSpans().
+
+	const size_t		CHURN = 2000000;
+
+	for( size_t workingSetSize : { 1000, 10000, 100000 } )
+	{
+		std::vector<Payload*>		heapObjects;
+		uint64_t					heapSum = 0;
+
+		for( size_t i = 0; i < workingSetSize; i++ )
+		{
+			heapObjects.push_back( new Payload( i ) );
+		}
+
+		double		heap = nanosecondsPer( CHURN, [&]()
+		{
+			for( size_t step = 0; step < CHURN; step++ )
+			{
+				size_t		victim = ( step * 7919 ) % workingSetSize;
+
+				heapSum += heapObjects[victim]->m_value;
+
+				delete heapObjects[victim];
+				heapObjects[victim] = new Payload( step );
+			}
+		});
+
+		for( Payload* object : heapObjects )
+		{
+			delete object;
+		}
+
+		PayloadPoolManager				manager;
+		std::unique_ptr<PayloadPool>	pool = manager.getPool();
+		std::vector<Payload*>			poolObjects;
+		uint64_t						poolSum = 0;
+
+		for( size_t i = 0; i < workingSetSize; i++ )
+		{
+			poolObjects.push_back( pool->newObject( i ) );
+		}
+
+		double		pooled = nanosecondsPer( CHURN, [&]()
+		{
+			for( size_t step = 0; step < CHURN; step++ )
+			{
+				size_t		victim = ( step * 7919 ) % workingSetSize;
+
+				poolSum += poolObjects[victim]->m_value;
+
+				pool->free( poolObjects[victim] );
+				poolObjects[victim] = pool->newObject( step );
+			}
+		});
+
+		BOOST_CHECK_EQUAL( heapSum, poolSum );
+		BOOST_CHECK_EQUAL( pool->size(), workingSetSize );
+
+		size_t		slotsHeld = 0;
+
+		for( const PayloadPool::ChunkSpan& span : pool->chunkSpans() )
+		{
+			slotsHeld += span.second;
+		}
+
+		//	Without recycling every churn step took a fresh slot
+
+		size_t		slotsWithoutReuse = workingSetSize + CHURN;
+
+		report( "churn ns: new+delete / pool", workingSetSize, heap, pooled );
+		report( "churn MB held: no reuse / reuse", workingSetSize, slotsWithoutReuse * sizeof( Payload ) / 1048576.0, slotsHeld * sizeof( Payload ) / 1048576.0 );
+
+		manager.returnPool( pool );
+	}
+}
+
+
+
+
+//	Thread counts from one up to the hardware's, doubling
+
+static std::vector<size_t>		threadCounts()
+{
+	size_t					hardware = std::max( std::thread::hardware_concurrency(), 1u );
+	std::vector<size_t>		counts;
+
+	for( size_t threads = 1; threads < hardware; threads *= 2 )
+	{
+		counts.push_back( threads );
+	}
+
+	counts.push_back( hardware );
+
+	return( counts );
+}
+
+template<class Work>
+static double		nanosecondsPerOnThreads( size_t		threads,
+											 size_t		operations,
+											 Work		work )
+{
+	return( nanosecondsPer( operations, [&]()
+	{
+		std::vector<std::thread>		workers;
+
+		for( size_t thread = 0; thread < threads; thread++ )
+		{
+			workers.emplace_back( work, thread );
+		}
+
+		for( std::thread& worker : workers )
+		{
+			worker.join();
+		}
+	}));
+}
+
+
+//	The manager as it was, a list of ready pools every thread shares behind one mutex
+
+class LockedPoolManager
+{
+public :
+
+	std::unique_ptr<PayloadPool>		getPool()
+	{
+		std::lock_guard<std::mutex>		guard( m_lock );
+
+		if( m_readyPools.empty() )
+		{
+			return( m_factory.getPool() );
+		}
+
+		std::unique_ptr<PayloadPool>		pool = std::move( m_readyPools.back() );
+
+		m_readyPools.pop_back();
+
+		return( pool );
+	}
+
+	void								returnPool( std::unique_ptr<PayloadPool>&		poolToCheckin )
+	{
+		poolToCheckin->reset();
+
+		std::lock_guard<std::mutex>		guard( m_lock );
+
+		m_readyPools.push_back( std::move( poolToCheckin ) );
+	}
+
+private :
+
+	//	Only used to construct pools, which the pool keeps to its manager
+
+	PayloadPoolManager							m_factory;
+
+	std::mutex									m_lock;
+	std::vector<std::unique_ptr<PayloadPool>>	m_readyPools;
+};
+
+
+BOOST_AUTO_TEST_CASE( ManagerContention )
+{
+	//	Every thread checks a pool out, allocates a few objects in it and checks it back in, as a worker
+	//		would per request.  Nanoseconds are per check out and in across all threads.
+
+	const size_t		REQUESTS_PER_THREAD = 500000;
+	const size_t		OBJECTS_PER_REQUEST = 4;
+
+	for( size_t threads : threadCounts() )
+	{
+		size_t					requests = threads * REQUESTS_PER_THREAD;
+
+		LockedPoolManager		lockedManager;
+		PayloadPoolManager		manager;
+		std::atomic<uint64_t>	lockedObjects( 0 );
+		std::atomic<uint64_t>	managedObjects( 0 );
+
+		double		locked = nanosecondsPerOnThreads( threads, requests, [&]( size_t )
+		{
+			uint64_t		objects = 0;
+
+			for( size_t request = 0; request < REQUESTS_PER_THREAD; request++ )
+			{
+				std::unique_ptr<PayloadPool>		pool = lockedManager.getPool();
+
+				for( size_t i = 0; i < OBJECTS_PER_REQUEST; i++ )
+				{
+					pool->newObject( request );
+				}
+
+				objects += pool->size();
+
+				lockedManager.returnPool( pool );
+			}
+
+			lockedObjects += objects;
+		});
+
+		double		managed = nanosecondsPerOnThreads( threads, requests, [&]( size_t )
+		{
+			uint64_t		objects = 0;
+
+			for( size_t request = 0; request < REQUESTS_PER_THREAD; request++ )
+			{
+				ObjectPoolHolder<PayloadPoolManager>		holder( manager );
+
+				for( size_t i = 0; i < OBJECTS_PER_REQUEST; i++ )
+				{
+					holder.getPool().newObject( request );
+				}
+
+				objects += holder.getPool().size();
+			}
+
+			managedObjects += objects;
+		});
+
+		BOOST_CHECK_EQUAL( lockedObjects.load(), requests * OBJECTS_PER_REQUEST );
+		BOOST_CHECK_EQUAL( managedObjects.load(), requests * OBJECTS_PER_REQUEST );
+
+		report( "pool check out+in threads: mutex / manager", threads, locked, managed );
+	}
+}
+
+
+
+
+//	Sums a pool holding objects with every fourth freed, first serially through the pool's iterator and then
+//		with tbb::parallel_for over chunkSpans() and for_each_in() on each thread count.  The size column is
+//		the thread count, nanoseconds are per object held.
+
+template<class Manager>
+static void			benchmarkSpanScan( const char*		name,
+									   size_t			objects )
+{
+	typedef typename Manager::ObjectCollection		Pool;
+
+	Manager						manager;
+	std::unique_ptr<Pool>		pool = manager.getPool();
+	std::vector<Payload*>		created;
+
+	for( size_t i = 0; i < objects; i++ )
+	{
+		created.push_back( pool->newObject( i ) );
+	}
+
+	for( size_t i = 0; i < objects; i += 4 )
+	{
+		pool->free( created[i] );
+	}
+
+	uint64_t		serialSum = 0;
+
+	double		serial = nanosecondsPer( pool->size(), [&]()
+	{
+		for( Payload& payload : *pool )
+		{
+			serialSum += payload.m_value;
+		}
+	});
+
+	std::vector<typename Pool::ChunkSpan>		spans = pool->chunkSpans();
+
+	for( size_t threads : threadCounts() )
+	{
+		tbb::task_arena				arena( (int)threads );
+		std::atomic<uint64_t>		parallelSum( 0 );
+
+		double		parallel = nanosecondsPer( pool->size(), [&]()
+		{
+			arena.execute( [&]()
+			{
+				tbb::parallel_for( tbb::blocked_range<size_t>( 0, spans.size() ), [&]( const tbb::blocked_range<size_t>&		range )
+				{
+					uint64_t		sum = 0;
+
+					for( size_t span = range.begin(); span != range.end(); span++ )
+					{
+						pool->for_each_in( spans[span], [&sum]( Payload&		payload ) { sum += payload.m_value; } );
+					}
+
+					parallelSum += sum;
+				});
+			});
+		});
+
+		BOOST_CHECK_EQUAL( parallelSum.load(), serialSum );
+
+		report( name, threads, serial, parallel );
+	}
+
+	manager.returnPool( pool );
+}
+
+BOOST_AUTO_TEST_CASE( ParallelSpanScaling )
+{
+	const size_t		OBJECTS = 1000000;
+
+	benchmarkSpanScan<PayloadPoolManager>( "1M scan threads: iterator / spans", OBJECTS );
+	benchmarkSpanScan<ObjectPoolManager<Payload, CHUNK_SIZE, BitmapObjectPool<Payload, CHUNK_SIZE>>>( "1M bitmap scan threads: iterator / spans", OBJECTS );
+}
@@ -0,0 +1,146 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+
+
+#define BOOST_TEST_MODULE ObjectPoolManagerTest
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <boost/test/included/unit_test.hpp>
+
+#include "Utility/ObjectPool.h"
+
+
+
+using namespace SEFUtility;
+
+
+struct Node : public ObjectPoolable<Node>
+{
+	Node( int		owner )
+		: m_owner( owner )
+	{}
+
+	int		m_owner;
+};
+
+
+typedef ObjectPoolManager<Node, 32>		NodePoolManager;
+
+
+const int		THREADS = 8;
+const int		ITERATIONS = 10000;
+
+
+
+BOOST_AUTO_TEST_CASE( ReturnedPoolIsReusedEmpty )
+{
+	NodePoolManager		manager;
+
+	std::unique_ptr<NodePoolManager::ObjectCollection>		pool = manager.getPool();
+	NodePoolManager::ObjectCollection*						returned = pool.get();
+
+	pool->newObject( 1 );
+
+	manager.returnPool( pool );
+
+	BOOST_CHECK( !pool );
+
+	pool = manager.getPool();
+
+	BOOST_CHECK_EQUAL( pool.get(), returned );
+	BOOST_CHECK_EQUAL( pool->size(), 0 );
+}
+
+
+//	Each thread checks out more pools than its cache holds, so pools pass through the shared depot, and
+//		checks that no other thread is filling a pool it holds.  Boost.Test assertions are not thread
+//		safe, so the threads count what they find wrong and the test checks the count.
+
+BOOST_AUTO_TEST_CASE( PoolsAreNeverSharedBetweenThreads )
+{
+	NodePoolManager				manager;
+	std::atomic<int>			failures( 0 );
+	std::vector<std::thread>	threads;
+
+	for( int thread = 0; thread < THREADS; thread++ )
+	{
+		threads.emplace_back( [&manager, &failures, thread]
+		{
+			for( int iteration = 0; iteration < ITERATIONS; iteration++ )
+			{
+				std::vector<std::unique_ptr<NodePoolManager::ObjectCollection>>		held;
+
+				for( int i = 0; i < 1 + iteration % 9; i++ )
+				{
+					held.push_back( manager.getPool() );
+
+					if( held.back()->size() != 0 )
+					{
+						failures++;
+					}
+
+					for( int j = 0; j < 3; j++ )
+					{
+						held.back()->newObject( thread );
+					}
+				}
+
+				for( std::unique_ptr<NodePoolManager::ObjectCollection>& pool : held )
+				{
+					if( pool->size() != 3 )
+					{
+						failures++;
+					}
+
+					for( Node& node : *pool )
+					{
+						if( node.m_owner != thread )
+						{
+							failures++;
+						}
+					}
+
+					manager.returnPool( pool );
+				}
+			}
+		});
+	}
+
+	for( std::thread& thread : threads )
+	{
+		thread.join();
+	}
+
+	BOOST_CHECK_EQUAL( failures.load(), 0 );
+}
@@ -0,0 +1,367 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+
+
+#define BOOST_TEST_MODULE ObjectPoolTest
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/test/included/unit_test.hpp>
+
+#include "Utility/BitmapObjectPool.h"
+#include "Utility/ObjectPool.h"
+
+
+
+using namespace SEFUtility;
+
+
+//	Counts the live instances and holds a string too long to be stored inline, so an object the pool
+//		forgets to destroy shows up both in the count and as a leak under a sanitizer.  A negative key
+//		makes the constructor throw.
+
+struct Tracked : public ObjectPoolable<Tracked>
+{
+	Tracked( int		key,
+			 int&		liveCount )
+		: m_key( key ),
+		  m_payload( std::string( 40, 'a' + key % 26 ) ),
+		  m_liveCount( liveCount )
+	{
+		if( key < 0 )
+		{
+			throw std::invalid_argument( "negative key" );
+		}
+
+		m_liveCount++;
+	}
+
+	~Tracked()
+	{
+		m_liveCount--;
+	}
+
+	int				m_key;
+	std::string		m_payload;
+	int&			m_liveCount;
+};
+
+
+const unsigned int		CHUNK_SIZE = 64;
+
+typedef ObjectPoolManager<Tracked, CHUNK_SIZE>		TrackedPoolManager;
+typedef TrackedPoolManager::ObjectCollection		TrackedPool;
+
+
+static size_t		slotsHeld( TrackedPool&		pool )
+{
+	size_t		slots = 0;
+
+	for( const TrackedPool::ChunkSpan& span : pool.chunkSpans() )
+	{
+		slots += span.second;
+	}
+
+	return( slots );
+}
+
+
+
+BOOST_AUTO_TEST_CASE( ChurnMatchesMap )
+{
+	//	Random news and frees against a map of key to payload, after every step the pool must hold exactly
+	//		the map's objects, in any order, and no others may be alive
+
+	TrackedPoolManager					manager;
+	std::unique_ptr<TrackedPool>		pool = manager.getPool();
+	int									liveCount = 0;
+
+	std::map<int, std::string>			reference;
+	std::map<int, Tracked*>				objects;
+	std::mt19937						random( 11 );
+
+	for( int step = 0; step < 20000; step++ )
+	{
+		int		key = random() % 500;
+
+		if( objects.count( key ) != 0 )
+		{
+			pool->free( objects[key] );
+			objects.erase( key );
+			reference.erase( key );
+		}
+		else
+		{
+			objects[key] = pool->newObject( key, liveCount );
+			reference[key] = objects[key]->m_payload;
+		}
+
+		if( step % 97 == 0 )
+		{
+			std::map<int, std::string>		found;
+
+			for( Tracked& object : *pool )
+			{
+				found[object.m_key] = object.m_payload;
+			}
+
+			BOOST_REQUIRE( found == reference );
+			BOOST_REQUIRE_EQUAL( pool->size(), reference.size() );
+			BOOST_REQUIRE_EQUAL( liveCount, (int)reference.size() );
+		}
+	}
+
+	manager.returnPool( pool );
+
+	BOOST_CHECK_EQUAL( liveCount, 0 );
+}
+
+
+BOOST_AUTO_TEST_CASE( FreedSlotsAreReused )
+{
+	//	A steady working set of 200 objects churned many times over never needs more slots than the
+	//		working set plus the two markers, rounded up to whole chunks
+
+	TrackedPoolManager					manager;
+	std::unique_ptr<TrackedPool>		pool = manager.getPool();
+	int									liveCount = 0;
+	std::vector<Tracked*>				workingSet;
+
+	for( int key = 0; key < 200; key++ )
+	{
+		workingSet.push_back( pool->newObject( key, liveCount ) );
+	}
+
+	size_t		slotsBeforeChurn = slotsHeld( *pool );
+
+	for( int step = 0; step < 100000; step++ )
+	{
+		size_t		victim = ( step * 7919 ) % workingSet.size();
+
+		pool->free( workingSet[victim] );
+		workingSet[victim] = pool->newObject( step, liveCount );
+	}
+
+	BOOST_CHECK_EQUAL( slotsHeld( *pool ), slotsBeforeChurn );
+	BOOST_CHECK( slotsBeforeChurn <= ( 200 + 2 + CHUNK_SIZE - 1 ) / CHUNK_SIZE * CHUNK_SIZE );
+	BOOST_CHECK_EQUAL( pool->size(), 200 );
+	BOOST_CHECK_EQUAL( liveCount, 200 );
+
+	manager.returnPool( pool );
+}
+
+
+BOOST_AUTO_TEST_CASE( ResetAndDestructionDestroyLiveObjects )
+{
+	int		liveCount = 0;
+
+	{
+		TrackedPoolManager					manager;
+		std::unique_ptr<TrackedPool>		pool = manager.getPool();
+
+		for( int key = 0; key < 300; key++ )
+		{
+			Tracked*		object = pool->newObject( key, liveCount );
+
+			if( key % 3 == 0 )
+			{
+				pool->free( object );
+			}
+		}
+
+		BOOST_CHECK_EQUAL( liveCount, 200 );
+
+		//	Returning the pool resets it
+
+		manager.returnPool( pool );
+
+		BOOST_CHECK_EQUAL( liveCount, 0 );
+
+		//	The reset pool is reused empty, then destroyed still holding objects
+
+		pool = manager.getPool();
+
+		BOOST_CHECK_EQUAL( pool->size(), 0 );
+
+		for( int key = 0; key < 150; key++ )
+		{
+			pool->newObject( key, liveCount );
+		}
+
+		BOOST_CHECK_EQUAL( liveCount, 150 );
+	}
+
+	BOOST_CHECK_EQUAL( liveCount, 0 );
+}
+
+
+
+BOOST_AUTO_TEST_CASE( ThrowingConstructorReturnsSlot )
+{
+	typedef ObjectPoolManager<Tracked, CHUNK_SIZE, BitmapObjectPool<Tracked, CHUNK_SIZE>>		BitmapPoolManager;
+	typedef BitmapPoolManager::ObjectCollection												BitmapPool;
+
+	BitmapPoolManager				manager;
+	std::unique_ptr<BitmapPool>		pool = manager.getPool();
+	int								liveCount = 0;
+
+	//	A fresh slot taken from the chunk goes back on the free list and is the next one handed out
+
+	Tracked*		first = pool->newObject( 1, liveCount );
+
+	BOOST_CHECK_THROW( pool->newObject( -1, liveCount ), std::invalid_argument );
+
+	Tracked*		second = pool->newObject( 2, liveCount );
+
+	BOOST_CHECK( second == first + 1 );
+
+	//	So does a slot taken from the free list
+
+	pool->free( first );
+
+	BOOST_CHECK_THROW( pool->newObject( -1, liveCount ), std::invalid_argument );
+
+	Tracked*		third = pool->newObject( 3, liveCount );
+
+	BOOST_CHECK( third == first );
+
+	//	Many failures neither grow the pool nor leave occupied slots behind
+
+	for( int i = 0; i < 1000; i++ )
+	{
+		BOOST_CHECK_THROW( pool->newObject( -1, liveCount ), std::invalid_argument );
+	}
+
+	BOOST_CHECK( pool->newObject( 4, liveCount ) == second + 1 );
+
+	std::vector<int>		keys;
+
+	for( const BitmapPool::ChunkSpan& span : pool->chunkSpans() )
+	{
+		pool->for_each_in( span, [&keys]( Tracked&		object )
+		{
+			keys.push_back( object.m_key );
+		});
+	}
+
+	std::sort( keys.begin(), keys.end() );
+
+	BOOST_CHECK( keys == std::vector<int>( { 2, 3, 4 } ));
+	BOOST_CHECK_EQUAL( pool->size(), 3 );
+	BOOST_CHECK_EQUAL( liveCount, 3 );
+
+	manager.returnPool( pool );
+
+	BOOST_CHECK_EQUAL( liveCount, 0 );
+}
+
+
+
+//	Cuts every span from chunkSpans() into pieces of assorted lengths, some within a bitmap word and some
+//		across several, and checks that for_each_in() over the pieces visits each live object exactly once
+//		and that isLive() agrees with the map of live keys for every slot.
+
+template<class Manager>
+static void			splitSpansVisitLiveObjectsOnce()
+{
+	typedef typename Manager::ObjectCollection		Pool;
+
+	Manager						manager;
+	std::unique_ptr<Pool>		pool = manager.getPool();
+	int							liveCount = 0;
+	std::map<int, Tracked*>		reference;
+
+	for( int key = 0; key < 1000; key++ )
+	{
+		reference[key] = pool->newObject( key, liveCount );
+	}
+
+	for( int key = 0; key < 1000; key += 3 )
+	{
+		pool->free( reference[key] );
+		reference.erase( key );
+	}
+
+	const size_t				pieceLengths[] = { 1, 5, 64, 13, 130, 2, 63 };
+	size_t						nextPiece = 0;
+	std::map<int, int>			visits;
+	size_t						liveSlots = 0;
+
+	for( const typename Pool::ChunkSpan& span : pool->chunkSpans() )
+	{
+		for( size_t offset = 0; offset < span.second; )
+		{
+			size_t		length = std::min( pieceLengths[nextPiece++ % 7], span.second - offset );
+
+			pool->for_each_in( typename Pool::ChunkSpan( span.first + offset, length ), [&]( Tracked&		object )
+			{
+				visits[object.m_key]++;
+			});
+
+			for( size_t slot = offset; slot < offset + length; slot++ )
+			{
+				if( pool->isLive( span.first + slot ))
+				{
+					liveSlots++;
+
+					BOOST_REQUIRE( reference.count( span.first[slot].m_key ) != 0 );
+					BOOST_REQUIRE_EQUAL( reference[span.first[slot].m_key], &span.first[slot] );
+				}
+			}
+
+			offset += length;
+		}
+	}
+
+	BOOST_CHECK_EQUAL( visits.size(), reference.size() );
+	BOOST_CHECK_EQUAL( liveSlots, reference.size() );
+
+	for( const std::pair<const int, int>& visit : visits )
+	{
+		BOOST_REQUIRE( reference.count( visit.first ) != 0 );
+		BOOST_REQUIRE_EQUAL( visit.second, 1 );
+	}
+
+	manager.returnPool( pool );
+
+	BOOST_CHECK_EQUAL( liveCount, 0 );
+}
+
+BOOST_AUTO_TEST_CASE( SplitSpansVisitLiveObjectsOnce )
+{
+	splitSpansVisitLiveObjectsOnce<ObjectPoolManager<Tracked, CHUNK_SIZE>>();
+	splitSpansVisitLiveObjectsOnce<ObjectPoolManager<Tracked, CHUNK_SIZE, BitmapObjectPool<Tracked, CHUNK_SIZE>>>();
+}
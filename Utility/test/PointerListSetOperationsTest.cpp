@@ -0,0 +1,191 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+
+
+#define BOOST_TEST_MODULE PointerListSetOperationsTest
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/test/included/unit_test.hpp>
+
+#include "Utility/SparseVector.h"
+#include "Utility/PointerListSetOperations.h"
+
+
+
+using namespace SEFUtility;
+
+
+struct Node
+{
+	double		m_value;
+};
+
+
+//	The inline tier holds up to CUTOVER_SIZE pointers without checking for duplicates, so the lists below
+//		are built with a pointer repeated while they are still inline.
+
+typedef SearchablePointerList<Node, 512>		NodeList;
+
+
+
+static std::vector<Node*>		intersectionOf( const NodeList&		first,
+												const NodeList&		second )
+{
+	const NodeList*				lists[] = { &first, &second };
+	std::vector<Node*>			result;
+
+	intersection_of( lists, 2, result );
+
+	std::sort( result.begin(), result.end() );
+
+	return( result );
+}
+
+
+
+BOOST_AUTO_TEST_CASE( DuplicateIsNotCountedAsAnotherList )
+{
+	Node			nodes[2];
+
+	NodeList		first;
+	NodeList		second;
+
+	first.insert( &nodes[0] );
+	first.insert( &nodes[0] );
+	second.insert( &nodes[1] );
+
+	BOOST_CHECK( intersectionOf( first, second ).empty() );
+}
+
+
+BOOST_AUTO_TEST_CASE( DuplicateIsReportedOnceFromSortedBuffer )
+{
+	Node			nodes[2];
+
+	NodeList		first;
+	NodeList		second;
+
+	first.insert( &nodes[0] );
+	first.insert( &nodes[0] );
+	first.insert( &nodes[1] );
+	second.insert( &nodes[0] );
+
+	std::vector<Node*>		result = intersectionOf( first, second );
+
+	BOOST_REQUIRE_EQUAL( result.size(), 1 );
+	BOOST_CHECK_EQUAL( result[0], &nodes[0] );
+}
+
+
+BOOST_AUTO_TEST_CASE( DuplicateIsReportedOnceWhenProbing )
+{
+	//	The first list is small but far apart in memory, so it is probed against the second, which is too
+	//		large for the sorted buffer or the bitmap.
+
+	std::vector<Node>		nodes( 20000 );
+
+	NodeList		first;
+	NodeList		second;
+
+	first.insert( &nodes[0] );
+	first.insert( &nodes[0] );
+	first.insert( &nodes[10000] );
+	first.insert( &nodes[19999] );
+
+	for( size_t i = 0; i < nodes.size(); i += 4 )
+	{
+		second.insert( &nodes[i] );
+	}
+
+	std::vector<Node*>		result = intersectionOf( first, second );
+
+	BOOST_REQUIRE_EQUAL( result.size(), 2 );
+	BOOST_CHECK_EQUAL( result[0], &nodes[0] );
+	BOOST_CHECK_EQUAL( result[1], &nodes[10000] );
+}
+
+
+BOOST_AUTO_TEST_CASE( DuplicateIsReportedOnceWhenProbingALargeList )
+{
+	//	Too many pointers in the first list to make them distinct on the stack, so the results are filtered.
+
+	std::vector<Node>		nodes( 20000 );
+
+	NodeList		first;
+	NodeList		second;
+
+	for( size_t i = 0; i < 300; i++ )
+	{
+		first.insert( &nodes[i * 8] );
+	}
+
+	first.insert( &nodes[0] );
+	first.insert( &nodes[8] );
+
+	for( size_t i = 0; i < nodes.size(); i += 2 )
+	{
+		second.insert( &nodes[i] );
+	}
+
+	std::vector<Node*>		result = intersectionOf( first, second );
+
+	BOOST_REQUIRE_EQUAL( result.size(), 300 );
+
+	for( size_t i = 0; i < 300; i++ )
+	{
+		BOOST_CHECK_EQUAL( result[i], &nodes[i * 8] );
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE( UnionReportsDuplicateOnce )
+{
+	Node			nodes[2];
+
+	NodeList		first;
+	NodeList		second;
+
+	first.insert( &nodes[0] );
+	first.insert( &nodes[0] );
+	second.insert( &nodes[1] );
+
+	const NodeList*			lists[] = { &first, &second };
+	std::vector<Node*>		result;
+
+	union_of( lists, 2, result );
+
+	std::sort( result.begin(), result.end() );
+
+	BOOST_REQUIRE_EQUAL( result.size(), 2 );
+	BOOST_CHECK_EQUAL( result[0], &nodes[0] );
+	BOOST_CHECK_EQUAL( result[1], &nodes[1] );
+}
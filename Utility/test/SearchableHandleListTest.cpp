@@ -0,0 +1,317 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+
+#define BOOST_TEST_MODULE SearchableHandleListTest
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <boost/test/included/unit_test.hpp>
+
+#include "Utility/ObjectPool.h"
+#include "Utility/SearchableHandleList.h"
+
+
+
+using namespace SEFUtility;
+
+
+struct Node : public ObjectPoolable<Node>
+{
+	Node( int		key = -1 )
+		: m_key( key )
+	{}
+
+	int		m_key;
+};
+
+
+//	Small chunks so a few hundred objects spread over many of them
+
+const unsigned int		CHUNK_SIZE = 16;
+
+typedef ObjectPoolManager<Node, CHUNK_SIZE>		NodePoolManager;
+typedef NodePoolManager::ObjectCollection		NodePool;
+
+typedef SearchableHandleList<NodePool>			HandleList;
+
+const size_t		CUTOVER_SIZE = DEFAULT_POINTER_LIST_CUTOVER_SIZE * 2;
+
+
+static std::vector<Node*>		newNodes( NodePool&		pool,
+										  size_t		count )
+{
+	std::vector<Node*>		nodes;
+
+	for( size_t i = 0; i < count; i++ )
+	{
+		nodes.push_back( pool.newObject( (int)i ));
+	}
+
+	return( nodes );
+}
+
+
+//	The list holds exactly the reference's nodes, by iteration, by for_each_chunk() and by contains().
+
+static void		checkAgainst( HandleList&					list,
+							  const std::set<Node*>&		reference )
+{
+	BOOST_REQUIRE_EQUAL( list.size(), reference.size() );
+	BOOST_CHECK_EQUAL( list.empty(), reference.empty() );
+
+	std::set<Node*>		iterated( list.begin(), list.end() );
+
+	BOOST_CHECK( iterated == reference );
+
+	std::set<Node*>		chunked;
+	size_t				chunkedCount = 0;
+
+	list.for_each_chunk( [&chunked, &chunkedCount]( Node* const*	entries, size_t		count )
+	{
+		chunked.insert( entries, entries + count );
+		chunkedCount += count;
+	} );
+
+	BOOST_CHECK_EQUAL( chunkedCount, reference.size() );
+	BOOST_CHECK( chunked == reference );
+
+	for( Node* node : reference )
+	{
+		BOOST_CHECK( list.contains( node ) );
+		BOOST_CHECK( list.find( node ) == node );
+	}
+}
+
+
+
+BOOST_AUTO_TEST_CASE( HandlesRoundTripAcrossChunks )
+{
+	NodePoolManager					manager;
+	std::unique_ptr<NodePool>		pool = manager.getPool();
+
+	std::vector<Node*>				nodes = newNodes( *pool, CHUNK_SIZE * 12 );
+	std::set<NodePool::handle_type>	handles;
+
+	for( Node* node : nodes )
+	{
+		NodePool::handle_type		handle = pool->handleOf( node );
+
+		BOOST_REQUIRE( handle != NodePool::INVALID_HANDLE );
+		BOOST_CHECK( pool->resolve( handle ) == node );
+
+		handles.insert( handle );
+	}
+
+	BOOST_CHECK_EQUAL( handles.size(), nodes.size() );
+
+	//	Freed slots are handed out again and keep their handles
+
+	for( size_t i = 0; i < nodes.size(); i += 3 )
+	{
+		pool->free( nodes[i] );
+		nodes[i] = pool->newObject( (int)i );
+	}
+
+	for( Node* node : nodes )
+	{
+		NodePool::handle_type		handle = pool->handleOf( node );
+
+		BOOST_REQUIRE( handle != NodePool::INVALID_HANDLE );
+		BOOST_CHECK( pool->resolve( handle ) == node );
+		BOOST_CHECK_EQUAL( pool->resolve( handle )->m_key, node->m_key );
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE( ForeignAndMisalignedPointersHaveNoHandle )
+{
+	NodePoolManager					manager;
+	std::unique_ptr<NodePool>		pool = manager.getPool();
+	std::unique_ptr<NodePool>		otherPool = manager.getPool();
+
+	std::vector<Node*>				nodes = newNodes( *pool, CHUNK_SIZE * 4 );
+	Node*							otherNode = otherPool->newObject( 1 );
+	Node							stackNode( 2 );
+	std::unique_ptr<Node>			heapNode( new Node( 3 ));
+
+	BOOST_CHECK( pool->handleOf( otherNode ) == NodePool::INVALID_HANDLE );
+	BOOST_CHECK( pool->handleOf( &stackNode ) == NodePool::INVALID_HANDLE );
+	BOOST_CHECK( pool->handleOf( heapNode.get() ) == NodePool::INVALID_HANDLE );
+	BOOST_CHECK( pool->handleOf( NULL ) == NodePool::INVALID_HANDLE );
+
+	//	Inside a chunk but not on a slot boundary
+
+	for( Node* node : nodes )
+	{
+		BOOST_CHECK( pool->handleOf( (const Node*)( (const char*)node + 1 )) == NodePool::INVALID_HANDLE );
+		BOOST_CHECK( pool->handleOf( (const Node*)( (const char*)node + sizeof( Node ) / 2 )) == NodePool::INVALID_HANDLE );
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE( ForeignPointersAreNeverContained )
+{
+	NodePoolManager					manager;
+	std::unique_ptr<NodePool>		pool = manager.getPool();
+	std::unique_ptr<NodePool>		otherPool = manager.getPool();
+
+	std::vector<Node*>				nodes = newNodes( *pool, CUTOVER_SIZE * 3 );
+	Node*							otherNode = otherPool->newObject( 1 );
+	Node							stackNode( 2 );
+	Node*							misaligned = (Node*)( (char*)nodes[0] + 1 );
+
+	HandleList						list( *pool );
+	std::set<Node*>					reference;
+
+	//	Once with the handles inline and once past the cutover
+
+	for( size_t count : { CUTOVER_SIZE / 2, nodes.size() } )
+	{
+		while( reference.size() < count )
+		{
+			list.insert( nodes[reference.size()] );
+			reference.insert( nodes[reference.size()] );
+		}
+
+		for( Node* foreign : { otherNode, &stackNode, misaligned } )
+		{
+			BOOST_CHECK( !list.contains( foreign ) );
+			BOOST_CHECK( list.find( foreign ) == NULL );
+
+			list.erase( foreign );
+		}
+
+		checkAgainst( list, reference );
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE( ChurnAcrossCutoverMatchesSet )
+{
+	NodePoolManager					manager;
+	std::unique_ptr<NodePool>		pool = manager.getPool();
+
+	std::vector<Node*>				nodes = newNodes( *pool, CUTOVER_SIZE * 4 );
+
+	HandleList						list( *pool );
+	std::set<Node*>					reference;
+	std::mt19937					random( 5 );
+
+	size_t							largest = 0;
+
+	//	Mostly inserts at first so the list crosses the cutover, then mostly erases
+
+	for( int step = 0; step < 4000; step++ )
+	{
+		Node*		node = nodes[random() % nodes.size()];
+		bool		inserting = ( step < 2000 ) ? ( random() % 4 != 0 ) : ( random() % 4 == 0 );
+
+		if( inserting )
+		{
+			if( reference.insert( node ).second )
+			{
+				list.insert( node );
+			}
+		}
+		else
+		{
+			list.erase( node );
+			reference.erase( node );
+		}
+
+		largest = std::max( largest, reference.size() );
+
+		BOOST_REQUIRE_EQUAL( list.size(), reference.size() );
+
+		Node*		probe = nodes[random() % nodes.size()];
+
+		BOOST_REQUIRE_EQUAL( list.contains( probe ), reference.count( probe ) == 1 );
+	}
+
+	BOOST_CHECK( largest > CUTOVER_SIZE );
+
+	checkAgainst( list, reference );
+}
+
+
+BOOST_AUTO_TEST_CASE( MoveConstructionAndAssignment )
+{
+	NodePoolManager					manager;
+	std::unique_ptr<NodePool>		pool = manager.getPool();
+
+	std::vector<Node*>				nodes = newNodes( *pool, CUTOVER_SIZE * 3 );
+
+	//	Both tiers, moved into a new list and then over a list holding the other tier
+
+	for( size_t count : { CUTOVER_SIZE / 2, nodes.size() } )
+	{
+		HandleList			source( *pool );
+		std::set<Node*>		reference;
+
+		for( size_t i = 0; i < count; i++ )
+		{
+			source.insert( nodes[i] );
+			reference.insert( nodes[i] );
+		}
+
+		HandleList			moved( std::move( source ) );
+
+		checkAgainst( moved, reference );
+		BOOST_CHECK( source.empty() );
+
+		HandleList			target( *pool );
+
+		size_t				otherCount = ( count == nodes.size() ) ? CUTOVER_SIZE / 2 : nodes.size();
+
+		for( size_t i = 0; i < otherCount; i++ )
+		{
+			target.insert( nodes[nodes.size() - 1 - i] );
+		}
+
+		target = std::move( moved );
+
+		checkAgainst( target, reference );
+		BOOST_CHECK( moved.empty() );
+
+		//	The emptied lists are still usable
+
+		moved.insert( nodes[0] );
+		source.insert( nodes[1] );
+
+		BOOST_CHECK_EQUAL( moved.size(), 1u );
+		BOOST_CHECK( moved.contains( nodes[0] ));
+		BOOST_CHECK_EQUAL( source.size(), 1u );
+		BOOST_CHECK( source.contains( nodes[1] ));
+	}
+}
@@ -0,0 +1,213 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+#define BOOST_TEST_MODULE SearchablePointerListTest
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <boost/test/included/unit_test.hpp>
+
+#include "Utility/SIMDIndexSearch.h"
+#include "Utility/SparseVector.h"
+
+
+
+using namespace SEFUtility;
+
+
+struct Node
+{
+	double		m_value;
+};
+
+
+
+BOOST_AUTO_TEST_CASE( FindPointerAtEveryPosition )
+{
+	//	Every count from empty through several vector widths, with the target at every position, so the
+	//		vector loop and the scalar remainder both find it and both run off the end when it is absent
+
+	std::vector<Node>		nodes( 80 );
+	std::vector<Node*>		pointers;
+
+	for( size_t count = 0; count <= 70; count++ )
+	{
+		pointers.assign( count, NULL );
+
+		for( size_t i = 0; i < count; i++ )
+		{
+			pointers[i] = &nodes[( i * 7 ) % 71];
+		}
+
+		for( size_t i = 0; i < count; i++ )
+		{
+			BOOST_REQUIRE_EQUAL( SIMD::findPointer( pointers.data(), count, pointers[i] ), (int)i );
+		}
+
+		BOOST_REQUIRE_EQUAL( SIMD::findPointer( pointers.data(), count, &nodes[75] ), -1 );
+		BOOST_REQUIRE_EQUAL( SIMD::findPointer( pointers.data(), count, (const Node*)NULL ), -1 );
+	}
+
+	//	The first of several matches is the one reported
+
+	pointers.assign( 13, &nodes[0] );
+
+	BOOST_CHECK_EQUAL( SIMD::findPointer( pointers.data(), pointers.size(), &nodes[0] ), 0 );
+
+	//	Pointers differing only in their high bits do not match
+
+	Node*		near = &nodes[1];
+	Node*		far = reinterpret_cast<Node*>( reinterpret_cast<uintptr_t>( near ) ^ ( (uintptr_t)1 << ( sizeof( uintptr_t ) * 8 - 2 ) ) );
+
+	pointers.assign( 9, far );
+
+	BOOST_CHECK_EQUAL( SIMD::findPointer( pointers.data(), pointers.size(), near ), -1 );
+}
+
+
+
+//	Random inserts and erases against a std::set, across the cutover into the set tier and back out through
+//		clear().  Pointers are only inserted when absent, as the inline tier does not check for duplicates.
+
+template<class List>
+static void			churnAgainstSet( size_t			range,
+									 size_t			steps,
+									 unsigned int	seed )
+{
+	std::vector<Node>		nodes( range + 1 );
+	std::mt19937			random( seed );
+
+	List					list;
+	std::set<Node*>			reference;
+
+	for( size_t step = 0; step < steps; step++ )
+	{
+		Node*		node = &nodes[random() % range];
+
+		if( step % 2000 == 1999 )
+		{
+			list.clear();
+			reference.clear();
+		}
+		else if( random() % 3 != 0 )
+		{
+			if( reference.insert( node ).second )
+			{
+				list.insert( node );
+			}
+		}
+		else
+		{
+			list.erase( node );
+			reference.erase( node );
+		}
+
+		BOOST_REQUIRE_EQUAL( list.size(), reference.size() );
+		BOOST_REQUIRE_EQUAL( list.contains( node ), reference.count( node ) != 0 );
+		BOOST_REQUIRE_EQUAL( list.find( node ), reference.count( node ) != 0 ? node : NULL );
+		BOOST_REQUIRE( !list.contains( &nodes[range] ) );
+
+		if( step % 97 == 0 )
+		{
+			std::vector<Node*>		contents( list.begin(), list.end() );
+
+			std::sort( contents.begin(), contents.end() );
+
+			BOOST_REQUIRE_EQUAL( contents.size(), reference.size() );
+			BOOST_REQUIRE( std::equal( contents.begin(), contents.end(), reference.begin() ) );
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE( HashedListMatchesSet )
+{
+	churnAgainstSet<SearchablePointerList<Node>>( 40, 20000, 1 );
+	churnAgainstSet<SearchablePointerList<Node>>( 400, 20000, 2 );
+	churnAgainstSet<SearchablePointerList<Node, 5>>( 40, 20000, 3 );
+}
+
+BOOST_AUTO_TEST_CASE( OrderedListMatchesSet )
+{
+	churnAgainstSet<SearchablePointerList<Node, DEFAULT_POINTER_LIST_CUTOVER_SIZE, OrderedOverflowPolicy>>( 40, 20000, 4 );
+	churnAgainstSet<SearchablePointerList<Node, 5, OrderedOverflowPolicy>>( 400, 20000, 5 );
+}
+
+
+BOOST_AUTO_TEST_CASE( SortedRangeAndReserve )
+{
+	std::vector<Node>		nodes( 100 );
+	std::vector<Node*>		pointers;
+
+	for( Node& node : nodes )
+	{
+		pointers.push_back( &node );
+	}
+
+	std::sort( pointers.begin(), pointers.end() );
+
+	//	Short enough to stay inline, and too long
+
+	for( size_t count : { (size_t)DEFAULT_POINTER_LIST_CUTOVER_SIZE, pointers.size() } )
+	{
+		SearchablePointerList<Node, DEFAULT_POINTER_LIST_CUTOVER_SIZE, OrderedOverflowPolicy>		list =
+			SearchablePointerList<Node, DEFAULT_POINTER_LIST_CUTOVER_SIZE, OrderedOverflowPolicy>::from_sorted_range( pointers.begin(), pointers.begin() + count );
+
+		BOOST_REQUIRE_EQUAL( list.size(), count );
+		BOOST_CHECK( std::equal( list.begin(), list.end(), pointers.begin() ) );
+		BOOST_CHECK( list.contains( pointers[count - 1] ) );
+
+		if( count < pointers.size() )
+		{
+			BOOST_CHECK( !list.contains( pointers[count] ) );
+		}
+	}
+
+	//	Reserving past the cutover moves the entries already inline into the set
+
+	SearchablePointerList<Node>		list;
+
+	list.insert( &nodes[0] );
+	list.insert( &nodes[1] );
+	list.reserve( 1000 );
+
+	for( size_t i = 2; i < nodes.size(); i++ )
+	{
+		list.insert( &nodes[i] );
+	}
+
+	BOOST_CHECK_EQUAL( list.size(), nodes.size() );
+
+	for( Node& node : nodes )
+	{
+		BOOST_REQUIRE( list.contains( &node ) );
+	}
+}
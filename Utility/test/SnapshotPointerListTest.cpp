@@ -0,0 +1,178 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+#define BOOST_TEST_MODULE SnapshotPointerListTest
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <boost/test/included/unit_test.hpp>
+
+#include "Utility/SnapshotPointerList.h"
+
+
+
+using namespace SEFUtility;
+
+
+struct Node : public SparseVectorEntry
+{
+	Node( size_t		index )
+		: SparseVectorEntry( index )
+	{}
+};
+
+
+typedef SnapshotPointerList<Node, 8>		NodeList;
+
+
+const int		READERS = 6;
+const size_t	NODES = 200;
+
+
+
+//	A writer grows the list to a prefix of the nodes and shrinks it again while readers check that every
+//		snapshot is some whole prefix: node i is in a snapshot of n nodes exactly when i < n.  Boost.Test
+//		assertions are not thread safe, so the readers count what they find wrong.
+
+BOOST_AUTO_TEST_CASE( ReadersSeeWholeSnapshots )
+{
+	std::vector<Node>			nodes;
+
+	for( size_t i = 0; i < NODES; i++ )
+	{
+		nodes.emplace_back( i );
+	}
+
+	NodeList					list;
+	std::atomic<bool>			done( false );
+	std::atomic<int>			failures( 0 );
+	std::vector<std::thread>	readers;
+
+	for( int reader = 0; reader < READERS; reader++ )
+	{
+		readers.emplace_back( [&list, &nodes, &done, &failures]
+		{
+			while( !done.load() )
+			{
+				NodeList::Snapshot		snapshot = list.snapshot();
+				size_t					size = snapshot.size();
+				size_t					count = 0;
+
+				for( Node* node : snapshot )
+				{
+					if( node->index() >= size )
+					{
+						failures++;
+					}
+
+					count++;
+				}
+
+				if(( count != size ) || (( size > 0 ) && !snapshot.contains( &nodes[size - 1] )) || snapshot.contains( &nodes[size] ))
+				{
+					failures++;
+				}
+			}
+		});
+	}
+
+	for( int round = 0; round < 20; round++ )
+	{
+		for( size_t i = 0; i < NODES - 1; i++ )
+		{
+			list.insert( &nodes[i] );
+		}
+
+		for( size_t i = NODES - 1; i > 0; i-- )
+		{
+			list.erase( &nodes[i - 1] );
+		}
+	}
+
+	done = true;
+
+	for( std::thread& reader : readers )
+	{
+		reader.join();
+	}
+
+	BOOST_CHECK_EQUAL( failures.load(), 0 );
+	BOOST_CHECK_EQUAL( list.reclaim(), 0 );
+	BOOST_CHECK_EQUAL( list.snapshot().size(), 0 );
+}
+
+
+//	A snapshot keeps the version it was taken from alive, whatever the writer does, until it is destroyed.
+//		Nested snapshots and a snapshot moved within the thread release the pin only once the last is gone.
+
+BOOST_AUTO_TEST_CASE( HeldSnapshotKeepsItsVersion )
+{
+	std::vector<Node>		nodes;
+
+	for( size_t i = 0; i < 4; i++ )
+	{
+		nodes.emplace_back( i );
+	}
+
+	NodeList		list;
+
+	list.insert( &nodes[0] );
+
+	{
+		NodeList::Snapshot		outer = list.snapshot();
+
+		list.insert( &nodes[1] );
+
+		{
+			NodeList::Snapshot		inner = list.snapshot();
+			NodeList::Snapshot		moved( std::move( inner ) );
+
+			list.insert( &nodes[2] );
+
+			BOOST_CHECK_EQUAL( outer.size(), 1 );
+			BOOST_CHECK_EQUAL( moved.size(), 2 );
+			BOOST_CHECK( moved.contains( &nodes[1] ) );
+			BOOST_CHECK( list.reclaim() > 0 );
+		}
+
+		//	The outer snapshot still pins the thread's slot
+
+		BOOST_CHECK( list.reclaim() > 0 );
+		BOOST_CHECK_EQUAL( outer.size(), 1 );
+		BOOST_CHECK( outer.contains( &nodes[0] ) );
+		BOOST_CHECK( !outer.contains( &nodes[1] ) );
+	}
+
+	list.insert( &nodes[3] );
+
+	BOOST_CHECK_EQUAL( list.reclaim(), 0 );
+	BOOST_CHECK_EQUAL( list.snapshot().size(), 4 );
+}
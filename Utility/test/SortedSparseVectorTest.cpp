@@ -0,0 +1,297 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+#define BOOST_TEST_MODULE SortedSparseVectorTest
+
+#include <map>
+#include <random>
+#include <vector>
+
+#include <boost/test/included/unit_test.hpp>
+
+#include "Utility/SortedSparseVector.h"
+
+
+
+using namespace SEFUtility;
+
+
+struct Entry : public SparseVectorEntry
+{
+	Entry( size_t		index )
+		: SparseVectorEntry( index ),
+		  m_value( 0 )
+	{}
+
+	double		m_value;
+};
+
+
+//	A small chunk size so a few hundred entries take many chunks and the splits and merges are exercised
+
+typedef SortedSparseVector<Entry, 16, size_t, 8>		Vector;
+typedef std::map<size_t, double>						Reference;
+
+
+static double&		valueOf( Entry&		entry )
+{
+	return( entry.m_value );
+}
+
+static double		constValueOf( const Entry&		entry )
+{
+	return( entry.m_value );
+}
+
+
+//	The vector holds exactly the reference's entries, in index order
+
+static void			checkAgainst( Vector&				vector,
+								  const Reference&		reference )
+{
+	BOOST_REQUIRE_EQUAL( vector.size(), reference.size() );
+
+	Reference::const_iterator		itrReference = reference.begin();
+
+	for( Vector::iterator itrEntry = vector.begin(); itrEntry != vector.end(); ++itrEntry, ++itrReference )
+	{
+		BOOST_REQUIRE( itrReference != reference.end() );
+		BOOST_REQUIRE_EQUAL( itrEntry.index(), itrReference->first );
+		BOOST_REQUIRE_EQUAL( (*itrEntry)->index(), itrReference->first );
+		BOOST_CHECK_EQUAL( (*itrEntry)->m_value, itrReference->second );
+	}
+
+	BOOST_CHECK( itrReference == reference.end() );
+
+	for( const auto& referenceEntry : reference )
+	{
+		BOOST_REQUIRE( vector.find( referenceEntry.first ) != NULL );
+		BOOST_CHECK_EQUAL( vector.find( referenceEntry.first )->m_value, referenceEntry.second );
+	}
+}
+
+
+static void			fill( Vector&			vector,
+						  Reference&		reference,
+						  size_t			count,
+						  size_t			range,
+						  std::mt19937&		random )
+{
+	while( reference.size() < count )
+	{
+		size_t		index = random() % range;
+		double		value = (double)( random() % 100 ) - 50;
+
+		vector.find_or_add( index ).m_value = value;
+		reference[index] = value;
+	}
+}
+
+
+
+BOOST_AUTO_TEST_CASE( RandomInsertAndEraseMatchMap )
+{
+	Vector			vector;
+	Reference		reference;
+	std::mt19937	random( 1 );
+
+	for( size_t step = 0; step < 30000; step++ )
+	{
+		//	Drift between growing and shrinking so the vector crosses the cutover in both directions
+
+		size_t		index = random() % 400;
+		bool		growing = ( step / 3000 ) % 2 == 0;
+
+		if( random() % 4 < ( growing ? 1u : 3u ) )
+		{
+			vector.erase( index );
+			reference.erase( index );
+		}
+		else
+		{
+			vector.find_or_add( index ).m_value += 1;
+			reference[index] += 1;
+		}
+
+		BOOST_REQUIRE_EQUAL( vector.size(), reference.size() );
+
+		if( step % 500 == 0 )
+		{
+			checkAgainst( vector, reference );
+		}
+	}
+
+	checkAgainst( vector, reference );
+}
+
+
+BOOST_AUTO_TEST_CASE( PushBackSortedBuildsInOrder )
+{
+	Vector			vector;
+	Reference		reference;
+
+	for( size_t i = 0; i < 300; i++ )
+	{
+		vector.push_back_sorted( i * 5 + 2 ).m_value = (double)i;
+		reference[i * 5 + 2] = (double)i;
+	}
+
+	checkAgainst( vector, reference );
+
+	//	Insertions between the appended entries split the full chunks
+
+	for( size_t i = 0; i < 300; i++ )
+	{
+		vector.find_or_add( i * 5 + 4 ).m_value = -(double)i;
+		reference[i * 5 + 4] = -(double)i;
+	}
+
+	checkAgainst( vector, reference );
+}
+
+
+BOOST_AUTO_TEST_CASE( AdvanceToMatchesLowerBound )
+{
+	std::mt19937		random( 2 );
+
+	for( size_t count : { 0, 1, 10, 16, 17, 200 } )
+	{
+		Vector			vector;
+		Reference		reference;
+
+		fill( vector, reference, count, 1000, random );
+
+		for( size_t trial = 0; trial < 200; trial++ )
+		{
+			//	Start part way in and jump forward, possibly into a later chunk or past the end
+
+			size_t		start = random() % 1000;
+			size_t		target = start + random() % 300;
+
+			Vector::iterator		itrEntry = vector.begin();
+
+			itrEntry.advance_to( start );
+			itrEntry.advance_to( target );
+
+			Reference::iterator		expected = reference.lower_bound( std::max( start, target ) );
+
+			if( expected == reference.end() )
+			{
+				BOOST_CHECK( itrEntry == vector.end() );
+			}
+			else
+			{
+				BOOST_REQUIRE( itrEntry != vector.end() );
+				BOOST_CHECK_EQUAL( itrEntry.index(), expected->first );
+			}
+		}
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE( KernelsMatchMap )
+{
+	std::mt19937		random( 3 );
+
+	//	Equal sizes take the linear merge, the lopsided pairs take the galloping path in either order
+
+	size_t		sizes[][2] = { { 0, 0 }, { 5, 0 }, { 5, 5 }, { 12, 300 }, { 300, 12 }, { 250, 250 }, { 3, 900 }, { 900, 3 } };
+
+	for( auto& size : sizes )
+	{
+		Vector			a;
+		Vector			b;
+		Reference		referenceA;
+		Reference		referenceB;
+
+		fill( a, referenceA, size[0], 2000, random );
+		fill( b, referenceB, size[1], 2000, random );
+
+		//	Intersection and dot
+
+		Reference		expectedIntersection;
+		double			expectedDot = 0;
+
+		for( const auto& entry : referenceA )
+		{
+			if( referenceB.count( entry.first ) )
+			{
+				expectedIntersection[entry.first] = entry.second;
+				expectedDot += entry.second * referenceB[entry.first];
+			}
+		}
+
+		Reference		intersection;
+
+		sparse_intersection( a, b, [&]( Entry&		entryA,
+										Entry&		entryB )
+		{
+			BOOST_REQUIRE_EQUAL( entryA.index(), entryB.index() );
+			BOOST_REQUIRE_EQUAL( entryA.m_value, referenceA[entryA.index()] );
+			BOOST_REQUIRE_EQUAL( entryB.m_value, referenceB[entryB.index()] );
+
+			BOOST_CHECK( intersection.emplace( entryA.index(), entryA.m_value ).second );
+		});
+
+		BOOST_CHECK( intersection == expectedIntersection );
+		BOOST_CHECK_EQUAL( sparse_dot( a, b, constValueOf ), expectedDot );
+
+		//	Union, in index order
+
+		Reference		expectedUnion = referenceA;
+
+		expectedUnion.insert( referenceB.begin(), referenceB.end() );
+
+		std::vector<size_t>		unionIndices;
+
+		sparse_union( a, b, [&]( size_t		index,
+								 Entry*		entryA,
+								 Entry*		entryB )
+		{
+			BOOST_REQUIRE(( entryA != NULL ) || ( entryB != NULL ));
+			BOOST_CHECK_EQUAL( entryA != NULL, referenceA.count( index ) == 1 );
+			BOOST_CHECK_EQUAL( entryB != NULL, referenceB.count( index ) == 1 );
+
+			unionIndices.push_back( index );
+		});
+
+		BOOST_REQUIRE_EQUAL( unionIndices.size(), expectedUnion.size() );
+		BOOST_CHECK( std::equal( unionIndices.begin(), unionIndices.end(), expectedUnion.begin(), []( size_t index, const Reference::value_type& entry ) { return( index == entry.first ); } ));
+
+		//	b += 0.5 * a
+
+		for( const auto& entry : referenceA )
+		{
+			referenceB[entry.first] += 0.5 * entry.second;
+		}
+
+		sparse_axpy( 0.5, a, b, valueOf );
+
+		checkAgainst( b, referenceB );
+		checkAgainst( a, referenceA );
+	}
+}
@@ -0,0 +1,378 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+#define BOOST_TEST_MODULE SparseMatrixTest
+
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <boost/test/included/unit_test.hpp>
+
+#include "Utility/SparseMatrix.h"
+#include "Utility/SparseVector.h"
+
+
+
+using namespace SEFUtility;
+
+
+struct Entry : public SparseVectorEntry
+{
+	Entry( size_t		index )
+		: SparseVectorEntry( index ),
+		  m_value( 0 )
+	{}
+
+	double		m_value;
+};
+
+typedef std::vector<SparseVector<Entry, 16>>			Rows;
+typedef std::map<std::pair<size_t, size_t>, double>		Reference;
+
+
+static double		valueOf( const Entry&		entry )
+{
+	return( entry.m_value );
+}
+
+
+//	Random matrix with small integer values, so float and double products are exact and can be compared
+//		for equality whatever order the kernels add them in.  Row lengths vary from empty to dense enough to
+//		take the SIMD loops and their remainders.
+
+static void			randomMatrix( size_t			rows,
+								  size_t			columns,
+								  unsigned int		seed,
+								  Rows&				vectors,
+								  Reference&		reference )
+{
+	std::mt19937		random( seed );
+
+	vectors.clear();
+	vectors.resize( rows );
+	reference.clear();
+
+	for( size_t row = 0; row < rows; row++ )
+	{
+		size_t		length = random() % 4 == 0 ? 0 : random() % std::min<size_t>( columns, 40 );
+
+		for( size_t i = 0; i < length; i++ )
+		{
+			size_t		column = random() % columns;
+			double		value = (double)( (int)( random() % 9 ) - 4 );
+
+			vectors[row].find_or_add( column ).m_value = value;
+			reference[std::make_pair( row, column )] = value;
+		}
+	}
+}
+
+template<class Matrix>
+static Matrix		fromReference( const Rows&		vectors,
+								   size_t			columns )
+{
+	return( Matrix::fromRows( vectors.begin(), vectors.end(), columns, valueOf ) );
+}
+
+
+//	The CSR arrays hold exactly the reference's entries, row by row in column order
+
+template<class Matrix>
+static void			checkAgainst( const Matrix&			matrix,
+								  const Reference&		reference,
+								  size_t				rows )
+{
+	BOOST_REQUIRE_EQUAL( matrix.rows(), rows );
+	BOOST_REQUIRE_EQUAL( matrix.nonZeros(), reference.size() );
+	BOOST_REQUIRE_EQUAL( matrix.rowOffsets()[rows], reference.size() );
+
+	Reference::const_iterator		itrReference = reference.begin();
+
+	for( size_t row = 0; row < rows; row++ )
+	{
+		BOOST_REQUIRE( matrix.rowOffsets()[row] <= matrix.rowOffsets()[row + 1] );
+
+		for( size_t i = matrix.rowOffsets()[row]; i < matrix.rowOffsets()[row + 1]; i++, ++itrReference )
+		{
+			BOOST_REQUIRE( itrReference != reference.end() );
+			BOOST_CHECK_EQUAL( itrReference->first.first, row );
+			BOOST_CHECK_EQUAL( (size_t)matrix.columnIndices()[i], itrReference->first.second );
+			BOOST_CHECK_EQUAL( (double)matrix.values()[i], itrReference->second );
+		}
+	}
+}
+
+static Reference	transposed( const Reference&		reference )
+{
+	Reference		result;
+
+	for( const Reference::value_type& entry : reference )
+	{
+		result[std::make_pair( entry.first.second, entry.first.first )] = entry.second;
+	}
+
+	return( result );
+}
+
+
+
+BOOST_AUTO_TEST_CASE( FromRowsMatchesMap )
+{
+	Rows			vectors;
+	Reference		reference;
+
+	randomMatrix( 500, 300, 1, vectors, reference );
+
+	checkAgainst( fromReference<SparseMatrix<double>>( vectors, 300 ), reference, 500 );
+	checkAgainst( fromReference<SparseMatrix<float, uint64_t>>( vectors, 300 ), reference, 500 );
+
+	//	Rows built past the inline tier come out sorted too
+
+	Rows		wide( 3 );
+	Reference	wideReference;
+
+	for( size_t i = 0; i < 333; i++ )
+	{
+		size_t		column = 999 - i * 3;
+
+		wide[1].find_or_add( column ).m_value = (double)column;
+		wideReference[std::make_pair( (size_t)1, column )] = (double)column;
+	}
+
+	checkAgainst( fromReference<SparseMatrix<double>>( wide, 1001 ), wideReference, 3 );
+
+	SparseMatrix<double>		empty;
+
+	BOOST_CHECK_EQUAL( empty.rows(), 0 );
+	BOOST_CHECK_EQUAL( empty.nonZeros(), 0 );
+}
+
+
+BOOST_AUTO_TEST_CASE( TransposeMatchesMap )
+{
+	Rows			vectors;
+	Reference		reference;
+
+	//	Tall, wide, and with more columns than non-zeros so the transpose falls back to a single band
+
+	const size_t		shapes[][2] = { { 2000, 100 }, { 100, 2000 }, { 50, 100000 } };
+
+	for( const size_t* shape : shapes )
+	{
+		randomMatrix( shape[0], shape[1], (unsigned int)shape[0], vectors, reference );
+
+		SparseMatrix<double>		matrix = fromReference<SparseMatrix<double>>( vectors, shape[1] );
+		SparseMatrix<double>		csc = matrix.transpose();
+
+		BOOST_CHECK_EQUAL( csc.columns(), shape[0] );
+		checkAgainst( csc, transposed( reference ), shape[1] );
+
+		checkAgainst( csc.transpose(), reference, shape[0] );
+	}
+}
+
+
+template<class Value, class IndexType>
+static void			checkMatrixVector( size_t			rows,
+									   size_t			columns )
+{
+	Rows			vectors;
+	Reference		reference;
+
+	randomMatrix( rows, columns, (unsigned int)( rows + columns ), vectors, reference );
+
+	SparseMatrix<Value, IndexType>		matrix = fromReference<SparseMatrix<Value, IndexType>>( vectors, columns );
+
+	std::vector<Value>		x( columns );
+
+	for( size_t i = 0; i < columns; i++ )
+	{
+		x[i] = (Value)( (int)( i % 7 ) - 3 );
+	}
+
+	std::vector<Value>		expected( rows, Value() );
+
+	for( const Reference::value_type& entry : reference )
+	{
+		expected[entry.first.first] += (Value)entry.second * x[entry.first.second];
+	}
+
+	std::vector<Value>		y( rows, (Value)99 );
+
+	matrix.multiply( x.data(), y.data() );
+
+	BOOST_CHECK( y == expected );
+
+	//	A dense right hand side, widths either side of the vector width
+
+	for( size_t width : { 1, 3, 4, 8, 13 } )
+	{
+		std::vector<Value>		b( columns * width );
+
+		for( size_t i = 0; i < b.size(); i++ )
+		{
+			b[i] = (Value)( (int)( i % 5 ) - 2 );
+		}
+
+		std::vector<Value>		expectedC( rows * width, Value() );
+
+		for( const Reference::value_type& entry : reference )
+		{
+			for( size_t k = 0; k < width; k++ )
+			{
+				expectedC[entry.first.first * width + k] += (Value)entry.second * b[entry.first.second * width + k];
+			}
+		}
+
+		std::vector<Value>		c( rows * width, (Value)99 );
+
+		matrix.multiply_dense( b.data(), width, c.data() );
+
+		BOOST_CHECK( c == expectedC );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( MatrixVectorProductsMatchReference )
+{
+	checkMatrixVector<double, uint32_t>( 1000, 200 );
+	checkMatrixVector<double, uint64_t>( 1000, 200 );
+	checkMatrixVector<float, uint32_t>( 1000, 200 );
+	checkMatrixVector<float, uint64_t>( 300, 5000 );
+}
+
+
+BOOST_AUTO_TEST_CASE( SparseProductMatchesMap )
+{
+	Rows			leftRows;
+	Rows			rightRows;
+	Reference		left;
+	Reference		right;
+
+	//	The right hand side is narrow, so some result rows are dense enough to be gathered by scanning
+
+	randomMatrix( 700, 400, 7, leftRows, left );
+	randomMatrix( 400, 60, 8, rightRows, right );
+
+	SparseMatrix<double>		product = fromReference<SparseMatrix<double>>( leftRows, 400 ).multiply( fromReference<SparseMatrix<double>>( rightRows, 60 ) );
+
+	//	The reference product keeps explicit zeros where terms cancel, as the accumulator does
+
+	Reference		expected;
+
+	for( const Reference::value_type& a : left )
+	{
+		for( Reference::const_iterator itrB = right.lower_bound( std::make_pair( a.first.second, (size_t)0 ) );
+			 itrB != right.end() && itrB->first.first == a.first.second; ++itrB )
+		{
+			expected[std::make_pair( a.first.first, itrB->first.second )] += a.second * itrB->second;
+		}
+	}
+
+	BOOST_CHECK_EQUAL( product.columns(), 60 );
+	checkAgainst( product, expected, 700 );
+}
+
+
+BOOST_AUTO_TEST_CASE( AccumulatorGathersInColumnOrder )
+{
+	SparseAccumulator<double>		accumulator( 1000 );
+
+	std::vector<uint32_t>		indices( 1000 );
+	std::vector<double>			values( 1000 );
+
+	//	A few columns are sorted, most of the row is collected by scanning the flags; both leave it empty
+
+	for( size_t touched : { 5, 900 } )
+	{
+		std::map<uint32_t, double>		expected;
+		std::mt19937					random( (unsigned int)touched );
+
+		while( expected.size() < touched )
+		{
+			uint32_t		column = random() % 1000;
+
+			accumulator.accumulate( column, 1 );
+			accumulator.accumulate( column, 2 );
+
+			expected[column] += 3;
+		}
+
+		BOOST_CHECK_EQUAL( accumulator.size(), touched );
+		BOOST_CHECK_EQUAL( accumulator.value( expected.begin()->first ), 3 );
+
+		BOOST_REQUIRE_EQUAL( accumulator.gather( indices.data(), values.data() ), touched );
+
+		size_t		i = 0;
+
+		for( const std::pair<const uint32_t, double>& entry : expected )
+		{
+			BOOST_CHECK_EQUAL( indices[i], entry.first );
+			BOOST_CHECK_EQUAL( values[i++], entry.second );
+		}
+
+		BOOST_CHECK( accumulator.empty() );
+
+		for( uint32_t column = 0; column < 1000; column++ )
+		{
+			BOOST_REQUIRE_EQUAL( accumulator.value( column ), 0 );
+		}
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE( AccumulatorTouchCountsWithoutValues )
+{
+	SparseAccumulator<double>		accumulator( 100 );
+
+	accumulator.accumulate( 7, 5 );
+	accumulator.clear();
+
+	//	Touching counts each column once and leaves no values behind for the numeric pass
+
+	for( uint32_t column : { 7, 3, 7, 50, 3 } )
+	{
+		accumulator.touch( column );
+	}
+
+	BOOST_CHECK_EQUAL( accumulator.size(), 3u );
+
+	accumulator.clear();
+
+	BOOST_CHECK( accumulator.empty() );
+	BOOST_CHECK_EQUAL( accumulator.value( 7 ), 0 );
+
+	accumulator.accumulate( 7, 1 );
+	accumulator.accumulate( 50, 2 );
+
+	BOOST_CHECK_EQUAL( accumulator.size(), 2u );
+	BOOST_CHECK_EQUAL( accumulator.value( 7 ), 1 );
+	BOOST_CHECK_EQUAL( accumulator.value( 50 ), 2 );
+}
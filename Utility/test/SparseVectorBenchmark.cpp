@@ -0,0 +1,683 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+#define BOOST_TEST_MODULE SparseVectorBenchmark
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/container/static_vector.hpp>
+#include <boost/test/included/unit_test.hpp>
+#include <tbb/task_arena.h>
+
+#include "Utility/ConcurrentSparseVector.h"
+#include "Utility/FlatIndexMap.h"
+#include "Utility/FrozenSparseVector.h"
+#include "Utility/SparseVector.h"
+
+
+
+//
+//	Timings for the SparseVector tiers against the structures they replaced.  Each case prints nanoseconds
+//		per operation and checks that both sides computed the same result, so the work cannot be optimized
+//		away.  Build with optimization and the target's SIMD flags, e.g. -O2 -march=native, for useful numbers.
+//
+
+
+using namespace SEFUtility;
+
+
+struct Entry : public SparseVectorEntry
+{
+	Entry( size_t		index )
+		: SparseVectorEntry( index ),
+		  m_value( 0 )
+	{}
+
+	double		m_value;
+};
+
+
+template<class Operation>
+static double		nanosecondsPer( size_t			operations,
+									Operation		operation )
+{
+	std::chrono::steady_clock::time_point		start = std::chrono::steady_clock::now();
+
+	operation();
+
+	return( std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count() / operations );
+}
+
+
+//	One line per measurement: the size, nanoseconds per operation before and after, and the speedup
+
+static void			report( const char*		name,
+							size_t			size,
+							double			baseline,
+							double			measured )
+{
+	std::cout << std::left << std::setw( 44 ) << name << std::right << std::setw( 10 ) << size
+			  << std::fixed << std::setprecision( 2 ) << std::setw( 12 ) << baseline << std::setw( 12 ) << measured
+			  << std::setw( 10 ) << baseline / measured << "x" << std::endl;
+}
+
+
+
+//	The inline tier before the SIMD scan: entries searched one at a time through index()
+
+template<class EntryVector>
+static Entry*		scalarFind( EntryVector&		entries,
+								size_t				index )
+{
+	for( Entry& entry : entries )
+	{
+		if( entry.index() == index )
+		{
+			return( &entry );
+		}
+	}
+
+	return( NULL );
+}
+
+template<long CUTOVER_SIZE>
+static void			benchmarkInlineFind()
+{
+	const size_t		LOOKUPS = 4000000;
+
+	boost::container::static_vector<Entry, CUTOVER_SIZE>		entries;
+	SparseVector<Entry, CUTOVER_SIZE>							vector;
+
+	std::mt19937		random( CUTOVER_SIZE );
+	std::vector<size_t>	indices;
+
+	for( long i = 0; i < CUTOVER_SIZE; i++ )
+	{
+		size_t		index = random() % 100000;
+
+		entries.emplace_back( index );
+		vector.find_or_add( index );
+
+		indices.push_back( index );
+	}
+
+	//	Half the lookups miss, which scans the whole array
+
+	std::vector<size_t>		probes( 4096 );
+
+	for( size_t& probe : probes )
+	{
+		probe = random() % 2 ? indices[random() % indices.size()] : 100000 + random() % 1000;
+	}
+
+	size_t		scalarHits = 0;
+	size_t		simdHits = 0;
+
+	double		scalar = nanosecondsPer( LOOKUPS, [&]()
+	{
+		for( size_t i = 0; i < LOOKUPS; i++ )
+		{
+			scalarHits += ( scalarFind( entries, probes[i & 4095] ) != NULL );
+		}
+	});
+
+	double		simd = nanosecondsPer( LOOKUPS, [&]()
+	{
+		for( size_t i = 0; i < LOOKUPS; i++ )
+		{
+			simdHits += ( vector.find( probes[i & 4095] ) != NULL );
+		}
+	});
+
+	BOOST_CHECK_EQUAL( scalarHits, simdHits );
+
+	report( "inline find: scalar loop / SIMD", CUTOVER_SIZE, scalar, simd );
+}
+
+
+BOOST_AUTO_TEST_CASE( InlineFindAgainstScalarLoop )
+{
+	benchmarkInlineFind<4>();
+	benchmarkInlineFind<8>();
+	benchmarkInlineFind<16>();
+	benchmarkInlineFind<32>();
+	benchmarkInlineFind<64>();
+}
+
+
+
+//	The map tier before the flat table was a node based std::unordered_map, its bytes are counted with an allocator
+
+static size_t		nodeBytes = 0;
+
+template<class T>
+struct CountingAllocator : public std::allocator<T>
+{
+	template<class U> struct rebind { typedef CountingAllocator<U> other; };
+
+	CountingAllocator() {}
+	template<class U> CountingAllocator( const CountingAllocator<U>& ) {}
+
+	T*		allocate( size_t		count )
+	{
+		nodeBytes += count * sizeof( T );
+		return( std::allocator<T>::allocate( count ) );
+	}
+
+	void	deallocate( T*		pointer,
+						size_t	count )
+	{
+		nodeBytes -= count * sizeof( T );
+		std::allocator<T>::deallocate( pointer, count );
+	}
+};
+
+typedef std::unordered_map<size_t, Entry, std::hash<size_t>, std::equal_to<size_t>, CountingAllocator<std::pair<const size_t, Entry>>>		NodeMap;
+
+
+static void			benchmarkMapTier( size_t		entries )
+{
+	const size_t		LOOKUPS = 4000000;
+
+	std::mt19937				random( (unsigned int)entries );
+	std::vector<size_t>			indices( entries );
+
+	for( size_t& index : indices )
+	{
+		index = ( (size_t)random() << 20 ) ^ random();
+	}
+
+	NodeMap						nodeMap;
+	FlatIndexMap<Entry>			flatMap;
+
+	double		nodeInsert = nanosecondsPer( entries, [&]()
+	{
+		for( size_t index : indices )
+		{
+			nodeMap.emplace( index, Entry( index ) ).first->second.m_value += 1;
+		}
+	});
+
+	double		flatInsert = nanosecondsPer( entries, [&]()
+	{
+		for( size_t index : indices )
+		{
+			flatMap.find_or_add( index ).m_value += 1;
+		}
+	});
+
+	report( "map tier insert: unordered_map / flat", entries, nodeInsert, flatInsert );
+
+	std::vector<size_t>		probes( 4096 );
+
+	for( size_t& probe : probes )
+	{
+		probe = random() % 2 ? indices[random() % entries] : random();
+	}
+
+	size_t		nodeHits = 0;
+	size_t		flatHits = 0;
+
+	double		nodeFind = nanosecondsPer( LOOKUPS, [&]()
+	{
+		for( size_t i = 0; i < LOOKUPS; i++ )
+		{
+			nodeHits += nodeMap.count( probes[i & 4095] );
+		}
+	});
+
+	double		flatFind = nanosecondsPer( LOOKUPS, [&]()
+	{
+		for( size_t i = 0; i < LOOKUPS; i++ )
+		{
+			flatHits += ( flatMap.find( probes[i & 4095] ) != NULL );
+		}
+	});
+
+	BOOST_CHECK_EQUAL( nodeHits, flatHits );
+
+	report( "map tier find: unordered_map / flat", entries, nodeFind, flatFind );
+
+	double		nodeSum = 0;
+	double		flatSum = 0;
+	size_t		passes = LOOKUPS / entries + 1;
+
+	double		nodeIterate = nanosecondsPer( passes * entries, [&]()
+	{
+		for( size_t pass = 0; pass < passes; pass++ )
+		{
+			for( auto& entry : nodeMap )
+			{
+				nodeSum += entry.second.m_value;
+			}
+		}
+	});
+
+	double		flatIterate = nanosecondsPer( passes * entries, [&]()
+	{
+		for( size_t pass = 0; pass < passes; pass++ )
+		{
+			flatMap.for_each( [&]( Entry&		entry ) { flatSum += entry.m_value; } );
+		}
+	});
+
+	BOOST_CHECK_EQUAL( nodeSum, flatSum );
+
+	report( "map tier for_each: unordered_map / flat", entries, nodeIterate, flatIterate );
+
+	report( "map tier bytes/entry: unordered_map / flat", entries, (double)nodeBytes / entries, (double)flatMap.memoryUsed() / entries );
+}
+
+
+BOOST_AUTO_TEST_CASE( FlatMapAgainstUnorderedMap )
+{
+	benchmarkMapTier( 64 );
+	benchmarkMapTier( 4096 );
+	benchmarkMapTier( 262144 );
+}
+
+
+
+
+//	Thread counts from one up to the hardware's, doubling
+
+static std::vector<size_t>		threadCounts()
+{
+	size_t					hardware = std::max( std::thread::hardware_concurrency(), 1u );
+	std::vector<size_t>		counts;
+
+	for( size_t threads = 1; threads < hardware; threads *= 2 )
+	{
+		counts.push_back( threads );
+	}
+
+	counts.push_back( hardware );
+
+	return( counts );
+}
+
+template<class Work>
+static double		nanosecondsPerOnThreads( size_t		threads,
+											 size_t		operations,
+											 Work		work )
+{
+	return( nanosecondsPer( operations, [&]()
+	{
+		std::vector<std::thread>		workers;
+
+		for( size_t thread = 0; thread < threads; thread++ )
+		{
+			workers.emplace_back( work, thread );
+		}
+
+		for( std::thread& worker : workers )
+		{
+			worker.join();
+		}
+	}));
+}
+
+
+struct AtomicEntry : public SparseVectorEntry
+{
+	AtomicEntry( size_t		index )
+		: SparseVectorEntry( index ),
+		  m_hits( 0 )
+	{}
+
+	AtomicEntry( AtomicEntry&&		entryToMove )
+		: SparseVectorEntry( entryToMove.index() ),
+		  m_hits( entryToMove.m_hits.load() )
+	{}
+
+	AtomicEntry( const AtomicEntry&		entryToCopy )
+		: SparseVectorEntry( entryToCopy.index() ),
+		  m_hits( entryToCopy.m_hits.load() )
+	{}
+
+	AtomicEntry&		operator=( AtomicEntry&&		entryToMove )
+	{
+		static_cast<SparseVectorEntry&>( *this ) = entryToMove;
+		m_hits = entryToMove.m_hits.load();
+		return( *this );
+	}
+
+	std::atomic<long>		m_hits;
+};
+
+
+BOOST_AUTO_TEST_CASE( ConcurrentFindOrAddScaling )
+{
+	//	Every thread adds and bumps entries from the same 256 indices, the first 32 inline and the rest in
+	//		the concurrent map.  The baseline is a SparseVector behind a mutex, throughput is reported as
+	//		nanoseconds per operation across all threads.
+
+	const size_t		OPERATIONS_PER_THREAD = 400000;
+	const size_t		INDICES = 256;
+
+	for( size_t threads : threadCounts() )
+	{
+		size_t		operations = threads * OPERATIONS_PER_THREAD;
+
+		SparseVector<AtomicEntry, 32>				lockedVector;
+		std::mutex									lock;
+		ConcurrentSparseVector<AtomicEntry, 32>		concurrentVector;
+
+		double		locked = nanosecondsPerOnThreads( threads, operations, [&]( size_t		thread )
+		{
+			for( size_t i = 0; i < OPERATIONS_PER_THREAD; i++ )
+			{
+				std::lock_guard<std::mutex>		guard( lock );
+
+				lockedVector.find_or_add( ( i * 13 + thread * 7 ) % INDICES ).m_hits++;
+			}
+		});
+
+		double		lockFree = nanosecondsPerOnThreads( threads, operations, [&]( size_t		thread )
+		{
+			for( size_t i = 0; i < OPERATIONS_PER_THREAD; i++ )
+			{
+				concurrentVector.find_or_add( ( i * 13 + thread * 7 ) % INDICES ).m_hits++;
+			}
+		});
+
+		long		lockedHits = 0;
+		long		lockFreeHits = 0;
+
+		lockedVector.for_each( [&]( AtomicEntry&		entry ) { lockedHits += entry.m_hits; } );
+		concurrentVector.for_each( [&]( AtomicEntry&		entry ) { lockFreeHits += entry.m_hits; } );
+
+		BOOST_CHECK_EQUAL( lockedHits, (long)operations );
+		BOOST_CHECK_EQUAL( lockFreeHits, (long)operations );
+
+		report( "find_or_add threads: mutex / concurrent", threads, locked, lockFree );
+	}
+}
+
+
+
+
+BOOST_AUTO_TEST_CASE( FrozenAgainstLiveVector )
+{
+	//	Footprint and a full scan of the frozen form against the live vector it came from and against the
+	//		same entries in a plain sorted array
+
+	const size_t		ENTRIES = 262144;
+	const size_t		PASSES = 20;
+
+	SparseVector<Entry, 16, FixedCutoverPolicy<50, 0>>		vector;
+	std::vector<Entry>										sorted;
+
+	for( size_t i = 0; i < ENTRIES; i++ )
+	{
+		vector.find_or_add( i * 5 ).m_value = (double)i;
+		sorted.push_back( Entry( i * 5 ) );
+		sorted.back().m_value = (double)i;
+	}
+
+	double		liveSum = 0;
+	double		frozenSum = 0;
+
+	double		live = nanosecondsPer( ENTRIES * PASSES, [&]()
+	{
+		for( size_t pass = 0; pass < PASSES; pass++ )
+		{
+			vector.for_each( [&]( Entry&		entry ) { liveSum += entry.m_value; } );
+		}
+	});
+
+	SparseVector<Entry, 16, FixedCutoverPolicy<50, 0>>		copy;
+
+	vector.for_each( [&]( Entry&		entry ) { copy.find_or_add( entry.index() ).m_value = entry.m_value; } );
+
+	FrozenSparseVector<Entry>		frozen = freeze( copy );
+
+	double		scan = nanosecondsPer( ENTRIES * PASSES, [&]()
+	{
+		for( size_t pass = 0; pass < PASSES; pass++ )
+		{
+			frozen.for_each( [&]( const Entry&		entry ) { frozenSum += entry.m_value; } );
+		}
+	});
+
+	BOOST_CHECK_EQUAL( liveSum, frozenSum );
+
+	report( "for_each: live map tier / frozen", ENTRIES, live, scan );
+
+	//	The live vector's map tier is a FlatIndexMap, filled the same way
+
+	FlatIndexMap<Entry>		table;
+
+	for( const Entry& entry : sorted )
+	{
+		table.find_or_add( entry.index() ).m_value = entry.m_value;
+	}
+
+	report( "bytes/entry: flat table / frozen", ENTRIES, (double)table.memoryUsed() / ENTRIES, (double)frozen.memoryUsed() / ENTRIES );
+	report( "bytes/entry: sorted array / frozen", ENTRIES, (double)sizeof( Entry ), (double)frozen.memoryUsed() / ENTRIES );
+}
+
+
+
+//	parallel_for_each() and parallel_reduce() against the serial for_each(), in TBB arenas of increasing size.
+//		The action does a little arithmetic per entry so the scan is not purely bound by memory bandwidth.
+//		The size column is the arena's thread count.
+
+template<class Vector>
+static void			benchmarkParallelScan( const std::string&	tierName,
+										   Vector&				vector,
+										   size_t				entries )
+{
+	const size_t		PASSES = 10;
+
+	std::string			forEachName = tierName + " " + std::to_string( entries ) + ": for_each / parallel";
+	std::string			reduceName = tierName + " " + std::to_string( entries ) + ": sum / parallel_reduce";
+
+	double		serialSum = 0;
+
+	double		serial = nanosecondsPer( entries * PASSES, [&]()
+	{
+		for( size_t pass = 0; pass < PASSES; pass++ )
+		{
+			vector.for_each( []( Entry&		entry ) { entry.m_value = std::sqrt( entry.m_value + 1 ); } );
+		}
+	});
+
+	vector.for_each( [&]( Entry&		entry ) { serialSum += entry.m_value; } );
+
+	double		serialReduce = nanosecondsPer( entries * PASSES, [&]()
+	{
+		for( size_t pass = 0; pass < PASSES; pass++ )
+		{
+			double		sum = 0;
+
+			vector.for_each( [&]( Entry&		entry ) { sum += std::sqrt( entry.m_value ); } );
+
+			BOOST_CHECK( sum > 0 );
+		}
+	});
+
+	for( size_t threads : threadCounts() )
+	{
+		tbb::task_arena		arena( (int)threads );
+
+		//	Resetting the values makes the parallel passes compute exactly what the serial passes did
+
+		vector.for_each( []( Entry&		entry ) { entry.m_value = (double)( entry.index() % 1000 ); } );
+
+		double		parallel = nanosecondsPer( entries * PASSES, [&]()
+		{
+			arena.execute( [&]()
+			{
+				for( size_t pass = 0; pass < PASSES; pass++ )
+				{
+					vector.parallel_for_each( []( Entry&		entry ) { entry.m_value = std::sqrt( entry.m_value + 1 ); } );
+				}
+			});
+		});
+
+		double		parallelSum = 0;
+
+		vector.for_each( [&]( Entry&		entry ) { parallelSum += entry.m_value; } );
+
+		BOOST_CHECK_CLOSE( serialSum, parallelSum, 1e-9 );
+
+		double		parallelReduce = nanosecondsPer( entries * PASSES, [&]()
+		{
+			arena.execute( [&]()
+			{
+				for( size_t pass = 0; pass < PASSES; pass++ )
+				{
+					double		sum = vector.parallel_reduce( 0.0, []( Entry& entry ) { return( std::sqrt( entry.m_value ) ); }, []( double a, double b ) { return( a + b ); } );
+
+					BOOST_CHECK( sum > 0 );
+				}
+			});
+		});
+
+		report( forEachName.c_str(), threads, serial, parallel );
+		report( reduceName.c_str(), threads, serialReduce, parallelReduce );
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE( ParallelScanScaling )
+{
+	for( size_t entries : { 100000, 1000000 } )
+	{
+		SparseVector<Entry, 16, FixedCutoverPolicy<50, 0>>		map;
+		SparseVector<Entry, 16>									dense;
+
+		std::mt19937		random( (unsigned int)entries );
+
+		for( size_t i = 0; i < entries; i++ )
+		{
+			size_t		index = ( (size_t)random() << 20 ) ^ random();
+
+			map.find_or_add( index ).m_value = (double)( index % 1000 );
+			dense.find_or_add( i * 2 ).m_value = (double)( ( i * 2 ) % 1000 );
+		}
+
+		BOOST_REQUIRE( dense.tier() == decltype( dense )::Tier::DENSE );
+
+		benchmarkParallelScan( "map tier", map, entries );
+		benchmarkParallelScan( "dense tier", dense, entries );
+	}
+}
+
+
+
+//	SearchablePointerList membership at several list sizes: the scalar loop the inline tier used before the
+//		SIMD search, the SIMD search, and the set the list cuts over to.  Half the probes miss.
+
+struct Node
+{
+	double		m_value;
+};
+
+template<long LIST_SIZE>
+static void			benchmarkPointerList()
+{
+	const size_t		LOOKUPS = 4000000;
+
+	std::vector<Node>		nodes( LIST_SIZE * 2 );
+	std::vector<Node*>		probes( 4096 );
+
+	std::mt19937		random( LIST_SIZE );
+
+	boost::container::static_vector<Node*, LIST_SIZE>		pointers;
+	SearchablePointerList<Node, LIST_SIZE>					inlineList;
+	SearchablePointerList<Node, 1>							setList;
+
+	for( long i = 0; i < LIST_SIZE; i++ )
+	{
+		pointers.push_back( &nodes[i * 2] );
+		inlineList.insert( &nodes[i * 2] );
+		setList.insert( &nodes[i * 2] );
+	}
+
+	for( Node*& probe : probes )
+	{
+		probe = &nodes[random() % nodes.size()];
+	}
+
+	size_t		scalarHits = 0;
+	size_t		simdHits = 0;
+	size_t		setHits = 0;
+
+	double		scalar = nanosecondsPer( LOOKUPS, [&]()
+	{
+		for( size_t i = 0; i < LOOKUPS; i++ )
+		{
+			scalarHits += ( std::find( pointers.begin(), pointers.end(), probes[i & 4095] ) != pointers.end() );
+		}
+	});
+
+	double		simd = nanosecondsPer( LOOKUPS, [&]()
+	{
+		for( size_t i = 0; i < LOOKUPS; i++ )
+		{
+			simdHits += inlineList.contains( probes[i & 4095] );
+		}
+	});
+
+	double		set = nanosecondsPer( LOOKUPS, [&]()
+	{
+		for( size_t i = 0; i < LOOKUPS; i++ )
+		{
+			setHits += setList.contains( probes[i & 4095] );
+		}
+	});
+
+	BOOST_CHECK_EQUAL( scalarHits, simdHits );
+	BOOST_CHECK_EQUAL( setHits, simdHits );
+
+	report( "pointer list contains: scalar / SIMD", LIST_SIZE, scalar, simd );
+	report( "pointer list contains: set / SIMD", LIST_SIZE, set, simd );
+}
+
+
+BOOST_AUTO_TEST_CASE( PointerListInlineAgainstSet )
+{
+	benchmarkPointerList<4>();
+	benchmarkPointerList<8>();
+	benchmarkPointerList<16>();
+	benchmarkPointerList<32>();
+	benchmarkPointerList<64>();
+	benchmarkPointerList<128>();
+}
@@ -0,0 +1,415 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+
+#define BOOST_TEST_MODULE SparseVectorFileTest
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <boost/test/included/unit_test.hpp>
+
+#include "Utility/SparseVectorFile.h"
+
+
+
+using namespace SEFUtility;
+
+
+template<class IndexType>
+struct BasicEntry : public BasicSparseVectorEntry<IndexType>
+{
+	BasicEntry( IndexType		index )
+		: BasicSparseVectorEntry<IndexType>( index ),
+		  m_value( 0 )
+	{}
+
+	long		m_value;
+};
+
+typedef BasicEntry<size_t>		Entry;
+typedef BasicEntry<uint32_t>	CompactEntry;
+
+typedef SparseVector<Entry, 8>	Row;
+
+
+//	Removes the file when the test is done with it, whether or not the test passed
+
+class ScratchFile
+{
+public :
+
+	ScratchFile( const std::string&		name )
+		: m_filename( "/tmp/" + name + "." + std::to_string( getpid() ) )
+	{}
+
+	~ScratchFile()
+	{
+		remove( m_filename.c_str() );
+	}
+
+	const std::string&		filename() const
+	{
+		return( m_filename );
+	}
+
+private :
+
+	std::string		m_filename;
+};
+
+
+//	Fills the rows with random entries and mirrors them in the references.  Every third row is left
+//		empty and the rest run from a few entries in the inline tier up past it.
+
+static void		fillRows( std::deque<Row>&							rows,
+						  std::vector<std::map<size_t, long>>&		references,
+						  size_t									rowCount,
+						  unsigned int								seed )
+{
+	std::mt19937		random( seed );
+
+	rows.resize( rowCount );
+	references.resize( rowCount );
+
+	for( size_t row = 0; row < rowCount; row++ )
+	{
+		if( row % 3 == 0 )
+		{
+			continue;
+		}
+
+		size_t		entries = random() % 40;
+
+		for( size_t i = 0; i < entries; i++ )
+		{
+			size_t		index = random() % 1000;
+			long		value = (long)random();
+
+			rows[row].find_or_add( index ).m_value = value;
+			references[row][index] = value;
+		}
+	}
+}
+
+
+//	Every row of the mapped file holds exactly the entries of its reference, in ascending index order.
+
+static void		checkAgainst( const MappedSparseVectorFile<Entry>&				file,
+							  const std::vector<std::map<size_t, long>>&		references )
+{
+	BOOST_REQUIRE_EQUAL( file.size(), references.size() );
+
+	size_t		totalEntries = 0;
+
+	for( size_t row = 0; row < references.size(); row++ )
+	{
+		MappedSparseVectorFile<Entry>::View		view = file[row];
+
+		BOOST_REQUIRE_EQUAL( view.size(), references[row].size() );
+		BOOST_CHECK_EQUAL( view.empty(), references[row].empty() );
+
+		auto		itrReference = references[row].begin();
+		size_t		position = 0;
+
+		for( auto itrEntry = view.begin(); itrEntry != view.end(); itrEntry++, itrReference++, position++ )
+		{
+			BOOST_CHECK_EQUAL( (*itrEntry)->index(), itrReference->first );
+			BOOST_CHECK_EQUAL( (*itrEntry)->m_value, itrReference->second );
+			BOOST_CHECK_EQUAL( view.indices()[position], itrReference->first );
+		}
+
+		for( const auto& referenceEntry : references[row] )
+		{
+			const Entry*		entry = view.find( referenceEntry.first );
+
+			BOOST_REQUIRE( entry != NULL );
+			BOOST_CHECK_EQUAL( entry->m_value, referenceEntry.second );
+		}
+
+		BOOST_CHECK( view.find( 1000 ) == NULL );
+
+		totalEntries += references[row].size();
+	}
+
+	BOOST_CHECK_EQUAL( file.entryCount(), totalEntries );
+}
+
+
+//	Writes a small valid file and returns its header, so the rejection tests can patch it.
+
+static SparseVectorFile::Header		writeSmallFile( const std::string&		filename )
+{
+	std::deque<Row>							rows;
+	std::vector<std::map<size_t, long>>		references;
+
+	fillRows( rows, references, 12, 7 );
+
+	BOOST_REQUIRE( SparseVectorFile::Write( filename, rows.begin(), rows.end() ).Succeeded() );
+
+	SparseVectorFile::Header		header;
+	std::ifstream					file( filename.c_str(), std::ios::binary );
+
+	file.read( (char*)&header, sizeof( header ) );
+
+	BOOST_REQUIRE( file );
+	BOOST_REQUIRE_EQUAL( header.rowCount, 12u );
+
+	return( header );
+}
+
+static void		patchFile( const std::string&		filename,
+						   uint64_t					position,
+						   const void*				bytes,
+						   size_t					length )
+{
+	std::fstream		file( filename.c_str(), std::ios::binary | std::ios::in | std::ios::out );
+
+	file.seekp( position );
+	file.write( (const char*)bytes, length );
+
+	BOOST_REQUIRE( file );
+}
+
+template<class T, class IndexType>
+static void		checkRejected( const std::string&								filename,
+							   SparseVectorFile::ErrorCodes						expected )
+{
+	MappedSparseVectorFile<T, IndexType>		file;
+
+	auto		result = file.Open( filename );
+
+	BOOST_REQUIRE( result.Failed() );
+	BOOST_CHECK( result.errorCode() == expected );
+	BOOST_CHECK( !file.isOpen() );
+}
+
+static void		checkRejected( const std::string&				filename,
+							   SparseVectorFile::ErrorCodes		expected )
+{
+	checkRejected<Entry, size_t>( filename, expected );
+}
+
+
+
+BOOST_AUTO_TEST_CASE( RoundTripMatchesSourceRows )
+{
+	ScratchFile								scratch( "RoundTripMatchesSourceRows" );
+	std::deque<Row>							rows;
+	std::vector<std::map<size_t, long>>		references;
+
+	fillRows( rows, references, 200, 1 );
+
+	BOOST_REQUIRE( SparseVectorFile::Write( scratch.filename(), rows.begin(), rows.end() ).Succeeded() );
+
+	MappedSparseVectorFile<Entry>		file;
+
+	BOOST_REQUIRE( file.Open( scratch.filename() ).Succeeded() );
+	BOOST_CHECK( file.isOpen() );
+
+	checkAgainst( file, references );
+
+	file.Close();
+
+	BOOST_CHECK( !file.isOpen() );
+}
+
+
+BOOST_AUTO_TEST_CASE( EmptyCollectionRoundTrips )
+{
+	ScratchFile			scratch( "EmptyCollectionRoundTrips" );
+	std::deque<Row>		rows;
+
+	BOOST_REQUIRE( SparseVectorFile::Write( scratch.filename(), rows.begin(), rows.end() ).Succeeded() );
+
+	MappedSparseVectorFile<Entry>		file;
+
+	BOOST_REQUIRE( file.Open( scratch.filename() ).Succeeded() );
+	BOOST_CHECK_EQUAL( file.size(), 0u );
+	BOOST_CHECK_EQUAL( file.entryCount(), 0u );
+}
+
+
+BOOST_AUTO_TEST_CASE( AllEmptyRowsRoundTrip )
+{
+	ScratchFile								scratch( "AllEmptyRowsRoundTrip" );
+	std::deque<Row>							rows( 5 );
+	std::vector<std::map<size_t, long>>		references( 5 );
+
+	BOOST_REQUIRE( SparseVectorFile::Write( scratch.filename(), rows.begin(), rows.end() ).Succeeded() );
+
+	MappedSparseVectorFile<Entry>		file;
+
+	BOOST_REQUIRE( file.Open( scratch.filename() ).Succeeded() );
+
+	checkAgainst( file, references );
+}
+
+
+BOOST_AUTO_TEST_CASE( BadMagicIsRejected )
+{
+	ScratchFile		scratch( "BadMagicIsRejected" );
+
+	writeSmallFile( scratch.filename() );
+
+	patchFile( scratch.filename(), 0, "NOTSPVEC", 8 );
+
+	checkRejected( scratch.filename(), SparseVectorFile::ErrorCodes::BAD_HEADER );
+}
+
+
+BOOST_AUTO_TEST_CASE( BadVersionIsRejected )
+{
+	ScratchFile		scratch( "BadVersionIsRejected" );
+
+	writeSmallFile( scratch.filename() );
+
+	uint32_t		version = SparseVectorFile::VERSION + 1;
+
+	patchFile( scratch.filename(), offsetof( SparseVectorFile::Header, version ), &version, sizeof( version ) );
+
+	checkRejected( scratch.filename(), SparseVectorFile::ErrorCodes::BAD_HEADER );
+}
+
+
+BOOST_AUTO_TEST_CASE( DecreasingOffsetsAreRejected )
+{
+	ScratchFile		scratch( "DecreasingOffsetsAreRejected" );
+
+	SparseVectorFile::Header		header = writeSmallFile( scratch.filename() );
+
+	//	Row 4 ends before it starts, the first and last offsets are still right
+
+	std::vector<uint64_t>		offsets( header.rowCount + 1 );
+	std::ifstream				original( scratch.filename().c_str(), std::ios::binary );
+
+	original.seekg( header.offsetsStart );
+	original.read( (char*)offsets.data(), offsets.size() * sizeof( uint64_t ) );
+	original.close();
+
+	BOOST_REQUIRE( offsets[4] > 0 );
+
+	uint64_t		decreasing = offsets[4] - 1;
+
+	patchFile( scratch.filename(), header.offsetsStart + 5 * sizeof( uint64_t ), &decreasing, sizeof( decreasing ) );
+
+	checkRejected( scratch.filename(), SparseVectorFile::ErrorCodes::BAD_HEADER );
+}
+
+
+BOOST_AUTO_TEST_CASE( OffsetsPastEntriesAreRejected )
+{
+	ScratchFile		scratch( "OffsetsPastEntriesAreRejected" );
+
+	SparseVectorFile::Header		header = writeSmallFile( scratch.filename() );
+
+	//	A middle row runs past the entries and the next row comes back down to the end
+
+	uint64_t		pastEnd = header.entryCount + 1000;
+
+	patchFile( scratch.filename(), header.offsetsStart + 6 * sizeof( uint64_t ), &pastEnd, sizeof( pastEnd ) );
+
+	checkRejected( scratch.filename(), SparseVectorFile::ErrorCodes::BAD_HEADER );
+}
+
+
+BOOST_AUTO_TEST_CASE( NonZeroFirstOffsetIsRejected )
+{
+	ScratchFile		scratch( "NonZeroFirstOffsetIsRejected" );
+
+	SparseVectorFile::Header		header = writeSmallFile( scratch.filename() );
+
+	uint64_t		first = 1;
+
+	patchFile( scratch.filename(), header.offsetsStart, &first, sizeof( first ) );
+
+	checkRejected( scratch.filename(), SparseVectorFile::ErrorCodes::BAD_HEADER );
+}
+
+
+BOOST_AUTO_TEST_CASE( DifferentLayoutIsRejected )
+{
+	ScratchFile		scratch( "DifferentLayoutIsRejected" );
+
+	writeSmallFile( scratch.filename() );
+
+	//	Narrower indices and a different entry size
+
+	checkRejected<CompactEntry, uint32_t>( scratch.filename(), SparseVectorFile::ErrorCodes::LAYOUT_MISMATCH );
+	checkRejected<Entry, uint32_t>( scratch.filename(), SparseVectorFile::ErrorCodes::LAYOUT_MISMATCH );
+}
+
+
+BOOST_AUTO_TEST_CASE( TruncatedFileIsRejected )
+{
+	ScratchFile		scratch( "TruncatedFileIsRejected" );
+
+	SparseVectorFile::Header		header = writeSmallFile( scratch.filename() );
+
+	BOOST_REQUIRE_EQUAL( truncate( scratch.filename().c_str(), header.fileSize - 1 ), 0 );
+
+	checkRejected( scratch.filename(), SparseVectorFile::ErrorCodes::TRUNCATED );
+
+	//	Too short for even the header
+
+	BOOST_REQUIRE_EQUAL( truncate( scratch.filename().c_str(), sizeof( SparseVectorFile::Header ) / 2 ), 0 );
+
+	checkRejected( scratch.filename(), SparseVectorFile::ErrorCodes::TRUNCATED );
+}
+
+
+BOOST_AUTO_TEST_CASE( MissingFileFailsToOpen )
+{
+	checkRejected( "/tmp/SparseVectorFileTest.does.not.exist", SparseVectorFile::ErrorCodes::OPEN_FAILED );
+}
+
+
+BOOST_AUTO_TEST_CASE( HugeCountsAreRejectedWithoutOverflow )
+{
+	ScratchFile		scratch( "HugeCountsAreRejectedWithoutOverflow" );
+
+	writeSmallFile( scratch.filename() );
+
+	//	A row count this large would wrap the section arithmetic back inside the file
+
+	uint64_t		rowCount = ~(uint64_t)0 / sizeof( uint64_t );
+
+	patchFile( scratch.filename(), offsetof( SparseVectorFile::Header, rowCount ), &rowCount, sizeof( rowCount ) );
+
+	checkRejected( scratch.filename(), SparseVectorFile::ErrorCodes::TRUNCATED );
+}
@@ -0,0 +1,761 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+#define BOOST_TEST_MODULE SparseVectorTest
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/test/included/unit_test.hpp>
+
+#include "Utility/DenseIndexMap.h"
+#include "Utility/FlatIndexMap.h"
+#include "Utility/SparseVector.h"
+
+
+
+using namespace SEFUtility;
+
+
+template<class IndexType>
+struct BasicEntry : public BasicSparseVectorEntry<IndexType>
+{
+	BasicEntry( IndexType		index )
+		: BasicSparseVectorEntry<IndexType>( index ),
+		  m_value( 0 )
+	{}
+
+	long		m_value;
+};
+
+typedef BasicEntry<size_t>		Entry;
+typedef BasicEntry<uint32_t>	CompactEntry;
+
+
+//	Every entry in the vector carries the value the reference holds for its index, and every index in the
+//		reference can be found.
+
+template<class Vector, class IndexType>
+static void		checkAgainst( Vector&									vector,
+							  const std::map<IndexType, long>&			reference )
+{
+	BOOST_REQUIRE_EQUAL( vector.size(), reference.size() );
+
+	size_t		visited = 0;
+
+	for( auto itrEntry = vector.begin(); itrEntry != vector.end(); itrEntry++ )
+	{
+		auto		itrReference = reference.find( (*itrEntry)->index() );
+
+		BOOST_REQUIRE( itrReference != reference.end() );
+		BOOST_CHECK_EQUAL( (*itrEntry)->m_value, itrReference->second );
+
+		visited++;
+	}
+
+	BOOST_CHECK_EQUAL( visited, reference.size() );
+
+	for( const auto& referenceEntry : reference )
+	{
+		auto*		entry = vector.find( referenceEntry.first );
+
+		BOOST_REQUIRE( entry != NULL );
+		BOOST_CHECK_EQUAL( entry->index(), referenceEntry.first );
+		BOOST_CHECK_EQUAL( entry->m_value, referenceEntry.second );
+	}
+}
+
+
+//	Adds and erases random indices in [0, range) and checks the vector against a std::map after each step.
+
+template<class Vector>
+static void		churnAgainstMap( Vector&		vector,
+								 size_t			range,
+								 size_t			steps,
+								 unsigned int	seed )
+{
+	typedef typename Vector::index_type		IndexType;
+
+	std::map<IndexType, long>		reference;
+	std::mt19937					random( seed );
+
+	for( size_t step = 0; step < steps; step++ )
+	{
+		IndexType		index = (IndexType)( random() % range );
+
+		if( random() % 3 == 0 )
+		{
+			vector.erase( index );
+			reference.erase( index );
+		}
+		else
+		{
+			vector.find_or_add( index ).m_value += (long)step;
+			reference[index] += (long)step;
+		}
+
+		BOOST_REQUIRE_EQUAL( vector.size(), reference.size() );
+
+		IndexType		probe = (IndexType)( random() % ( range + 8 ) );
+
+		BOOST_REQUIRE_EQUAL( vector.find( probe ) != NULL, reference.count( probe ) == 1 );
+	}
+
+	checkAgainst( vector, reference );
+}
+
+
+
+BOOST_AUTO_TEST_CASE( FindIndexMatchesScalarScan )
+{
+	//	Every count up to a few SIMD blocks, so each count exercises a different split between the vector
+	//		loop and the scalar tail.
+
+	for( size_t count = 0; count <= 40; count++ )
+	{
+		std::vector<uint64_t>		wideKeys( count );
+		std::vector<uint32_t>		narrowKeys( count );
+
+		for( size_t i = 0; i < count; i++ )
+		{
+			wideKeys[i] = 0x100000000ULL * ( i % 3 ) + i * 7 + 1;
+			narrowKeys[i] = (uint32_t)( i * 7 + 1 );
+		}
+
+		for( size_t i = 0; i < count; i++ )
+		{
+			BOOST_CHECK_EQUAL( SIMD::findIndex( wideKeys.data(), count, wideKeys[i] ), (int)i );
+			BOOST_CHECK_EQUAL( SIMD::findIndex( narrowKeys.data(), count, narrowKeys[i] ), (int)i );
+		}
+
+		//	Matching only the low or the high half of a 64 bit key is not a match
+
+		BOOST_CHECK_EQUAL( SIMD::findIndex( wideKeys.data(), count, (uint64_t)0 ), -1 );
+		BOOST_CHECK_EQUAL( SIMD::findIndex( wideKeys.data(), count, (uint64_t)( 8 | 0x200000000ULL ) ), -1 );
+		BOOST_CHECK_EQUAL( SIMD::findIndex( narrowKeys.data(), count, (uint32_t)0 ), -1 );
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE( FindIndexReturnsFirstMatch )
+{
+	uint32_t		keys[] = { 9, 3, 5, 3, 3, 5, 9, 3, 5, 1 };
+
+	BOOST_CHECK_EQUAL( SIMD::findIndex( keys, 10, (uint32_t)3 ), 1 );
+	BOOST_CHECK_EQUAL( SIMD::findIndex( keys, 10, (uint32_t)1 ), 9 );
+
+	//	Keys past the count are not looked at
+
+	BOOST_CHECK_EQUAL( SIMD::findIndex( keys, 9, (uint32_t)1 ), -1 );
+}
+
+
+BOOST_AUTO_TEST_CASE( InlineTierMatchesMap )
+{
+	//	The range is below the inline capacity, so the vector never leaves the inline tier
+
+	SparseVector<Entry, 64>			wide;
+	SparseVector<CompactEntry, 64>	narrow;
+
+	churnAgainstMap( wide, 48, 5000, 1 );
+	churnAgainstMap( narrow, 48, 5000, 2 );
+
+	BOOST_CHECK( wide.tier() == decltype( wide )::Tier::INLINE );
+	BOOST_CHECK( narrow.tier() == decltype( narrow )::Tier::INLINE );
+}
+
+
+BOOST_AUTO_TEST_CASE( InlineEraseKeepsIndicesWithTheirEntries )
+{
+	//	Erasing moves the last entry into the hole, its index has to move with it
+
+	SparseVector<Entry, 8>		vector;
+
+	for( size_t i = 0; i < 6; i++ )
+	{
+		vector.find_or_add( i * 10 ).m_value = (long)i;
+	}
+
+	vector.erase( 10 );
+	vector.erase( 0 );
+
+	BOOST_REQUIRE_EQUAL( vector.size(), 4 );
+	BOOST_CHECK( vector.find( 0 ) == NULL );
+	BOOST_CHECK( vector.find( 10 ) == NULL );
+
+	for( size_t i = 2; i < 6; i++ )
+	{
+		BOOST_REQUIRE( vector.find( i * 10 ) != NULL );
+		BOOST_CHECK_EQUAL( vector.find( i * 10 )->m_value, (long)i );
+	}
+}
+
+
+//	Hash tables yield references to entries rather than pointers, and are checked the same way
+
+template<class Table, class IndexType>
+static void		checkTableAgainst( Table&								table,
+								   const std::map<IndexType, long>&		reference )
+{
+	BOOST_REQUIRE_EQUAL( table.size(), reference.size() );
+
+	size_t		visited = 0;
+
+	for( auto& entry : table )
+	{
+		auto		itrReference = reference.find( entry.index() );
+
+		BOOST_REQUIRE( itrReference != reference.end() );
+		BOOST_CHECK_EQUAL( entry.m_value, itrReference->second );
+
+		visited++;
+	}
+
+	BOOST_CHECK_EQUAL( visited, reference.size() );
+
+	for( const auto& referenceEntry : reference )
+	{
+		BOOST_REQUIRE( table.find( referenceEntry.first ) != NULL );
+		BOOST_CHECK_EQUAL( table.find( referenceEntry.first )->m_value, referenceEntry.second );
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE( FlatIndexMapGrowsFromSmallestTable )
+{
+	FlatIndexMap<Entry>			table;
+	std::map<size_t, long>		reference;
+
+	BOOST_CHECK_EQUAL( table.capacity(), FlatHashing::GROUP_WIDTH );
+
+	for( size_t i = 0; i < 20000; i++ )
+	{
+		size_t		index = i * 7919;
+		size_t		capacity = table.capacity();
+
+		table.find_or_add( index ).m_value = (long)i;
+		reference[index] = (long)i;
+
+		//	Each growth doubles the table, leaving it just under half full
+
+		if( table.capacity() != capacity )
+		{
+			BOOST_REQUIRE_EQUAL( table.capacity(), capacity * 2 );
+			BOOST_REQUIRE( table.size() * 16 > table.capacity() * 7 );
+		}
+	}
+
+	checkTableAgainst( table, reference );
+
+	//	The table keeps at least one slot in eight free
+
+	BOOST_CHECK( table.size() <= table.capacity() - table.capacity() / 8 );
+	BOOST_CHECK( table.find( 1 ) == NULL );
+}
+
+
+BOOST_AUTO_TEST_CASE( FlatIndexMapTombstonesDoNotBreakProbes )
+{
+	//	A full table of colliding runs, then half the entries erased.  The later entries of each probe
+	//		sequence must still be found past the tombstones, and reusing the tombstones must not
+	//		duplicate an index.
+
+	FlatIndexMap<Entry>			table( 1024 );
+	std::map<size_t, long>		reference;
+
+	for( size_t i = 0; i < 800; i++ )
+	{
+		table.find_or_add( i ).m_value = (long)i;
+		reference[i] = (long)i;
+	}
+
+	for( size_t i = 0; i < 800; i += 2 )
+	{
+		BOOST_CHECK( table.erase( i ) );
+		BOOST_CHECK( !table.erase( i ) );
+
+		reference.erase( i );
+	}
+
+	checkTableAgainst( table, reference );
+
+	for( size_t i = 0; i < 800; i++ )
+	{
+		table.find_or_add( i ).m_value += 1000;
+		reference[i] += 1000;
+	}
+
+	checkTableAgainst( table, reference );
+}
+
+
+BOOST_AUTO_TEST_CASE( FlatIndexMapChurnDoesNotGrowTable )
+{
+	//	Steady insert and erase at a constant size fills the table with tombstones, which a rehash at the
+	//		same capacity has to clear rather than the table doubling each time.
+
+	FlatIndexMap<Entry>			table;
+	std::map<size_t, long>		reference;
+
+	for( size_t i = 0; i < 1000; i++ )
+	{
+		table.find_or_add( i ).m_value = (long)i;
+		reference[i] = (long)i;
+	}
+
+	size_t		capacity = table.capacity();
+
+	for( size_t i = 1000; i < 200000; i++ )
+	{
+		table.erase( i - 1000 );
+		reference.erase( i - 1000 );
+
+		table.find_or_add( i ).m_value = (long)i;
+		reference[i] = (long)i;
+	}
+
+	checkTableAgainst( table, reference );
+
+	BOOST_CHECK_EQUAL( table.capacity(), capacity );
+}
+
+
+BOOST_AUTO_TEST_CASE( FlatIndexMapBatchesMatchSingleOperations )
+{
+	FlatIndexMap<Entry>			table;
+	std::map<size_t, long>		reference;
+	std::mt19937				random( 3 );
+
+	for( size_t round = 0; round < 50; round++ )
+	{
+		std::vector<size_t>		indices( 1 + random() % 100 );
+		std::vector<Entry*>		results( indices.size() );
+
+		for( size_t& index : indices )
+		{
+			index = random() % 5000;
+		}
+
+		//	The batch may repeat an index, each copy gets the same entry
+
+		table.find_or_add_many( indices.data(), indices.size(), results.data() );
+
+		for( size_t i = 0; i < indices.size(); i++ )
+		{
+			BOOST_REQUIRE( results[i] != NULL );
+			BOOST_REQUIRE_EQUAL( results[i]->index(), indices[i] );
+
+			results[i]->m_value++;
+			reference[indices[i]]++;
+		}
+
+		for( size_t& index : indices )
+		{
+			index = random() % 5000;
+		}
+
+		size_t		expected = 0;
+
+		for( size_t index : indices )
+		{
+			expected += reference.erase( index );
+		}
+
+		BOOST_CHECK_EQUAL( table.erase_many( indices.data(), indices.size() ), expected );
+		BOOST_CHECK_EQUAL( table.find_many( indices.data(), indices.size(), results.data() ), 0 );
+	}
+
+	checkTableAgainst( table, reference );
+}
+
+
+BOOST_AUTO_TEST_CASE( FlatIndexMapChunksCoverEveryEntryOnce )
+{
+	FlatIndexMap<Entry>			table;
+	std::map<size_t, long>		seen;
+
+	for( size_t i = 0; i < 3000; i++ )
+	{
+		table.find_or_add( i * 3 );
+	}
+
+	table.for_each_chunk( [&]( const size_t*		indices,
+							   Entry*				entries,
+							   size_t				count )
+	{
+		for( size_t i = 0; i < count; i++ )
+		{
+			BOOST_REQUIRE_EQUAL( indices[i], entries[i].index() );
+
+			seen[indices[i]]++;
+		}
+	});
+
+	BOOST_REQUIRE_EQUAL( seen.size(), 3000 );
+
+	for( const auto& entry : seen )
+	{
+		BOOST_CHECK_EQUAL( entry.second, 1 );
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE( MapTierMatchesMap )
+{
+	//	The dense tier is turned off so every cut over vector stays in the hash table
+
+	SparseVector<Entry, 8, FixedCutoverPolicy<50, 0>>			wide;
+	SparseVector<CompactEntry, 8, FixedCutoverPolicy<50, 0>>	narrow;
+
+	churnAgainstMap( wide, 1000, 20000, 4 );
+	churnAgainstMap( narrow, 1000, 20000, 5 );
+
+	BOOST_CHECK( wide.tier() == decltype( wide )::Tier::MAP );
+	BOOST_CHECK( narrow.tier() == decltype( narrow )::Tier::MAP );
+}
+
+
+BOOST_AUTO_TEST_CASE( CutoverAndDemotionKeepEntries )
+{
+	//	Indices far apart keep the vector out of the dense tier.  It cuts over past the inline capacity of 8
+	//		and only moves back inline once erasures take it down to DEMOTION_SIZE, half the capacity.
+
+	typedef SparseVector<Entry, 8>		Vector;
+
+	Vector						vector;
+	std::map<size_t, long>		reference;
+
+	for( size_t i = 0; i < 9; i++ )
+	{
+		vector.find_or_add( i * 1000 ).m_value = (long)i;
+		reference[i * 1000] = (long)i;
+
+		BOOST_CHECK( vector.tier() == ( i < 8 ? Vector::Tier::INLINE : Vector::Tier::MAP ) );
+	}
+
+	checkAgainst( vector, reference );
+
+	for( size_t i = 0; i < 5; i++ )
+	{
+		vector.erase( i * 1000 );
+		reference.erase( i * 1000 );
+
+		BOOST_CHECK( vector.tier() == ( reference.size() > Vector::DEMOTION_SIZE ? Vector::Tier::MAP : Vector::Tier::INLINE ) );
+	}
+
+	BOOST_CHECK( vector.tier() == Vector::Tier::INLINE );
+
+	checkAgainst( vector, reference );
+
+	//	Growing again past the capacity cuts over again with everything in place
+
+	for( size_t i = 10; i < 20; i++ )
+	{
+		vector.find_or_add( i * 1000 ).m_value = (long)i;
+		reference[i * 1000] = (long)i;
+	}
+
+	BOOST_CHECK( vector.tier() == Vector::Tier::MAP );
+
+	checkAgainst( vector, reference );
+}
+
+
+BOOST_AUTO_TEST_CASE( ErasingAnAbsentIndexKeepsTheTier )
+{
+	typedef SparseVector<Entry, 8>		Vector;
+
+	Vector		vector;
+
+	vector.reserve( 100 );
+
+	BOOST_REQUIRE( vector.tier() == Vector::Tier::MAP );
+
+	vector.find_or_add( 5 );
+	vector.erase( 12345 );
+
+	BOOST_CHECK( vector.tier() == Vector::Tier::MAP );
+
+	size_t		absent[] = { 1, 2, 3 };
+
+	BOOST_CHECK_EQUAL( vector.erase_many( absent, 3 ), 0 );
+	BOOST_CHECK( vector.tier() == Vector::Tier::MAP );
+
+	//	An erasure that removes an entry still demotes
+
+	vector.erase( 5 );
+
+	BOOST_CHECK( vector.tier() == Vector::Tier::INLINE );
+	BOOST_CHECK( vector.empty() );
+}
+
+
+BOOST_AUTO_TEST_CASE( CacheLinePolicyFillsWholeLines )
+{
+	typedef SparseVector<Entry, AUTO_CUTOVER_SIZE, CacheLineCutoverPolicy<2>>			Wide;
+	typedef SparseVector<CompactEntry, AUTO_CUTOVER_SIZE, CacheLineCutoverPolicy<1>>	Narrow;
+
+	const size_t		WIDE_BYTES = sizeof( Entry ) + sizeof( size_t );
+	const size_t		NARROW_BYTES = sizeof( CompactEntry ) + sizeof( uint32_t );
+
+	BOOST_REQUIRE_EQUAL( NARROW_BYTES, 20 );
+
+	//	As many entries as fit in the lines, and at least four however many lines that takes
+
+	BOOST_CHECK( Wide::INLINE_CAPACITY * WIDE_BYTES <= 128 );
+	BOOST_CHECK( ( Wide::INLINE_CAPACITY + 1 ) * WIDE_BYTES > 128 );
+
+	//	Four 20 byte entries take more than the one line asked for, so they get two
+
+	BOOST_CHECK( Narrow::INLINE_CAPACITY >= 4 );
+	BOOST_CHECK( Narrow::INLINE_CAPACITY * NARROW_BYTES <= 128 );
+	BOOST_CHECK( ( Narrow::INLINE_CAPACITY + 1 ) * NARROW_BYTES > 128 );
+
+	Wide		vector;
+
+	churnAgainstMap( vector, 4 * Wide::INLINE_CAPACITY, 2000, 6 );
+}
+
+
+BOOST_AUTO_TEST_CASE( SpikesAndShrinksMatchMap )
+{
+	//	Repeatedly grow far past the cutover and shrink back to nothing, through every tier
+
+	typedef SparseVector<Entry, 16>		Vector;
+
+	Vector						vector;
+	std::map<size_t, long>		reference;
+	std::mt19937				random( 7 );
+
+	bool		visited[3] = { false, false, false };
+
+	for( size_t round = 0; round < 6; round++ )
+	{
+		//	Even rounds scatter the indices, odd rounds cluster them so the dense tier is used
+
+		size_t		range = round % 2 ? 600 : 1000000;
+
+		for( size_t i = 0; i < 500; i++ )
+		{
+			size_t		index = random() % range;
+
+			vector.find_or_add( index ).m_value += (long)i;
+			reference[index] += (long)i;
+
+			visited[(size_t)vector.tier()] = true;
+		}
+
+		checkAgainst( vector, reference );
+
+		while( !reference.empty() )
+		{
+			size_t		index = reference.begin()->first;
+
+			vector.erase( index + 1 );
+			reference.erase( index + 1 );
+
+			vector.erase( index );
+			reference.erase( index );
+
+			BOOST_REQUIRE_EQUAL( vector.size(), reference.size() );
+
+			visited[(size_t)vector.tier()] = true;
+		}
+
+		BOOST_CHECK( vector.tier() == Vector::Tier::INLINE );
+	}
+
+	BOOST_CHECK( visited[(size_t)Vector::Tier::INLINE] );
+	BOOST_CHECK( visited[(size_t)Vector::Tier::MAP] );
+	BOOST_CHECK( visited[(size_t)Vector::Tier::DENSE] );
+}
+
+
+
+//	An entry that owns memory, so a window that moves entries without constructing or destroying them
+//		properly shows up as a leak or a bad read.
+
+struct OwningEntry : public SparseVectorEntry
+{
+	OwningEntry( size_t		index )
+		: SparseVectorEntry( index ),
+		  m_value( 0 ),
+		  m_name( std::to_string( index ) + " is long enough to live on the heap" )
+	{}
+
+	long			m_value;
+	std::string		m_name;
+};
+
+
+BOOST_AUTO_TEST_CASE( DenseWindowGrowsBothWays )
+{
+	DenseIndexMap<OwningEntry>		window( 1000, 1010 );
+	std::map<size_t, long>			reference;
+
+	BOOST_CHECK_EQUAL( window.base(), 1000 );
+	BOOST_CHECK_EQUAL( window.span(), 64 );
+
+	//	Upwards past the end, then downwards past the base, then far below it so the base clamps to zero
+
+	size_t		indices[] = { 1000, 1063, 1064, 1500, 999, 936, 935, 500, 7, 0, 3000 };
+
+	for( size_t index : indices )
+	{
+		window.emplace_unique( index ).m_value = (long)index * 2;
+		reference[index] = (long)index * 2;
+
+		BOOST_REQUIRE( window.covers( index ) );
+
+		checkTableAgainst( window, reference );
+	}
+
+	BOOST_CHECK_EQUAL( window.base(), 0 );
+
+	for( size_t index : indices )
+	{
+		BOOST_CHECK_EQUAL( window.find( index )->m_name, std::to_string( index ) + " is long enough to live on the heap" );
+	}
+
+	BOOST_CHECK( window.find( 1 ) == NULL );
+	BOOST_CHECK( window.find( 1000000 ) == NULL );
+}
+
+
+BOOST_AUTO_TEST_CASE( DenseWindowIteratesInIndexOrder )
+{
+	DenseIndexMap<Entry, uint32_t>		window( 64, 200 );
+	std::map<uint32_t, long>			reference;
+
+	for( uint32_t index = 64; index < 200; index += 3 )
+	{
+		window.emplace_unique( index ).m_value = index;
+		reference[index] = index;
+	}
+
+	BOOST_CHECK( window.erase( 67 ) );
+	BOOST_CHECK( !window.erase( 67 ) );
+	BOOST_CHECK( !window.erase( 68 ) );
+	BOOST_CHECK( !window.erase( 5000 ) );
+
+	reference.erase( 67 );
+
+	std::vector<uint32_t>		fromIterator;
+	std::vector<uint32_t>		fromChunks;
+	std::vector<uint32_t>		fromSlots;
+
+	for( const Entry& entry : window )
+	{
+		fromIterator.push_back( (uint32_t)entry.index() );
+	}
+
+	window.for_each_chunk( [&]( const uint32_t*		indices,
+								Entry*				entries,
+								size_t				count )
+	{
+		for( size_t i = 0; i < count; i++ )
+		{
+			BOOST_REQUIRE_EQUAL( indices[i], entries[i].index() );
+
+			fromChunks.push_back( indices[i] );
+		}
+	});
+
+	for( size_t first = 0; first < window.span(); first += 64 )
+	{
+		window.for_each_in_slots( first, first + 64, [&]( Entry&		entry ) { fromSlots.push_back( (uint32_t)entry.index() ); } );
+	}
+
+	std::vector<uint32_t>		expected;
+
+	for( const auto& entry : reference )
+	{
+		expected.push_back( entry.first );
+	}
+
+	BOOST_CHECK( fromIterator == expected );
+	BOOST_CHECK( fromChunks == expected );
+	BOOST_CHECK( fromSlots == expected );
+}
+
+
+BOOST_AUTO_TEST_CASE( DenseTierMatchesMap )
+{
+	//	A clustered range keeps the cut over vector in the dense tier
+
+	SparseVector<OwningEntry, 8>		vector;
+
+	churnAgainstMap( vector, 200, 20000, 8 );
+
+	BOOST_CHECK( vector.tier() == decltype( vector )::Tier::DENSE );
+}
+
+
+//	Each entry's value is bumped once, concurrently; the reduce sums the bumped values
+
+template<class Vector>
+static void		checkParallelVisits( Vector&		vector,
+									 long			count )
+{
+	vector.parallel_for_each( []( Entry&		entry ) { entry.m_value++; } );
+
+	long		sum = vector.parallel_reduce( (long)0, []( Entry& entry ) { return( entry.m_value ); }, []( long a, long b ) { return( a + b ); } );
+	long		counted = vector.parallel_reduce( (long)0, []( Entry& ) { return( (long)1 ); }, []( long a, long b ) { return( a + b ); } );
+
+	BOOST_CHECK_EQUAL( counted, count );
+	BOOST_CHECK_EQUAL( sum, count * ( count + 1 ) / 2 );
+}
+
+BOOST_AUTO_TEST_CASE( ParallelForEachVisitsEveryEntryOnce )
+{
+	//	One vector per tier, large enough to be split across many blocks
+
+	SparseVector<Entry, 16, FixedCutoverPolicy<50, 0>>		map;
+	SparseVector<Entry, 16>									dense;
+	SparseVector<Entry, 16>									inline_;
+
+	for( size_t i = 0; i < 100000; i++ )
+	{
+		map.find_or_add( i * 7919 ).m_value = (long)i;
+		dense.find_or_add( i + 500 ).m_value = (long)i;
+	}
+
+	for( size_t i = 0; i < 10; i++ )
+	{
+		inline_.find_or_add( i ).m_value = (long)i;
+	}
+
+	BOOST_REQUIRE( map.tier() == decltype( map )::Tier::MAP );
+	BOOST_REQUIRE( dense.tier() == decltype( dense )::Tier::DENSE );
+
+	checkParallelVisits( map, 100000 );
+	checkParallelVisits( dense, 100000 );
+	checkParallelVisits( inline_, 10 );
+}
@@ -0,0 +1,460 @@
+/*
+Copyright (c) 2013 Stephan Friedl
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Except as contained in this notice, the name(s) of the above copyright holders
+shall not be used in advertising or otherwise to promote the sale, use or other
+dealings in this Software without prior written authorization.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+ */
+
+
+
+
+
+#define BOOST_TEST_MODULE TieringStatsTest
+
+//	The counters only exist with the define, and TieringStatsLogger writes through Logging, so build this test
+//		with Logging.cpp and ConfigManager.cpp and link boost_log.
+
+#define SEFUTILITY_TIERING_STATS
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/sinks/sync_frontend.hpp>
+#include <boost/log/sinks/text_ostream_backend.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+#include "Utility/DenseIndexMap.h"
+#include "Utility/FlatIndexMap.h"
+#include "Utility/SparseVector.h"
+#include "Utility/TieringStatsLogger.h"
+
+
+
+using namespace SEFUtility;
+
+
+struct Entry : public BasicSparseVectorEntry<size_t>
+{
+	Entry( size_t		index )
+		: BasicSparseVectorEntry<size_t>( index ),
+		  m_value( 0 )
+	{}
+
+	long		m_value;
+};
+
+
+//	The counters are shared by every container of a type, so each test uses a type of its own and starts
+//		from zero.  The dense tier is off for the map tests so the sequence of tiers is known.
+
+typedef FixedCutoverPolicy<50, 0>		NoDensePolicy;
+
+typedef SparseVector<Entry, 8, NoDensePolicy>		CutoverVector;
+typedef SparseVector<Entry, 8>						DenseVector;
+typedef SparseVector<Entry, 2, NoDensePolicy>		ProbeVector;
+typedef SparseVector<Entry, 6, NoDensePolicy>		LoggedVector;
+
+typedef SearchablePointerList<Entry, 4>				PointerList;
+
+typedef FlatIndexMap<Entry, size_t>					EntryMap;
+
+
+template<class Container>
+static TieringReport		reportFor()
+{
+	return( TieringStats::countersFor<Container>().report() );
+}
+
+template<class Container>
+static void					checkAllReleased()
+{
+	TieringReport		report = reportFor<Container>();
+
+	for( size_t tier = 0; tier < TIERING_TIER_COUNT; tier++ )
+	{
+		BOOST_CHECK_EQUAL( report.m_live[tier], 0 );
+		BOOST_CHECK_EQUAL( report.m_bytes[tier], 0 );
+	}
+}
+
+template<class Vector>
+static void					addEntries( Vector&		vector,
+										size_t		count,
+										size_t		stride )
+{
+	for( size_t i = 0; i < count; i++ )
+	{
+		vector.find_or_add( i * stride ).m_value = (long)i;
+	}
+}
+
+static size_t				mapBytes( size_t		initialCapacity )
+{
+	EntryMap		map( initialCapacity );
+
+	return( map.memoryUsed() );
+}
+
+
+//	Captures everything logged into a string, in place of the console and file sinks Logging sets up
+
+class CapturedLog
+{
+public :
+
+	typedef boost::log::sinks::synchronous_sink<boost::log::sinks::text_ostream_backend>		CaptureSink;
+
+
+	CapturedLog()
+		: m_output( new std::ostringstream ),
+		  m_sink( boost::make_shared<CaptureSink>() )
+	{
+		m_sink->locked_backend()->add_stream( m_output );
+		m_sink->set_formatter( boost::log::expressions::stream << boost::log::expressions::smessage );
+
+		boost::log::core::get()->remove_all_sinks();
+		boost::log::core::get()->add_sink( m_sink );
+	}
+
+	~CapturedLog()
+	{
+		boost::log::core::get()->remove_sink( m_sink );
+	}
+
+
+	//	Read under the backend lock, the logger thread may be writing
+
+	std::string		text() const
+	{
+		CaptureSink::locked_backend_ptr		backend = m_sink->locked_backend();
+
+		return( m_output->str() );
+	}
+
+
+private :
+
+	boost::shared_ptr<std::ostringstream>		m_output;
+	boost::shared_ptr<CaptureSink>				m_sink;
+};
+
+
+
+BOOST_AUTO_TEST_CASE( CutoversAndSizeHistogram )
+{
+	{
+		//	Cuts over on the ninth insert with the eight inline entries, the second does the same and the
+		//		third cuts over empty through reserve()
+
+		CutoverVector		first;
+		CutoverVector		second;
+		CutoverVector		reserved;
+
+		addEntries( first, 9, 3 );
+		addEntries( second, 20, 5 );
+		reserved.reserve( 100 );
+
+		TieringReport		report = reportFor<CutoverVector>();
+
+		BOOST_CHECK_EQUAL( report.cutovers(), 3u );
+		BOOST_CHECK_EQUAL( report.m_transitions[TIERING_TIER_INLINE][TIERING_TIER_MAP], 3u );
+		BOOST_CHECK_EQUAL( report.m_transitions[TIERING_TIER_MAP][TIERING_TIER_INLINE], 0u );
+
+		BOOST_CHECK_EQUAL( report.m_cutoverSizes[3], 2u );
+		BOOST_CHECK_EQUAL( report.m_cutoverSizes[0], 1u );
+
+		uint64_t		histogramTotal = 0;
+
+		for( size_t bucket = 0; bucket < TIERING_HISTOGRAM_BUCKETS; bucket++ )
+		{
+			histogramTotal += report.m_cutoverSizes[bucket];
+		}
+
+		BOOST_CHECK_EQUAL( histogramTotal, report.cutovers() );
+
+		BOOST_CHECK_EQUAL( report.m_live[TIERING_TIER_INLINE], 0 );
+		BOOST_CHECK_EQUAL( report.m_live[TIERING_TIER_MAP], 3 );
+
+		//	Erasing the second down to half the cutover size moves it back inline, which is not a cutover
+
+		for( size_t i = 20; i > 4; i-- )
+		{
+			second.erase( ( i - 1 ) * 5 );
+		}
+
+		BOOST_CHECK( second.tier() == CutoverVector::Tier::INLINE );
+
+		report = reportFor<CutoverVector>();
+
+		BOOST_CHECK_EQUAL( report.cutovers(), 3u );
+		BOOST_CHECK_EQUAL( report.m_transitions[TIERING_TIER_MAP][TIERING_TIER_INLINE], 1u );
+		BOOST_CHECK_EQUAL( report.m_live[TIERING_TIER_INLINE], 1 );
+		BOOST_CHECK_EQUAL( report.m_live[TIERING_TIER_MAP], 2 );
+
+		//	The vectors count as inline bytes whatever their tier, the tables as map bytes.  The first was
+		//		sized for four times the cutover when it cut over and the reserved one for its 100 entries.
+
+		BOOST_CHECK_EQUAL( report.m_bytes[TIERING_TIER_INLINE], (int64_t)( 3 * sizeof( CutoverVector )) );
+		BOOST_CHECK_EQUAL( report.m_bytes[TIERING_TIER_MAP], (int64_t)( mapBytes( 8 * 4 ) + mapBytes( 100 )) );
+		BOOST_CHECK_EQUAL( report.m_bytes[TIERING_TIER_DENSE], 0 );
+	}
+
+	checkAllReleased<CutoverVector>();
+}
+
+
+BOOST_AUTO_TEST_CASE( DenseTierBytes )
+{
+	{
+		//	Nine consecutive indices cut over to the map and straight on into the dense tier
+
+		DenseVector		vector;
+
+		addEntries( vector, 9, 1 );
+
+		BOOST_CHECK( vector.tier() == DenseVector::Tier::DENSE );
+
+		TieringReport		report = reportFor<DenseVector>();
+
+		BOOST_CHECK_EQUAL( report.cutovers(), 1u );
+		BOOST_CHECK_EQUAL( report.m_transitions[TIERING_TIER_INLINE][TIERING_TIER_MAP], 1u );
+		BOOST_CHECK_EQUAL( report.m_transitions[TIERING_TIER_MAP][TIERING_TIER_DENSE], 1u );
+		BOOST_CHECK_EQUAL( report.m_cutoverSizes[3], 1u );
+
+		BOOST_CHECK_EQUAL( report.m_live[TIERING_TIER_MAP], 0 );
+		BOOST_CHECK_EQUAL( report.m_live[TIERING_TIER_DENSE], 1 );
+
+		DenseIndexMap<Entry, size_t>		sameSpan( 0, 8 );
+
+		BOOST_CHECK_EQUAL( report.m_bytes[TIERING_TIER_INLINE], (int64_t)sizeof( DenseVector ) );
+		BOOST_CHECK_EQUAL( report.m_bytes[TIERING_TIER_MAP], 0 );
+		BOOST_CHECK_EQUAL( report.m_bytes[TIERING_TIER_DENSE], (int64_t)sameSpan.memoryUsed() );
+
+		//	A moved vector takes the dense table with it, the empty source is back inline
+
+		DenseVector		moved( std::move( vector ) );
+
+		report = reportFor<DenseVector>();
+
+		BOOST_CHECK_EQUAL( report.m_live[TIERING_TIER_INLINE], 1 );
+		BOOST_CHECK_EQUAL( report.m_live[TIERING_TIER_DENSE], 1 );
+		BOOST_CHECK_EQUAL( report.m_bytes[TIERING_TIER_INLINE], (int64_t)( 2 * sizeof( DenseVector )) );
+		BOOST_CHECK_EQUAL( report.m_bytes[TIERING_TIER_DENSE], (int64_t)sameSpan.memoryUsed() );
+	}
+
+	checkAllReleased<DenseVector>();
+}
+
+
+BOOST_AUTO_TEST_CASE( ProbeAverages )
+{
+	//	Cutting over at 2 sizes the table for 8, a single group, so every lookup probes exactly one group
+
+	BOOST_REQUIRE_EQUAL( EntryMap( 2 * 4 ).capacity(), FlatHashing::GROUP_WIDTH );
+
+	ProbeVector		vector;
+
+	addEntries( vector, 10, 7 );
+
+	BOOST_REQUIRE( vector.tier() == ProbeVector::Tier::MAP );
+
+	TieringReport		before = reportFor<ProbeVector>();
+
+	for( size_t index = 0; index < 200; index++ )
+	{
+		bool		present = ( index % 7 == 0 ) && ( index / 7 < 10 );
+
+		BOOST_CHECK_EQUAL( vector.find( index ) != NULL, present );
+	}
+
+	TieringReport		after = reportFor<ProbeVector>();
+
+	BOOST_CHECK_EQUAL( after.m_lookups - before.m_lookups, 200u );
+	BOOST_CHECK_EQUAL( after.m_groupsProbed - before.m_groupsProbed, 200u );
+
+	//	Inline lookups are not hash probes
+
+	ProbeVector		inlineVector;
+
+	addEntries( inlineVector, 2, 1 );
+	inlineVector.find( 1 );
+
+	BOOST_CHECK_EQUAL( reportFor<ProbeVector>().m_lookups, after.m_lookups );
+
+	BOOST_CHECK_CLOSE( after.averageProbeLength(), 1.0, 0.0001 );
+
+	//	A bigger table probes at least one group, and at most 7/8 full nearly every lookup ends in the first
+
+	TieringReport		cutover = reportFor<CutoverVector>();
+
+	CutoverVector		larger;
+
+	addEntries( larger, 28, 11 );
+
+	for( size_t index = 0; index < 1000; index++ )
+	{
+		larger.find( index );
+	}
+
+	TieringReport		largerReport = reportFor<CutoverVector>();
+
+	double				average = (double)( largerReport.m_groupsProbed - cutover.m_groupsProbed ) / (double)( largerReport.m_lookups - cutover.m_lookups );
+
+	BOOST_CHECK_GE( largerReport.m_lookups - cutover.m_lookups, 1000u );
+	BOOST_CHECK_GE( average, 1.0 );
+	BOOST_CHECK_LT( average, 2.0 );
+
+	TieringReport		empty = TieringReport();
+
+	BOOST_CHECK_EQUAL( empty.averageProbeLength(), 0.0 );
+}
+
+
+BOOST_AUTO_TEST_CASE( PointerListCutovers )
+{
+	std::vector<std::unique_ptr<Entry>>		entries;
+
+	for( size_t i = 0; i < 20; i++ )
+	{
+		entries.push_back( std::unique_ptr<Entry>( new Entry( i )));
+	}
+
+	{
+		PointerList		small;
+		PointerList		large;
+
+		for( size_t i = 0; i < 3; i++ )
+		{
+			small.insert( entries[i].get() );
+		}
+
+		for( size_t i = 0; i < 20; i++ )
+		{
+			large.insert( entries[i].get() );
+		}
+
+		TieringReport		report = reportFor<PointerList>();
+
+		//	The fifth insert moves the four inline pointers to the set
+
+		BOOST_CHECK_EQUAL( report.cutovers(), 1u );
+		BOOST_CHECK_EQUAL( report.m_cutoverSizes[2], 1u );
+		BOOST_CHECK_EQUAL( report.m_live[TIERING_TIER_INLINE], 1 );
+		BOOST_CHECK_EQUAL( report.m_live[TIERING_TIER_MAP], 1 );
+		BOOST_CHECK_EQUAL( report.m_bytes[TIERING_TIER_INLINE], (int64_t)( 2 * sizeof( PointerList )) );
+		BOOST_CHECK_GT( report.m_bytes[TIERING_TIER_MAP], 0 );
+
+		large.clear();
+
+		report = reportFor<PointerList>();
+
+		BOOST_CHECK_EQUAL( report.m_live[TIERING_TIER_INLINE], 2 );
+		BOOST_CHECK_EQUAL( report.m_live[TIERING_TIER_MAP], 0 );
+		BOOST_CHECK_EQUAL( report.m_bytes[TIERING_TIER_MAP], 0 );
+	}
+
+	checkAllReleased<PointerList>();
+}
+
+
+BOOST_AUTO_TEST_CASE( LoggerWritesTheTable )
+{
+	CapturedLog					log;
+	std::unique_ptr<ILogger>	logger = Logging::GetLogger( "TieringStatsTest" );
+
+	LoggedVector				vector;
+
+	addEntries( vector, 7, 2 );
+
+	//	Measured before logging, the table type counts itself and must be in the report too
+
+	size_t						expectedMapBytes = mapBytes( 6 * 4 );
+
+	{
+		//	Long enough that only logNow() writes
+
+		TieringStatsLogger		statsLogger( *logger, std::chrono::hours( 1 ) );
+
+		statsLogger.logNow();
+	}
+
+	std::string		text = log.text();
+
+	std::ostringstream		typeBlock;
+
+	typeBlock << boost::core::demangle( typeid( LoggedVector ).name() ) << "\n"
+			  << "      inline: 0 live, " << sizeof( LoggedVector ) << " bytes\n"
+			  << "         map: 1 live, " << expectedMapBytes << " bytes\n"
+			  << "       dense: 0 live, 0 bytes\n"
+			  << "    transitions: inline->map=1\n"
+			  << "    size at cutover: 4+=1\n"
+			  << "    lookups: ";
+
+	BOOST_CHECK_EQUAL( text.find( "Tiering statistics\n" ), 0u );
+	BOOST_CHECK( text.find( typeBlock.str() ) != std::string::npos );
+
+	//	Every type counted so far is in the table
+
+	for( const TieringReport& report : TieringStats::report() )
+	{
+		BOOST_CHECK( text.find( report.m_typeName + "\n" ) != std::string::npos );
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE( LoggerWritesPeriodically )
+{
+	CapturedLog					log;
+	std::unique_ptr<ILogger>	logger = Logging::GetLogger( "TieringStatsTest" );
+
+	size_t						tables = 0;
+
+	{
+		TieringStatsLogger		statsLogger( *logger, std::chrono::milliseconds( 5 ) );
+
+		for( int wait = 0; ( wait < 2000 ) && ( tables < 2 ); wait++ )
+		{
+			std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+
+			std::string		text = log.text();
+
+			tables = 0;
+
+			for( size_t position = text.find( "Tiering statistics" ); position != std::string::npos; position = text.find( "Tiering statistics", position + 1 ) )
+			{
+				tables++;
+			}
+		}
+
+		//	Destruction wakes the thread rather than waiting out the interval
+	}
+
+	BOOST_CHECK_GE( tables, 2u );
+}